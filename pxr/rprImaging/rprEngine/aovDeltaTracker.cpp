@@ -0,0 +1,156 @@
+#include "pxr/rprImaging/rprEngine/aovDeltaTracker.h"
+
+#include "pxr/base/gf/half.h"
+#include "pxr/base/work/loops.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+
+float ReadComponent(uint8_t const* data, HdFormat componentFormat) {
+    switch (componentFormat) {
+        case HdFormatUNorm8: return *data / 255.0f;
+        case HdFormatSNorm8: return *reinterpret_cast<int8_t const*>(data) / 127.0f;
+        case HdFormatFloat16: return float(*reinterpret_cast<GfHalf const*>(data));
+        case HdFormatFloat32: return *reinterpret_cast<float const*>(data);
+        default: return 0.0f;
+    }
+}
+
+} // namespace anonymous
+
+HdRprAovDeltaTracker::HdRprAovDeltaTracker(int tileSize)
+    : m_tileSize(std::max(tileSize, 1))
+    , m_width(0)
+    , m_height(0)
+    , m_format(HdFormatInvalid)
+    , m_tileCount(0)
+    , m_generation(0) {
+
+}
+
+void HdRprAovDeltaTracker::_GetTileRect(int tx, int ty, int rect[4]) const {
+    rect[0] = tx * m_tileSize;
+    rect[1] = ty * m_tileSize;
+    rect[2] = std::min(m_tileSize, m_width - rect[0]);
+    rect[3] = std::min(m_tileSize, m_height - rect[1]);
+}
+
+bool HdRprAovDeltaTracker::_TileDiffers(uint8_t const* data, int const rect[4], float threshold) const {
+    size_t pixelSize = HdDataSizeOfFormat(m_format);
+    size_t rowSize = size_t(rect[2]) * pixelSize;
+
+    HdFormat componentFormat = HdGetComponentFormat(m_format);
+    bool exact = threshold <= 0.0f || componentFormat == HdFormatInt32;
+    size_t componentSize = HdDataSizeOfFormat(componentFormat);
+    size_t componentCount = rowSize / componentSize;
+
+    for (int y = rect[1]; y < rect[1] + rect[3]; ++y) {
+        size_t offset = (size_t(y) * m_width + rect[0]) * pixelSize;
+        uint8_t const* current = data + offset;
+        uint8_t const* previous = m_snapshot.data() + offset;
+
+        if (exact) {
+            if (std::memcmp(current, previous, rowSize) != 0) {
+                return true;
+            }
+            continue;
+        }
+
+        for (size_t c = 0; c < componentCount; ++c) {
+            float difference = ReadComponent(current + c * componentSize, componentFormat) -
+                               ReadComponent(previous + c * componentSize, componentFormat);
+            // NaNs count as changes
+            if (!(std::abs(difference) <= threshold)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void HdRprAovDeltaTracker::Update(
+    uint8_t const* data,
+    int width,
+    int height,
+    HdFormat format,
+    float threshold) {
+    if (!data || width <= 0 || height <= 0 || format == HdFormatInvalid) {
+        return;
+    }
+
+    size_t dataSize = size_t(width) * height * HdDataSizeOfFormat(format);
+    uint64_t generation = m_generation + 1;
+
+    if (width != m_width || height != m_height || format != m_format) {
+        m_width = width;
+        m_height = height;
+        m_format = format;
+        m_tileCount = GfVec2i((width + m_tileSize - 1) / m_tileSize, (height + m_tileSize - 1) / m_tileSize);
+
+        m_snapshot.assign(data, data + dataSize);
+        m_tileGenerations.assign(size_t(m_tileCount[0]) * m_tileCount[1], generation);
+        m_generation = generation;
+        return;
+    }
+
+    std::atomic<bool> anyChanged(false);
+    size_t pixelSize = HdDataSizeOfFormat(m_format);
+    WorkParallelForN(m_tileGenerations.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            int rect[4];
+            _GetTileRect(int(i % m_tileCount[0]), int(i / m_tileCount[0]), rect);
+            if (!_TileDiffers(data, rect, threshold)) {
+                continue;
+            }
+
+            // Tiles don't overlap, each task owns the snapshot rows of its tiles
+            size_t rowSize = size_t(rect[2]) * pixelSize;
+            for (int y = rect[1]; y < rect[1] + rect[3]; ++y) {
+                size_t offset = (size_t(y) * m_width + rect[0]) * pixelSize;
+                std::memcpy(m_snapshot.data() + offset, data + offset, rowSize);
+            }
+            m_tileGenerations[i] = generation;
+            anyChanged = true;
+        }
+    });
+
+    if (anyChanged) {
+        m_generation = generation;
+    }
+}
+
+void HdRprAovDeltaTracker::ReadDelta(uint64_t sinceGeneration, std::vector<HdRprAovTile>* tiles) const {
+    size_t pixelSize = m_format == HdFormatInvalid ? 0 : HdDataSizeOfFormat(m_format);
+
+    for (size_t i = 0; i < m_tileGenerations.size(); ++i) {
+        if (m_tileGenerations[i] <= sinceGeneration) {
+            continue;
+        }
+
+        int rect[4];
+        _GetTileRect(int(i % m_tileCount[0]), int(i / m_tileCount[0]), rect);
+
+        HdRprAovTile tile;
+        tile.x = rect[0];
+        tile.y = rect[1];
+        tile.width = rect[2];
+        tile.height = rect[3];
+        tile.generation = m_tileGenerations[i];
+
+        size_t rowSize = size_t(rect[2]) * pixelSize;
+        tile.data.resize(rowSize * rect[3]);
+        for (int y = 0; y < rect[3]; ++y) {
+            size_t offset = (size_t(rect[1] + y) * m_width + rect[0]) * pixelSize;
+            std::memcpy(tile.data.data() + y * rowSize, m_snapshot.data() + offset, rowSize);
+        }
+        tiles->push_back(std::move(tile));
+    }
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,79 @@
+#ifndef HDRPR_AOV_DELTA_TRACKER_H
+#define HDRPR_AOV_DELTA_TRACKER_H
+
+#include "api.h"
+
+#include "pxr/imaging/hd/types.h"
+#include "pxr/base/gf/vec2i.h"
+
+#include <cstdint>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class HdRprAovTile
+///
+/// Rectangle of AOV pixels, with (x,y) being the lower left corner. Rows
+/// are tightly packed bottom to top.
+///
+struct HdRprAovTile {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+
+    // Generation at which the tile last changed
+    uint64_t generation = 0;
+
+    std::vector<uint8_t> data;
+};
+
+/// \class HdRprAovDeltaTracker
+///
+/// Splits successive readbacks of an AOV into tiles and keeps a generation
+/// per tile that advances only when the tile changed by more than a
+/// threshold. A snapshot of every tile as of its last change is kept, so
+/// the tiles handed out for a generation are consistent with each other
+/// and small progressive refinements are not sent over and over.
+///
+class HdRprAovDeltaTracker {
+public:
+    HDRPR_API
+    explicit HdRprAovDeltaTracker(int tileSize = 64);
+
+    /// Compare \p data against the snapshot. A tile counts as changed if any
+    /// of its pixel components differs by more than \p threshold, or at all
+    /// for a threshold of zero and for integer formats. A change of size or
+    /// format changes all tiles.
+    HDRPR_API
+    void Update(uint8_t const* data, int width, int height, HdFormat format, float threshold);
+
+    /// Generation of the most recent change. Starts at 1 with the first
+    /// Update(), 0 means no data.
+    uint64_t GetGeneration() const { return m_generation; }
+
+    /// Append the tiles that changed after \p sinceGeneration to \p tiles.
+    HDRPR_API
+    void ReadDelta(uint64_t sinceGeneration, std::vector<HdRprAovTile>* tiles) const;
+
+private:
+    // Returns the pixel rectangle of tile (tx,ty) as x, y, width, height
+    void _GetTileRect(int tx, int ty, int rect[4]) const;
+
+    bool _TileDiffers(uint8_t const* data, int const rect[4], float threshold) const;
+
+private:
+    int m_tileSize;
+    int m_width;
+    int m_height;
+    HdFormat m_format;
+    GfVec2i m_tileCount;
+
+    std::vector<uint8_t> m_snapshot;
+    std::vector<uint64_t> m_tileGenerations;
+    uint64_t m_generation;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_AOV_DELTA_TRACKER_H
@@ -0,0 +1,191 @@
+#include "pxr/rprImaging/rprEngine/aovImage.h"
+
+#include "pxr/base/gf/half.h"
+#include "pxr/base/work/loops.h"
+
+#include <algorithm>
+#include <cstring>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+
+float ReadComponent(uint8_t const* data, HdFormat componentFormat) {
+    switch (componentFormat) {
+        case HdFormatUNorm8: return *data / 255.0f;
+        case HdFormatSNorm8: return std::max(*reinterpret_cast<int8_t const*>(data) / 127.0f, -1.0f);
+        case HdFormatFloat16: return float(*reinterpret_cast<GfHalf const*>(data));
+        case HdFormatFloat32: return *reinterpret_cast<float const*>(data);
+        default: return 0.0f;
+    }
+}
+
+void WriteComponent(float value, HdFormat componentFormat, uint8_t* data) {
+    switch (componentFormat) {
+        case HdFormatUNorm8:
+            *data = uint8_t(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+            break;
+        case HdFormatSNorm8:
+            *reinterpret_cast<int8_t*>(data) = int8_t(std::min(std::max(value, -1.0f), 1.0f) * 127.0f);
+            break;
+        case HdFormatFloat16:
+            *reinterpret_cast<GfHalf*>(data) = GfHalf(value);
+            break;
+        case HdFormatFloat32:
+            *reinterpret_cast<float*>(data) = value;
+            break;
+        default:
+            break;
+    }
+}
+
+} // namespace anonymous
+
+void HdRprAovImage::Resize(int width, int height, HdFormat format) {
+    width = std::max(width, 0);
+    height = std::max(height, 0);
+    if (width == m_width && height == m_height && format == m_format) {
+        return;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_format = format;
+    m_data.resize(size_t(m_width) * m_height * GetPixelSize());
+}
+
+GfVec4f HdRprAovImage::GetPixel(int x, int y) const {
+    HdFormat componentFormat = HdGetComponentFormat(m_format);
+    size_t componentCount = std::min(HdGetComponentCount(m_format), size_t(4));
+    size_t componentSize = HdDataSizeOfFormat(componentFormat);
+
+    GfVec4f value(0.0f);
+    uint8_t const* pixel = m_data.data() + (size_t(y) * m_width + x) * GetPixelSize();
+    for (size_t c = 0; c < componentCount; ++c) {
+        value[c] = ReadComponent(pixel + c * componentSize, componentFormat);
+    }
+    return value;
+}
+
+void HdRprAovImage::SetPixel(int x, int y, GfVec4f const& value) {
+    HdFormat componentFormat = HdGetComponentFormat(m_format);
+    size_t componentCount = std::min(HdGetComponentCount(m_format), size_t(4));
+    size_t componentSize = HdDataSizeOfFormat(componentFormat);
+
+    uint8_t* pixel = m_data.data() + (size_t(y) * m_width + x) * GetPixelSize();
+    for (size_t c = 0; c < componentCount; ++c) {
+        WriteComponent(value[c], componentFormat, pixel + c * componentSize);
+    }
+}
+
+bool HdRprAovImage::Read(HdRenderBuffer* buffer, GfVec2i const& offset) {
+    if (!buffer || IsEmpty() || buffer->GetFormat() != m_format) {
+        return false;
+    }
+
+    int srcWidth = buffer->GetWidth();
+    int srcHeight = buffer->GetHeight();
+
+    // Clip the destination rectangle
+    int x0 = std::max(offset[0], 0);
+    int y0 = std::max(offset[1], 0);
+    int x1 = std::min(offset[0] + srcWidth, m_width);
+    int y1 = std::min(offset[1] + srcHeight, m_height);
+    if (x0 >= x1 || y0 >= y1) {
+        return true;
+    }
+
+    auto src = static_cast<uint8_t const*>(buffer->Map());
+    if (!src) {
+        return false;
+    }
+
+    size_t pixelSize = GetPixelSize();
+    size_t rowSize = size_t(x1 - x0) * pixelSize;
+    for (int y = y0; y < y1; ++y) {
+        size_t srcOffset = (size_t(y - offset[1]) * srcWidth + (x0 - offset[0])) * pixelSize;
+        size_t dstOffset = (size_t(y) * m_width + x0) * pixelSize;
+        std::memcpy(m_data.data() + dstOffset, src + srcOffset, rowSize);
+    }
+
+    buffer->Unmap();
+    return true;
+}
+
+bool HdRprAovImage::ReadResampled(HdRenderBuffer* buffer) {
+    if (!buffer || IsEmpty() || buffer->GetFormat() != m_format) {
+        return false;
+    }
+
+    int srcWidth = buffer->GetWidth();
+    int srcHeight = buffer->GetHeight();
+    if (srcWidth == m_width && srcHeight == m_height) {
+        return Read(buffer);
+    }
+    if (srcWidth <= 0 || srcHeight <= 0) {
+        return false;
+    }
+
+    auto src = static_cast<uint8_t const*>(buffer->Map());
+    if (!src) {
+        return false;
+    }
+
+    HdFormat componentFormat = HdGetComponentFormat(m_format);
+    size_t componentCount = HdGetComponentCount(m_format);
+    size_t componentSize = HdDataSizeOfFormat(componentFormat);
+    size_t pixelSize = GetPixelSize();
+
+    // Interpolating depth or ids across edges produces values that belong to
+    // none of the surfaces
+    bool interpolate = componentCount >= 3 && componentFormat != HdFormatInt32;
+
+    float scaleX = float(srcWidth) / m_width;
+    float scaleY = float(srcHeight) / m_height;
+
+    WorkParallelForN(m_height, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; ++y) {
+            uint8_t* dst = m_data.data() + y * m_width * pixelSize;
+
+            if (!interpolate) {
+                int sy = std::min(int((y + 0.5f) * scaleY), srcHeight - 1);
+                for (int x = 0; x < m_width; ++x, dst += pixelSize) {
+                    int sx = std::min(int((x + 0.5f) * scaleX), srcWidth - 1);
+                    std::memcpy(dst, src + (size_t(sy) * srcWidth + sx) * pixelSize, pixelSize);
+                }
+                continue;
+            }
+
+            float fy = std::min(std::max((y + 0.5f) * scaleY - 0.5f, 0.0f), float(srcHeight - 1));
+            int y0 = int(fy);
+            int y1 = std::min(y0 + 1, srcHeight - 1);
+            fy -= y0;
+
+            for (int x = 0; x < m_width; ++x, dst += pixelSize) {
+                float fx = std::min(std::max((x + 0.5f) * scaleX - 0.5f, 0.0f), float(srcWidth - 1));
+                int x0 = int(fx);
+                int x1 = std::min(x0 + 1, srcWidth - 1);
+                fx -= x0;
+
+                uint8_t const* p00 = src + (size_t(y0) * srcWidth + x0) * pixelSize;
+                uint8_t const* p10 = src + (size_t(y0) * srcWidth + x1) * pixelSize;
+                uint8_t const* p01 = src + (size_t(y1) * srcWidth + x0) * pixelSize;
+                uint8_t const* p11 = src + (size_t(y1) * srcWidth + x1) * pixelSize;
+
+                for (size_t c = 0; c < componentCount; ++c) {
+                    size_t offset = c * componentSize;
+                    float v0 = ReadComponent(p00 + offset, componentFormat) * (1.0f - fx) +
+                               ReadComponent(p10 + offset, componentFormat) * fx;
+                    float v1 = ReadComponent(p01 + offset, componentFormat) * (1.0f - fx) +
+                               ReadComponent(p11 + offset, componentFormat) * fx;
+                    WriteComponent(v0 * (1.0f - fy) + v1 * fy, componentFormat, dst + offset);
+                }
+            }
+        }
+    });
+
+    buffer->Unmap();
+    return true;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
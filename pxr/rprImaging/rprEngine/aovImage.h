@@ -0,0 +1,69 @@
+#ifndef HDRPR_AOV_IMAGE_H
+#define HDRPR_AOV_IMAGE_H
+
+#include "api.h"
+
+#include "pxr/imaging/hd/renderBuffer.h"
+#include "pxr/imaging/hd/types.h"
+#include "pxr/base/gf/vec2i.h"
+#include "pxr/base/gf/vec4f.h"
+
+#include <cstdint>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class HdRprAovImage
+///
+/// CPU-side copy of an AOV that the engine composes from one or more
+/// render buffer readbacks. Rows are stored bottom to top, the same way
+/// Hydra render buffers are.
+///
+class HdRprAovImage {
+public:
+    HdRprAovImage() = default;
+
+    /// Reallocates the image if any of the parameters differ. The content is
+    /// undefined afterwards.
+    HDRPR_API
+    void Resize(int width, int height, HdFormat format);
+
+    int GetWidth() const { return m_width; }
+    int GetHeight() const { return m_height; }
+    HdFormat GetFormat() const { return m_format; }
+    size_t GetPixelSize() const { return m_format == HdFormatInvalid ? 0 : HdDataSizeOfFormat(m_format); }
+    bool IsEmpty() const { return m_data.empty(); }
+
+    uint8_t* GetData() { return m_data.data(); }
+    uint8_t const* GetData() const { return m_data.data(); }
+
+    /// Returns the components of pixel (x,y) converted to float, missing
+    /// components are zero. Integer formats are not converted.
+    HDRPR_API
+    GfVec4f GetPixel(int x, int y) const;
+
+    /// Converts \p value to the format of the image and stores it at (x,y).
+    HDRPR_API
+    void SetPixel(int x, int y, GfVec4f const& value);
+
+    /// Copies the whole \p buffer into the image so that its first pixel
+    /// lands at \p offset. Pixels outside the image are clipped.
+    /// Returns false if the buffer can't be mapped or has a different format.
+    HDRPR_API
+    bool Read(HdRenderBuffer* buffer, GfVec2i const& offset = GfVec2i(0));
+
+    /// Resamples the whole \p buffer to the size of the image. Color formats
+    /// are filtered bilinearly, others (depth, ids) use the nearest sample.
+    HDRPR_API
+    bool ReadResampled(HdRenderBuffer* buffer);
+
+private:
+    int m_width = 0;
+    int m_height = 0;
+    HdFormat m_format = HdFormatInvalid;
+    std::vector<uint8_t> m_data;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_AOV_IMAGE_H
@@ -0,0 +1,60 @@
+#include "pxr/rprImaging/rprEngine/imagingCache.h"
+
+#include "pxr/usd/usd/stage.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+int main(int ac, char** av) {
+    PXR_NAMESPACE_USING_DIRECTIVE
+
+    if (ac < 3) {
+        printf("Usage: %s file.usd output.hdrprcache [--root path] [--frames start end [step]]\n", av[0]);
+        return 1;
+    }
+
+    std::string stagePath = av[1];
+    std::string outputPath = av[2];
+    SdfPath rootPath = SdfPath::AbsoluteRootPath();
+    bool hasFrames = false;
+    double startFrame = 0.0;
+    double endFrame = 0.0;
+    double frameStep = 1.0;
+
+    for (int i = 3; i < ac; ++i) {
+        std::string arg = av[i];
+        if (arg == "--root" && i + 1 < ac) {
+            rootPath = SdfPath(av[++i]);
+        } else if (arg == "--frames" && i + 2 < ac) {
+            hasFrames = true;
+            startFrame = std::atof(av[++i]);
+            endFrame = std::atof(av[++i]);
+            if (i + 1 < ac && av[i + 1][0] != '-') {
+                frameStep = std::atof(av[++i]);
+            }
+        } else {
+            printf("Unknown argument \"%s\"\n", av[i]);
+            return 1;
+        }
+    }
+
+    auto stage = UsdStage::Open(stagePath);
+    if (!stage) {
+        printf("Failed to open stage at \"%s\"\n", stagePath.c_str());
+        return 1;
+    }
+
+    // Bake the stage's own frame range by default
+    if (!hasFrames) {
+        startFrame = stage->GetStartTimeCode();
+        endFrame = stage->GetEndTimeCode();
+    }
+
+    if (!HdRprImagingCache::Bake(stage, rootPath, startFrame, endFrame, frameStep, outputPath)) {
+        printf("Failed to bake \"%s\"\n", outputPath.c_str());
+        return 1;
+    }
+
+    return 0;
+}
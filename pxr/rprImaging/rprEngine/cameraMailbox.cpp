@@ -0,0 +1,44 @@
+#include "pxr/rprImaging/rprEngine/cameraMailbox.h"
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+HdRprCameraMailbox::HdRprCameraMailbox()
+    : m_pending(nullptr)
+    , m_droppedCount(0) {
+
+}
+
+HdRprCameraMailbox::~HdRprCameraMailbox() {
+    delete m_pending.exchange(nullptr);
+}
+
+void HdRprCameraMailbox::Post(HdRprCameraState const& state) {
+    std::unique_ptr<_Entry> entry(new _Entry{state, Clock::now()});
+
+    // Whoever exchanges a pointer out of the slot owns it, so the replaced
+    // entry can't be in use by the consumer
+    std::unique_ptr<_Entry> replaced(m_pending.exchange(entry.release(), std::memory_order_acq_rel));
+    if (replaced) {
+        m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool HdRprCameraMailbox::Take(HdRprCameraState* state, Clock::time_point* postTime) {
+    // Cheap check first, the render loop calls this every frame
+    if (!m_pending.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    std::unique_ptr<_Entry> entry(m_pending.exchange(nullptr, std::memory_order_acq_rel));
+    if (!entry) {
+        return false;
+    }
+
+    *state = std::move(entry->state);
+    if (postTime) {
+        *postTime = entry->postTime;
+    }
+    return true;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
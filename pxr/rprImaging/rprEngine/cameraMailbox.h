@@ -0,0 +1,77 @@
+#ifndef HDRPR_CAMERA_MAILBOX_H
+#define HDRPR_CAMERA_MAILBOX_H
+
+#include "api.h"
+
+#include "pxr/usd/sdf/path.h"
+#include "pxr/base/gf/matrix4d.h"
+#include "pxr/base/gf/vec4d.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class HdRprCameraState
+///
+/// Complete camera framing of a frame, as set by SetRenderViewport() and
+/// either SetCameraState() or SetCameraPath() on HdRprEngine.
+///
+struct HdRprCameraState {
+    GfVec4d viewport = GfVec4d(0.0);
+
+    // Scene camera to render from, the free camera matrices are used if empty
+    SdfPath cameraPath;
+
+    GfMatrix4d viewMatrix = GfMatrix4d(1.0);
+    GfMatrix4d projectionMatrix = GfMatrix4d(1.0);
+};
+
+/// \class HdRprCameraMailbox
+///
+/// Holds the latest posted camera state until the rendering thread takes
+/// it. Any number of threads may post without locking, a state that is
+/// replaced before being taken is dropped. States are handed over by
+/// exchanging an atomic pointer, so neither side ever waits for the other.
+///
+class HdRprCameraMailbox {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    HDRPR_API
+    HdRprCameraMailbox();
+
+    HDRPR_API
+    ~HdRprCameraMailbox();
+
+    HdRprCameraMailbox(const HdRprCameraMailbox&) = delete;
+    HdRprCameraMailbox& operator=(const HdRprCameraMailbox&) = delete;
+
+    /// Replace the pending state with \p state. Safe to call from any thread.
+    HDRPR_API
+    void Post(HdRprCameraState const& state);
+
+    /// Take the pending state into \p state and return true, or return false
+    /// if nothing was posted since the last call. \p postTime receives the
+    /// time the state was posted. Meant for a single consuming thread.
+    HDRPR_API
+    bool Take(HdRprCameraState* state, Clock::time_point* postTime = nullptr);
+
+    /// Return the number of posted states that were replaced before being
+    /// taken.
+    size_t GetDroppedCount() const { return m_droppedCount.load(std::memory_order_relaxed); }
+
+private:
+    struct _Entry {
+        HdRprCameraState state;
+        Clock::time_point postTime;
+    };
+
+    std::atomic<_Entry*> m_pending;
+    std::atomic<size_t> m_droppedCount;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_CAMERA_MAILBOX_H
@@ -0,0 +1,273 @@
+#include "pxr/rprImaging/rprEngine/convergenceEstimator.h"
+
+#include "pxr/base/arch/defines.h"
+#include "pxr/base/gf/half.h"
+#include "pxr/base/work/loops.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(ARCH_CPU_INTEL)
+#include <xmmintrin.h>
+#endif
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+
+// Rec. 709 luminance weights
+const float kLumR = 0.2126f;
+const float kLumG = 0.7152f;
+const float kLumB = 0.0722f;
+
+// Keeps the relative error of nearly black tiles from blowing up
+const float kMinLuminance = 1e-2f;
+
+// After this many iterations the variance estimate turns into an exponential
+// moving average so it keeps tracking the latest iterations
+const int kHistoryLength = 8;
+
+// Fraction of tiles that must be below the global error
+const float kErrorPercentile = 0.95f;
+
+void ConvertRowRGBA32F(const float* src, float* dst, size_t count) {
+    size_t i = 0;
+#if defined(ARCH_CPU_INTEL)
+    const __m128 wr = _mm_set1_ps(kLumR);
+    const __m128 wg = _mm_set1_ps(kLumG);
+    const __m128 wb = _mm_set1_ps(kLumB);
+    for (; i + 4 <= count; i += 4) {
+        __m128 p0 = _mm_loadu_ps(src + 4 * i);
+        __m128 p1 = _mm_loadu_ps(src + 4 * i + 4);
+        __m128 p2 = _mm_loadu_ps(src + 4 * i + 8);
+        __m128 p3 = _mm_loadu_ps(src + 4 * i + 12);
+        // p0, p1, p2 become r, g, b of four pixels
+        _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+        __m128 lum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, wr), _mm_mul_ps(p1, wg)), _mm_mul_ps(p2, wb));
+        _mm_storeu_ps(dst + i, lum);
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = kLumR * src[4 * i] + kLumG * src[4 * i + 1] + kLumB * src[4 * i + 2];
+    }
+}
+
+void ConvertRow(const void* src, HdFormat format, float* dst, size_t count) {
+    switch (format) {
+        case HdFormatFloat32Vec4:
+            ConvertRowRGBA32F(static_cast<const float*>(src), dst, count);
+            break;
+        case HdFormatFloat32Vec3: {
+            auto data = static_cast<const float*>(src);
+            for (size_t i = 0; i < count; ++i) {
+                dst[i] = kLumR * data[3 * i] + kLumG * data[3 * i + 1] + kLumB * data[3 * i + 2];
+            }
+            break;
+        }
+        case HdFormatFloat16Vec4: {
+            auto data = static_cast<const GfHalf*>(src);
+            for (size_t i = 0; i < count; ++i) {
+                dst[i] = kLumR * float(data[4 * i]) + kLumG * float(data[4 * i + 1]) + kLumB * float(data[4 * i + 2]);
+            }
+            break;
+        }
+        case HdFormatUNorm8Vec4: {
+            auto data = static_cast<const uint8_t*>(src);
+            for (size_t i = 0; i < count; ++i) {
+                dst[i] = (kLumR * data[4 * i] + kLumG * data[4 * i + 1] + kLumB * data[4 * i + 2]) / 255.0f;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void AccumulateRow(const float* cur, const float* prev, size_t count, double* sumSqDiff, double* sum) {
+    size_t i = 0;
+#if defined(ARCH_CPU_INTEL)
+    __m128 accSq = _mm_setzero_ps();
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        __m128 c = _mm_loadu_ps(cur + i);
+        __m128 d = _mm_sub_ps(c, _mm_loadu_ps(prev + i));
+        accSq = _mm_add_ps(accSq, _mm_mul_ps(d, d));
+        acc = _mm_add_ps(acc, c);
+    }
+    alignas(16) float lanesSq[4];
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanesSq, accSq);
+    _mm_store_ps(lanes, acc);
+    *sumSqDiff += double(lanesSq[0]) + lanesSq[1] + lanesSq[2] + lanesSq[3];
+    *sum += double(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < count; ++i) {
+        float d = cur[i] - prev[i];
+        *sumSqDiff += d * d;
+        *sum += cur[i];
+    }
+}
+
+} // namespace anonymous
+
+HdRprConvergenceEstimator::HdRprConvergenceEstimator(int tileSize)
+    : m_tileSize(std::max(tileSize, 1))
+    , m_width(0)
+    , m_height(0)
+    , m_numSnapshots(0)
+    , m_tileCount(0, 0)
+    , m_error(std::numeric_limits<float>::infinity())
+    , m_iterationCount(0) {
+
+}
+
+HdRprConvergenceEstimator::~HdRprConvergenceEstimator() {
+    // The background job references our members
+    m_dispatcher.Wait();
+}
+
+void HdRprConvergenceEstimator::Reset() {
+    m_dispatcher.Wait();
+
+    m_prevLuminance.clear();
+    m_tileVariance.clear();
+    m_numSnapshots = 0;
+
+    std::lock_guard<std::mutex> lock(m_resultMutex);
+    m_tileErrors.clear();
+    m_tileCount = GfVec2i(0, 0);
+    m_error = std::numeric_limits<float>::infinity();
+    m_iterationCount = 0;
+}
+
+bool HdRprConvergenceEstimator::Update(HdRenderBuffer* colorBuffer) {
+    if (!colorBuffer) {
+        return false;
+    }
+
+    HdFormat format = colorBuffer->GetFormat();
+    if (format != HdFormatFloat32Vec4 &&
+        format != HdFormatFloat32Vec3 &&
+        format != HdFormatFloat16Vec4 &&
+        format != HdFormatUNorm8Vec4) {
+        return false;
+    }
+
+    int width = colorBuffer->GetWidth();
+    int height = colorBuffer->GetHeight();
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+
+    if (width != m_width || height != m_height) {
+        Reset();
+        m_width = width;
+        m_height = height;
+    } else {
+        // The previous job still owns the snapshot buffers
+        m_dispatcher.Wait();
+    }
+
+    auto data = static_cast<const uint8_t*>(colorBuffer->Map());
+    if (!data) {
+        return false;
+    }
+
+    size_t rowSize = size_t(width) * HdDataSizeOfFormat(format);
+    m_luminance.resize(size_t(width) * height);
+    WorkParallelForN(height, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; ++y) {
+            ConvertRow(data + y * rowSize, format, m_luminance.data() + y * width, width);
+        }
+    });
+
+    colorBuffer->Unmap();
+
+    m_dispatcher.Run([this]() { _UpdateTiles(); });
+    return true;
+}
+
+void HdRprConvergenceEstimator::Wait() {
+    m_dispatcher.Wait();
+}
+
+void HdRprConvergenceEstimator::_UpdateTiles() {
+    int tilesX = (m_width + m_tileSize - 1) / m_tileSize;
+    int tilesY = (m_height + m_tileSize - 1) / m_tileSize;
+    size_t numTiles = size_t(tilesX) * tilesY;
+
+    if (m_tileVariance.size() != numTiles) {
+        m_tileVariance.assign(numTiles, 0.0f);
+    }
+
+    ++m_numSnapshots;
+
+    std::vector<float> tileErrors(numTiles, std::numeric_limits<float>::infinity());
+    float error = std::numeric_limits<float>::infinity();
+
+    if (m_numSnapshots >= 2) {
+        float weight = 1.0f / std::min(m_numSnapshots - 1, kHistoryLength);
+
+        WorkParallelForN(numTiles, [&](size_t begin, size_t end) {
+            for (size_t tile = begin; tile < end; ++tile) {
+                int x0 = int(tile % tilesX) * m_tileSize;
+                int y0 = int(tile / tilesX) * m_tileSize;
+                int x1 = std::min(x0 + m_tileSize, m_width);
+                int y1 = std::min(y0 + m_tileSize, m_height);
+
+                double sumSqDiff = 0.0;
+                double sum = 0.0;
+                for (int y = y0; y < y1; ++y) {
+                    size_t offset = size_t(y) * m_width + x0;
+                    AccumulateRow(m_luminance.data() + offset, m_prevLuminance.data() + offset, x1 - x0, &sumSqDiff, &sum);
+                }
+
+                double count = double(x1 - x0) * (y1 - y0);
+                float variance = float(sumSqDiff / count);
+                float mean = float(sum / count);
+
+                m_tileVariance[tile] += (variance - m_tileVariance[tile]) * weight;
+                tileErrors[tile] = std::sqrt(m_tileVariance[tile]) / std::max(mean, kMinLuminance);
+            }
+        });
+
+        std::vector<float> sorted = tileErrors;
+        auto percentile = sorted.begin() + std::min(size_t(kErrorPercentile * numTiles), numTiles - 1);
+        std::nth_element(sorted.begin(), percentile, sorted.end());
+        error = *percentile;
+    }
+
+    std::swap(m_luminance, m_prevLuminance);
+
+    std::lock_guard<std::mutex> lock(m_resultMutex);
+    m_tileCount = GfVec2i(tilesX, tilesY);
+    m_tileErrors = std::move(tileErrors);
+    m_error = error;
+    m_iterationCount = m_numSnapshots - 1;
+}
+
+bool HdRprConvergenceEstimator::IsConverged(float threshold, int minIterations) const {
+    std::lock_guard<std::mutex> lock(m_resultMutex);
+    return m_iterationCount >= minIterations && m_error < threshold;
+}
+
+std::vector<float> HdRprConvergenceEstimator::GetConvergenceMap(GfVec2i* tileCount) const {
+    std::lock_guard<std::mutex> lock(m_resultMutex);
+    if (tileCount) {
+        *tileCount = m_tileCount;
+    }
+    return m_tileErrors;
+}
+
+float HdRprConvergenceEstimator::GetError() const {
+    std::lock_guard<std::mutex> lock(m_resultMutex);
+    return m_error;
+}
+
+int HdRprConvergenceEstimator::GetIterationCount() const {
+    std::lock_guard<std::mutex> lock(m_resultMutex);
+    return m_iterationCount;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
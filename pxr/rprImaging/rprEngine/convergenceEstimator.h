@@ -0,0 +1,94 @@
+#ifndef HDRPR_CONVERGENCE_ESTIMATOR_H
+#define HDRPR_CONVERGENCE_ESTIMATOR_H
+
+#include "api.h"
+
+#include "pxr/imaging/hd/renderBuffer.h"
+#include "pxr/base/work/dispatcher.h"
+#include "pxr/base/gf/vec2i.h"
+
+#include <mutex>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class HdRprConvergenceEstimator
+///
+/// Estimates how far a progressively refined color AOV is from convergence.
+///
+/// Every Update() snapshots the luminance of the color buffer and, in the
+/// background, compares it against the previous snapshot. For each tile a
+/// running estimate of the variance of the per-pixel luminance change between
+/// successive iterations is kept; the tile error is the standard deviation of
+/// that change relative to the mean tile luminance.
+///
+class HdRprConvergenceEstimator {
+public:
+    HDRPR_API
+    explicit HdRprConvergenceEstimator(int tileSize = 32);
+
+    HdRprConvergenceEstimator(const HdRprConvergenceEstimator&) = delete;
+    HdRprConvergenceEstimator& operator=(const HdRprConvergenceEstimator&) = delete;
+
+    HDRPR_API
+    ~HdRprConvergenceEstimator();
+
+    /// Discards accumulated history, e.g. when the camera or viewport changes.
+    HDRPR_API
+    void Reset();
+
+    /// Snapshots the luminance of \p colorBuffer and schedules the per-tile
+    /// update on the work thread pool. Returns false if the buffer format is
+    /// not supported.
+    HDRPR_API
+    bool Update(HdRenderBuffer* colorBuffer);
+
+    /// Blocks until the pending background update is finished.
+    HDRPR_API
+    void Wait();
+
+    /// Returns true if at least \p minIterations updates were accumulated and
+    /// the global error is below \p threshold.
+    HDRPR_API
+    bool IsConverged(float threshold, int minIterations = 4) const;
+
+    /// Returns the per-tile errors in row-major order starting from the first
+    /// row of the buffer. \p tileCount receives the number of tiles along x and y.
+    HDRPR_API
+    std::vector<float> GetConvergenceMap(GfVec2i* tileCount = nullptr) const;
+
+    /// Returns the 95th percentile of the tile errors, or infinity if there
+    /// is not enough history yet.
+    HDRPR_API
+    float GetError() const;
+
+    HDRPR_API
+    int GetIterationCount() const;
+
+private:
+    void _UpdateTiles();
+
+private:
+    int const m_tileSize;
+
+    WorkDispatcher m_dispatcher;
+
+    // Owned by the background job while it's in flight.
+    int m_width;
+    int m_height;
+    std::vector<float> m_luminance;
+    std::vector<float> m_prevLuminance;
+    std::vector<float> m_tileVariance;
+    int m_numSnapshots;
+
+    // Published results.
+    mutable std::mutex m_resultMutex;
+    GfVec2i m_tileCount;
+    std::vector<float> m_tileErrors;
+    float m_error;
+    int m_iterationCount;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_CONVERGENCE_ESTIMATOR_H
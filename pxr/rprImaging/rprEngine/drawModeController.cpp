@@ -0,0 +1,252 @@
+#include "pxr/rprImaging/rprEngine/drawModeController.h"
+#include "pxr/rprImaging/rprEngine/screenSpace.h"
+
+#include "pxr/usd/usd/editContext.h"
+#include "pxr/usd/usd/modelAPI.h"
+#include "pxr/usd/usd/primRange.h"
+#include "pxr/usd/usd/stage.h"
+#include "pxr/usd/usdGeom/bboxCache.h"
+#include "pxr/usd/usdGeom/modelAPI.h"
+#include "pxr/usd/usdGeom/tokens.h"
+#include "pxr/usd/sdf/attributeSpec.h"
+#include "pxr/usd/sdf/changeBlock.h"
+#include "pxr/usd/sdf/layer.h"
+#include "pxr/base/tf/hashmap.h"
+
+#include <algorithm>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+
+// A proxied model has to grow this fraction past the threshold to get its
+// geometry back, a full model has to shrink by as much to become a proxy
+const float kHysteresis = 0.25f;
+
+VtValue GetSessionValue(UsdStageRefPtr const& stage, SdfPath const& primPath, TfToken const& name) {
+    SdfAttributeSpecHandle spec = stage->GetSessionLayer()->GetAttributeAtPath(primPath.AppendProperty(name));
+    return spec ? spec->GetDefaultValue() : VtValue();
+}
+
+void RestoreValue(UsdAttribute const& attr, VtValue const& value) {
+    if (!attr) {
+        return;
+    }
+
+    if (value.IsEmpty()) {
+        attr.Clear();
+    } else {
+        attr.Set(value);
+    }
+}
+
+} // namespace anonymous
+
+HdRprDrawModeController::HdRprDrawModeController()
+    : m_modelsValid(false)
+    , m_boundsValid(false)
+    , m_viewProjection(1.0)
+    , m_viewportSize(0)
+    , m_threshold(-1.0f)
+    , m_proxyCount(0) {
+
+}
+
+HdRprDrawModeController::~HdRprDrawModeController() {
+    Restore();
+}
+
+void HdRprDrawModeController::Invalidate() {
+    m_modelsValid = false;
+    m_boundsValid = false;
+}
+
+void HdRprDrawModeController::Update(
+    UsdPrim const& root,
+    HdRprPathTrie const& excludedPaths,
+    UsdTimeCode frame,
+    GfMatrix4d const& viewProjection,
+    GfVec2i const& viewportSize,
+    float threshold,
+    TfToken const& drawMode) {
+    if (!root) {
+        return;
+    }
+
+    if (root.GetStage() != m_stage) {
+        Restore();
+        m_models.clear();
+        m_modelsValid = false;
+    }
+
+    if (!m_modelsValid) {
+        _GatherModels(root, excludedPaths);
+        m_boundsValid = false;
+    }
+
+    UsdStageRefPtr stage = m_stage;
+    if (!stage) {
+        return;
+    }
+
+    if (!m_boundsValid || frame != m_boundsFrame) {
+        UsdGeomBBoxCache bboxCache(frame, {UsdGeomTokens->default_, UsdGeomTokens->render},
+                                   /* useExtentsHint = */ true);
+        for (auto& model : m_models) {
+            UsdPrim prim = stage->GetPrimAtPath(model.path);
+            model.bound = prim ? bboxCache.ComputeWorldBound(prim) : GfBBox3d();
+        }
+        m_boundsFrame = frame;
+        m_boundsValid = true;
+    } else if (viewProjection == m_viewProjection &&
+               viewportSize == m_viewportSize &&
+               threshold == m_threshold &&
+               drawMode == m_drawMode) {
+        return;
+    }
+
+    m_viewProjection = viewProjection;
+    m_viewportSize = viewportSize;
+    m_threshold = threshold;
+    m_drawMode = drawMode;
+
+    float shrinkThreshold = threshold / (1.0f + kHysteresis);
+    float growThreshold = threshold * (1.0f + kHysteresis);
+
+    SdfChangeBlock changeBlock;
+
+    m_proxyCount = 0;
+    SdfPath proxyRoot;
+    for (size_t i = 0; i < m_models.size(); ++i) {
+        _Model const& model = m_models[i];
+
+        // Descendants of a proxy are not drawn anyway
+        bool isCovered = !proxyRoot.IsEmpty() && model.path.HasPrefix(proxyRoot);
+
+        // Models without geometry have nothing to replace
+        bool isProxy = false;
+        if (!isCovered && !model.bound.GetRange().IsEmpty()) {
+            double size = HdRprComputeProjectedSize(model.bound, viewProjection, viewportSize);
+            isProxy = size < (model.drawMode.IsEmpty() ? shrinkThreshold : growThreshold);
+        }
+
+        if (isProxy) {
+            if (model.drawMode != drawMode) {
+                _SetProxy(stage, i, drawMode);
+            }
+            proxyRoot = model.path;
+            ++m_proxyCount;
+        } else if (!model.drawMode.IsEmpty()) {
+            _ClearProxy(stage, i);
+        }
+    }
+}
+
+void HdRprDrawModeController::Restore() {
+    if (m_proxyCount == 0) {
+        return;
+    }
+
+    if (UsdStageRefPtr stage = m_stage) {
+        SdfChangeBlock changeBlock;
+        for (size_t i = 0; i < m_models.size(); ++i) {
+            if (!m_models[i].drawMode.IsEmpty()) {
+                _ClearProxy(stage, i);
+            }
+        }
+    }
+
+    m_proxyCount = 0;
+
+    // Force the next update to evaluate all models again
+    m_threshold = -1.0f;
+}
+
+void HdRprDrawModeController::_GatherModels(
+    UsdPrim const& root,
+    HdRprPathTrie const& excludedPaths) {
+    // Keep the state of models that are already proxies
+    TfHashMap<SdfPath, _Model, SdfPath::Hash> proxies;
+    for (auto& model : m_models) {
+        if (!model.drawMode.IsEmpty()) {
+            proxies[model.path] = std::move(model);
+        }
+    }
+    m_models.clear();
+
+    UsdPrimRange range(root);
+    for (auto it = range.begin(); it != range.end(); ++it) {
+        SdfPath const& path = it->GetPath();
+        if (excludedPaths.IsCovered(path)) {
+            it.PruneChildren();
+            continue;
+        }
+
+        if (it->IsPseudoRoot() || !UsdModelAPI(*it).IsModel()) {
+            continue;
+        }
+
+        auto proxy = proxies.find(path);
+        if (proxy != proxies.end()) {
+            m_models.push_back(std::move(proxy->second));
+            proxies.erase(proxy);
+        } else {
+            _Model model;
+            model.path = path;
+            m_models.push_back(std::move(model));
+        }
+    }
+
+    m_stage = root.GetStage();
+    m_modelsValid = true;
+
+    // Models that are gone still have our opinions authored
+    if (!proxies.empty()) {
+        UsdStageRefPtr stage = m_stage;
+        for (auto& entry : proxies) {
+            m_models.push_back(std::move(entry.second));
+            _ClearProxy(stage, m_models.size() - 1);
+            m_models.pop_back();
+        }
+    }
+}
+
+void HdRprDrawModeController::_SetProxy(
+    UsdStageRefPtr const& stage,
+    size_t modelIndex,
+    TfToken const& drawMode) {
+    _Model& model = m_models[modelIndex];
+    UsdPrim prim = stage->GetPrimAtPath(model.path);
+    if (!prim) {
+        return;
+    }
+
+    if (model.drawMode.IsEmpty()) {
+        model.sessionDrawMode = GetSessionValue(stage, model.path, UsdGeomTokens->modelDrawMode);
+        model.sessionApplyDrawMode = GetSessionValue(stage, model.path, UsdGeomTokens->modelApplyDrawMode);
+    }
+
+    UsdEditContext editContext(stage, stage->GetSessionLayer());
+    UsdGeomModelAPI modelApi(prim);
+    modelApi.CreateModelDrawModeAttr().Set(drawMode);
+    modelApi.CreateModelApplyDrawModeAttr().Set(true);
+    model.drawMode = drawMode;
+}
+
+void HdRprDrawModeController::_ClearProxy(
+    UsdStageRefPtr const& stage,
+    size_t modelIndex) {
+    _Model& model = m_models[modelIndex];
+    if (UsdPrim prim = stage->GetPrimAtPath(model.path)) {
+        UsdEditContext editContext(stage, stage->GetSessionLayer());
+        UsdGeomModelAPI modelApi(prim);
+        RestoreValue(modelApi.GetModelDrawModeAttr(), model.sessionDrawMode);
+        RestoreValue(modelApi.GetModelApplyDrawModeAttr(), model.sessionApplyDrawMode);
+    }
+
+    model.drawMode = TfToken();
+    model.sessionDrawMode = VtValue();
+    model.sessionApplyDrawMode = VtValue();
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,92 @@
+#ifndef HDRPR_DRAW_MODE_CONTROLLER_H
+#define HDRPR_DRAW_MODE_CONTROLLER_H
+
+#include "api.h"
+
+#include "pxr/rprImaging/rprEngine/pathTrie.h"
+
+#include "pxr/usd/usd/common.h"
+#include "pxr/usd/usd/prim.h"
+#include "pxr/usd/usd/timeCode.h"
+#include "pxr/usd/sdf/path.h"
+#include "pxr/base/gf/bbox3d.h"
+#include "pxr/base/gf/matrix4d.h"
+#include "pxr/base/gf/vec2i.h"
+#include "pxr/base/vt/value.h"
+
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class HdRprDrawModeController
+///
+/// Switches models whose projected size falls below a threshold to a proxy
+/// draw mode (bounds or cards) and back once they grow. The draw mode is
+/// authored into the stage session layer, where UsdImaging picks it up like
+/// any other model:drawMode opinion. Only the topmost small model of a
+/// hierarchy is switched. A model grows back only when it gets noticeably
+/// larger than the threshold, so models near it don't pop every frame.
+///
+class HdRprDrawModeController {
+public:
+    HDRPR_API
+    HdRprDrawModeController();
+
+    HDRPR_API
+    ~HdRprDrawModeController();
+
+    /// Forget the gathered models, e.g. after the stage was resynced.
+    HDRPR_API
+    void Invalidate();
+
+    /// Switch models under \p root that are smaller than \p threshold
+    /// pixels to \p drawMode.
+    HDRPR_API
+    void Update(UsdPrim const& root,
+                HdRprPathTrie const& excludedPaths,
+                UsdTimeCode frame,
+                GfMatrix4d const& viewProjection,
+                GfVec2i const& viewportSize,
+                float threshold,
+                TfToken const& drawMode);
+
+    /// Restore the session layer opinions the controller overrode.
+    HDRPR_API
+    void Restore();
+
+    size_t GetProxyCount() const { return m_proxyCount; }
+
+private:
+    void _GatherModels(UsdPrim const& root, HdRprPathTrie const& excludedPaths);
+    void _SetProxy(UsdStageRefPtr const& stage, size_t modelIndex, TfToken const& drawMode);
+    void _ClearProxy(UsdStageRefPtr const& stage, size_t modelIndex);
+
+private:
+    struct _Model {
+        SdfPath path;
+        GfBBox3d bound;
+        TfToken drawMode;
+
+        // Session layer opinions before the controller overrode them
+        VtValue sessionDrawMode;
+        VtValue sessionApplyDrawMode;
+    };
+    // Models in pre-order, so ancestors come before their descendants
+    std::vector<_Model> m_models;
+    bool m_modelsValid;
+    UsdStageWeakPtr m_stage;
+
+    UsdTimeCode m_boundsFrame;
+    bool m_boundsValid;
+
+    GfMatrix4d m_viewProjection;
+    GfVec2i m_viewportSize;
+    float m_threshold;
+    TfToken m_drawMode;
+
+    size_t m_proxyCount;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_DRAW_MODE_CONTROLLER_H
@@ -1,12 +1,70 @@
 #include "pxr/rprImaging/rprEngine/engine.h"
+#include "pxr/rprImaging/rprEngine/convergenceEstimator.h"
+#include "pxr/rprImaging/rprEngine/screenSpace.h"
+#include "pxr/rprImaging/rprEngine/resolutionController.h"
+#include "pxr/rprImaging/rprEngine/refineLevelController.h"
+#include "pxr/rprImaging/rprEngine/drawModeController.h"
+#include "pxr/rprImaging/rprEngine/meshDeduplicator.h"
+#include "pxr/rprImaging/rprEngine/imagingCache.h"
+#include "pxr/rprImaging/rprEngine/imagingCacheDelegate.h"
+#include "pxr/rprImaging/rprEngine/threadArena.h"
+#include "pxr/rprImaging/rprEngine/reprojector.h"
+#include "pxr/rprImaging/rprEngine/frameCache.h"
+#include "pxr/rprImaging/rprEngine/populationMask.h"
+#include "pxr/rprImaging/rprEngine/imageWriter.h"
+#include "pxr/rprImaging/rprEngine/frustumCuller.h"
 
 #include "pxr/imaging/hd/rendererPluginRegistry.h"
+#include "pxr/imaging/hdx/renderTask.h"
+#ifndef HDRPR_ENGINE_HEADLESS
 #include "pxr/imaging/hgi/hgi.h"
 #include "pxr/imaging/hgi/tokens.h"
+#endif
+#include "pxr/usd/usd/primRange.h"
+#include "pxr/usd/usdGeom/bboxCache.h"
+#include "pxr/usd/usdGeom/camera.h"
+#include "pxr/usd/usdGeom/scope.h"
+#include "pxr/usd/usdGeom/xform.h"
+#include "pxr/usd/usdGeom/tokens.h"
+#include "pxr/usd/usdLux/light.h"
 #include "pxr/base/tf/getenv.h"
+#include "pxr/base/tf/staticTokens.h"
+#include "pxr/base/tf/stl.h"
+#include "pxr/base/tf/stringUtils.h"
+#include "pxr/base/work/loops.h"
+
+#include <boost/functional/hash.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+#include <numeric>
 
 PXR_NAMESPACE_OPEN_SCOPE
 
+TF_DEFINE_PRIVATE_TOKENS(_tokens,
+    (maxSamples)
+);
+
+namespace {
+
+// Changes to these properties can't move a prim on screen
+bool IsShadingOnlyProperty(SdfPath const& path) {
+    if (!path.IsPropertyPath()) {
+        return false;
+    }
+
+    std::string const& name = path.GetName();
+    if (TfStringStartsWith(name, "primvars:")) {
+        return name != "primvars:normals";
+    }
+    return TfStringStartsWith(name, "material:binding") ||
+           name == UsdGeomTokens->doubleSided;
+}
+
+} // namespace anonymous
+
 //----------------------------------------------------------------------------
 // Construction
 //----------------------------------------------------------------------------
@@ -15,18 +73,89 @@ HdRprEngine::HdRprEngine(
     const SdfPath& rootPath,
     const SdfPathVector& excludedPaths,
     const SdfPathVector& invisedPaths,
-    const SdfPath& delegateID)
+    const SdfPath& delegateID,
+    const HdRprEngineOptions& options)
     : m_renderIndex(nullptr)
     // , _selTracker(new HdxSelectionTracker)
     , m_delegateID(delegateID)
     , m_delegate(nullptr)
+    , m_populationShardCount(1)
+    , m_shardsDirty(false)
     , m_rendererPlugin(nullptr)
     , m_taskController(nullptr)
     // , _selectionColor(1.0f, 1.0f, 0.0f, 1.0f)
     , m_rootPath(rootPath)
-    , m_excludedPrimPaths(excludedPaths)
-    , m_invisedPrimPaths(invisedPaths)
-    , m_isPopulated(false) {
+    , m_excludedPathsDirty(true)
+    , m_populationMaskDirty(true)
+    , m_invisedPathsDirty(true)
+    , m_isPopulated(false)
+    , m_frustumCuller(new HdRprFrustumCuller)
+    , m_frustumCulling(false)
+    , m_frustumCullingMargin(0.0)
+    , m_viewport(0.0)
+    , m_viewMatrix(1.0)
+    , m_projectionMatrix(1.0)
+    , m_windowPolicy(CameraUtilFit)
+    , m_cameraMailbox(new HdRprCameraMailbox)
+    , m_renderRegion(0)
+    , m_autoRenderRegion(false)
+    , m_autoRegion(0)
+    , m_appliedRegion(0)
+    , m_appliedRenderSize(0)
+    , m_regionConverged(false)
+    , m_fullFrameDirty(true)
+    , m_aovImagesValid(false)
+    , m_aovDeltaThreshold(0.0f)
+    , m_convergenceEstimator(new HdRprConvergenceEstimator)
+    , m_convergenceThreshold(0.0f)
+    , m_resolutionController(new HdRprResolutionController)
+    , m_cameraMoved(false)
+    , m_reprojector(new HdRprReprojector)
+    , m_reprojection(false)
+    , m_reprojectionHistoryFrames(8)
+    , m_reprojectionFrame(0)
+    , m_reprojectionWarpPending(false)
+    , m_reprojectionFrameValid(false)
+    , m_reprojectionViewProjection(1.0)
+    , m_frameCacheHit(false)
+    , m_frameCacheStored(false)
+    , m_stageRevision(0)
+    , m_stageHashInputs(0)
+    , m_refineLevelController(new HdRprRefineLevelController)
+    , m_drawModeController(new HdRprDrawModeController)
+    , m_meshDeduplicator(new HdRprMeshDeduplicator)
+    , m_meshDeduplication(false)
+    , m_meshDeduplicationDirty(false)
+    , m_measureDeduplication(false)
+    , m_accumulationStart(std::chrono::steady_clock::now())
+    , m_accumulationFrameCount(0)
+    , m_cancelRequested(false)
+    , m_cancelRequestTime(0)
+    , m_renderCallDepth(0) {
+    for (SdfPath const& path : excludedPaths) {
+        m_excludedPathTrie.Insert(path);
+    }
+    for (SdfPath const& path : invisedPaths) {
+        m_invisedPathTrie.Insert(path);
+    }
+
+    std::vector<int> cpus = options.cpuAffinity;
+    if (options.numaNode >= 0) {
+        std::vector<int> nodeCpus = HdRprThreadArena::GetNumaNodeCpus(options.numaNode);
+        if (nodeCpus.empty()) {
+            TF_WARN("Failed to find the CPUs of NUMA node %d", options.numaNode);
+        }
+        cpus.insert(cpus.end(), nodeCpus.begin(), nodeCpus.end());
+    }
+    m_threadArena.reset(new HdRprThreadArena(options.threadLimit, cpus));
+    m_stats.threadLimit = size_t(m_threadArena->GetThreadLimit());
+
+#ifdef HDRPR_ENGINE_HEADLESS
+    m_headless = true;
+#else
+    m_headless = options.headless || TfGetenvBool("HDRPR_ENGINE_HEADLESS", false);
+#endif
+
     // m_renderIndex, m_taskController, and m_delegate are initialized
     // by the plugin system.
     if (!SetRendererPlugin(_GetDefaultRendererPluginId())) {
@@ -36,52 +165,245 @@ HdRprEngine::HdRprEngine(
 }
 
 HdRprEngine::~HdRprEngine() { 
+    TfNotice::Revoke(m_objectsChangedKey);
     _DeleteHydraResources();
 }
 
+//----------------------------------------------------------------------------
+// Scene
+//----------------------------------------------------------------------------
+
+void HdRprEngine::ResetScene() {
+    _SetStage(UsdStageWeakPtr());
+
+    m_frame = UsdTimeCode::Default();
+    m_dirtyPrims.clear();
+    m_primScreenRects.clear();
+}
+
+void HdRprEngine::SetStage(UsdStageRefPtr const& stage) {
+    _SetStage(stage);
+}
+
+UsdStageRefPtr HdRprEngine::OpenStage(
+    std::string const& filePath,
+    SdfPathVector const& additionalPaths,
+    UsdStage::InitialLoadSet load) {
+    SdfPathVector includedPaths;
+    _GetRenderRootScenePaths(&includedPaths);
+    includedPaths.insert(includedPaths.end(), additionalPaths.begin(), additionalPaths.end());
+
+    UsdStageRefPtr stage = HdRprOpenMaskedStage(filePath, includedPaths, m_excludedPathTrie.GetCover(), load);
+    if (stage) {
+        _SetStage(stage);
+        // The mask already matches the roots
+        m_populationMaskDirty = false;
+    }
+    return stage;
+}
+
 //----------------------------------------------------------------------------
 // Rendering
 //----------------------------------------------------------------------------
 
 void HdRprEngine::PrepareBatch(
+    const UsdPrim& root,
+    const HdRprEngineRenderParams& params) {
+    _BeginRenderCall();
+    m_threadArena->Execute([&]() { _PrepareBatch(root, params); });
+    _EndRenderCall();
+}
+
+void HdRprEngine::_PrepareBatch(
     const UsdPrim& root,
     const HdRprEngineRenderParams& params) {
     HD_TRACE_FUNCTION();
 
     TF_VERIFY(m_delegate);
 
+    _ApplyPostedCameraState();
+
     if (_CanPrepareBatch(root, params)) {
+        _SetStage(root.GetStage());
+
+        // Deduplicated meshes render through session layer instances,
+        // which hiding or excluding the original meshes doesn't affect
+        if (m_meshDeduplication && (m_excludedPathsDirty || m_invisedPathsDirty)) {
+            m_meshDeduplicationDirty = true;
+        }
+
+        if (m_excludedPathsDirty) {
+            _UpdateExcludedPaths();
+        }
+        // Before population, so that the delegates find the new prims
+        if (m_populationMaskDirty) {
+            _WidenPopulationMask();
+        }
+        if (m_invisedPathsDirty) {
+            m_invisedPrimPaths = m_invisedPathTrie.GetCover();
+        }
+
+        if (m_meshDeduplicationDirty) {
+            _UpdateMeshDeduplication(root.GetStage()->GetPrimAtPath(m_rootPath));
+        }
+        if (_IsCancelled()) {
+            return;
+        }
+
+        // Top-level prims were added or removed since the shards were
+        // computed, they would end up in none or all of them
+        if (m_shardsDirty) {
+            if (m_isPopulated) {
+                _RecreateSceneDelegate();
+            }
+            m_shardsDirty = false;
+        }
+
         if (!m_isPopulated) {
-            m_delegate->SetUsdDrawModesEnabled(params.enableUsdDrawModes);
-            m_delegate->Populate(root.GetStage()->GetPrimAtPath(m_rootPath), m_excludedPrimPaths);
-            m_delegate->SetInvisedPrimPaths(m_invisedPrimPaths);
+            _Populate(root.GetStage()->GetPrimAtPath(m_rootPath), params.enableUsdDrawModes);
+            m_populateExcludedPrimPaths = m_excludedPrimPaths;
+            _ForEachDelegate([this](UsdImagingDelegate* delegate) {
+                delegate->SetInvisedPrimPaths(m_invisedPrimPaths);
+            });
+            m_invisedPathsDirty = false;
             m_isPopulated = true;
+        } else if (m_invisedPathsDirty) {
+            // The delegate dirties only the symmetric difference to the
+            // previous paths
+            _ForEachDelegate([this](UsdImagingDelegate* delegate) {
+                delegate->SetInvisedPrimPaths(m_invisedPrimPaths);
+            });
+            m_invisedPathsDirty = false;
+            m_fullFrameDirty = true;
+        }
+
+        // Pending updates stay queued in the delegates until the next call
+        if (_IsCancelled()) {
+            return;
         }
 
         // Set the fallback refine level, if this changes from the existing value,
         // all prim refine levels will be dirtied.
-        m_delegate->SetRefineLevelFallback(params.refineLevel);
+        _ForEachDelegate([&params](UsdImagingDelegate* delegate) {
+            delegate->SetRefineLevelFallback(params.refineLevel);
+        });
 
         // TODO: recheck me
         // // Apply any queued up scene edits.
         // m_delegate->ApplyPendingUpdates();
 
         // SetTime will only react if time actually changes.
-        m_delegate->SetTime(params.frame);
+        _ForEachDelegate([&params](UsdImagingDelegate* delegate) {
+            delegate->SetTime(params.frame);
+        });
+        if (params.frame != m_frame) {
+            m_frame = params.frame;
+            m_fullFrameDirty = true;
+        }
+        if (_IsCancelled()) {
+            return;
+        }
+
+        // Override the fallback refine level of subdivision meshes based on
+        // their size on screen
+        if (params.adaptiveRefineLevel) {
+            GfMatrix4d viewMatrix, projectionMatrix;
+            if (_ComputeCameraMatrices(&viewMatrix, &projectionMatrix)) {
+                m_refineLevelController->Update(
+                    [this](SdfPath const& path) { return _GetDelegate(path); },
+                    root.GetStage()->GetPrimAtPath(m_rootPath),
+                    m_excludedPathTrie, params.frame, viewMatrix * projectionMatrix,
+                    GfVec2i(int(m_viewport[2]), int(m_viewport[3])), params.refineLevel);
+            }
+        } else {
+            m_refineLevelController->Clear([this](SdfPath const& path) { return _GetDelegate(path); });
+        }
+        m_stats.adaptiveRefineMeshCount = params.adaptiveRefineLevel ? m_refineLevelController->GetMeshCount() : 0;
+        m_stats.adaptiveRefineTrianglesSaved = m_refineLevelController->GetTrianglesSaved();
+
+        // Replace models that are too small on screen with their draw mode
+        // proxies
+        if (params.enableUsdDrawModes && params.drawModeLodThreshold > 0.0f) {
+            GfMatrix4d viewMatrix, projectionMatrix;
+            if (_ComputeCameraMatrices(&viewMatrix, &projectionMatrix)) {
+                m_drawModeController->Update(
+                    root.GetStage()->GetPrimAtPath(m_rootPath), m_excludedPathTrie,
+                    params.frame, viewMatrix * projectionMatrix,
+                    GfVec2i(int(m_viewport[2]), int(m_viewport[3])),
+                    params.drawModeLodThreshold, params.drawModeLodMode);
+            }
+        } else {
+            m_drawModeController->Restore();
+        }
+        m_stats.drawModeProxyCount = m_drawModeController->GetProxyCount();
 
         // Apply any queued up scene edits.
-        m_delegate->ApplyPendingUpdates();
+        _ForEachDelegate([](UsdImagingDelegate* delegate) {
+            delegate->ApplyPendingUpdates();
+        });
+    }
+}
+
+void HdRprEngine::PrepareBatch(const HdRprEngineRenderParams& params) {
+    _BeginRenderCall();
+    m_threadArena->Execute([&]() { _PrepareBatch(params); });
+    _EndRenderCall();
+}
+
+void HdRprEngine::_PrepareBatch(const HdRprEngineRenderParams& params) {
+    HD_TRACE_FUNCTION();
+
+    if (!m_imagingCacheDelegate) {
+        TF_CODING_ERROR("No imaging cache loaded");
+        return;
+    }
+
+    _ApplyPostedCameraState();
+
+    double frame = params.frame.IsDefault() ? m_imagingCache->GetStartFrame() : params.frame.GetValue();
+    if (m_imagingCacheDelegate->SetTime(frame)) {
+        m_fullFrameDirty = true;
     }
 }
 
 void HdRprEngine::RenderBatch(
     const SdfPathVector& paths, 
     const HdRprEngineRenderParams& params) {
+    SetRenderRoots(paths);
+    RenderBatch(params);
+}
+
+void HdRprEngine::RenderBatch(const HdRprEngineRenderParams& params) {
+    _BeginRenderCall();
+    m_threadArena->Execute([&]() { _RenderBatch(params); });
+    m_threadArena->TakeParallelism(&m_stats.peakThreadCount, &m_stats.averageParallelism);
+    _EndRenderCall();
+}
+
+void HdRprEngine::_RenderBatch(const HdRprEngineRenderParams& params) {
     TF_VERIFY(m_taskController);
 
+    auto frameStart = std::chrono::steady_clock::now();
+
+    _ApplyPostedCameraState();
+
     m_taskController->SetFreeCameraClipPlanes(params.clipPlanes);
-    _UpdateHydraCollection(&m_renderCollection, paths, params);
-    m_taskController->SetCollection(m_renderCollection);
+    _UpdateFrustumCulling();
+    SdfPathVector const* excludePaths = &m_collectionExcludePaths;
+    SdfPathVector excludedAndCulledPaths;
+    if (!m_culledCollectionPaths.empty()) {
+        excludedAndCulledPaths = m_collectionExcludePaths;
+        excludedAndCulledPaths.insert(excludedAndCulledPaths.end(),
+                                      m_culledCollectionPaths.begin(), m_culledCollectionPaths.end());
+        std::sort(excludedAndCulledPaths.begin(), excludedAndCulledPaths.end());
+        excludePaths = &excludedAndCulledPaths;
+    }
+
+    // The task controller compares full collections, only hand it a new
+    // one when something changed
+    if (_UpdateHydraCollection(&m_renderCollection, m_renderRoots, *excludePaths, params)) {
+        m_taskController->SetCollection(m_renderCollection);
+    }
 
     TfTokenVector renderTags;
     _ComputeRenderTags(params, &renderTags);
@@ -106,13 +428,120 @@ void HdRprEngine::RenderBatch(
     }
 
     // Forward scene materials enable option to delegate
-    m_delegate->SetSceneMaterialsEnabled(params.enableSceneMaterials);
+    _ForEachDelegate([&params](UsdImagingDelegate* delegate) {
+        delegate->SetSceneMaterialsEnabled(params.enableSceneMaterials);
+    });
 
     // VtValue selectionValue(_selTracker);
     // m_engine.SetTaskContextData(HdxTokens->selectionState, selectionValue);
 
+    if (params != m_lastRenderParams) {
+        m_lastRenderParams = params;
+        m_fullFrameDirty = true;
+    }
+
+    if (m_frameCache && _LookUpFrameCache(params)) {
+        for (auto& entry : m_aovDeltaTrackers) {
+            _UpdateAovDelta(entry.first, &entry.second);
+        }
+        m_regionConverged = true;
+        _UpdateRenderProgress(m_regionConverged);
+        _UpdateFrameStats(std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count());
+        return;
+    }
+
+    // Needs the scene changes before the render region consumes them
+    _BeginReprojection();
+
+    GfVec4i region = _ComputeRenderRegion();
+    _ApplyRenderRegion(region);
+
+    if (_IsCancelled()) {
+        return;
+    }
+
     auto tasks = m_taskController->GetRenderingTasks();
+    if (m_headless) {
+        // AOV input, selection and color correction tasks need Hgi and GL,
+        // the AOVs are read back from the render buffers instead
+        tasks.erase(std::remove_if(tasks.begin(), tasks.end(), [](HdTaskSharedPtr const& task) {
+            return !std::dynamic_pointer_cast<HdxRenderTask>(task) &&
+                   !std::dynamic_pointer_cast<HdxRenderSetupTask>(task);
+        }), tasks.end());
+    }
     m_engine.Execute(m_renderIndex, &tasks);
+
+    // Don't read back or estimate convergence from the interrupted frame
+    if (_IsCancelled()) {
+        return;
+    }
+
+    if (_UsesAovImages()) {
+        _ReadAovImages(region);
+        _ApplyReprojection();
+    }
+    for (auto& entry : m_aovDeltaTrackers) {
+        _UpdateAovDelta(entry.first, &entry.second);
+    }
+
+    if (params.convergenceThreshold != m_convergenceThreshold) {
+        m_convergenceThreshold = params.convergenceThreshold;
+        m_convergenceEstimator->Reset();
+    }
+    if (m_convergenceThreshold > 0.0f) {
+        m_convergenceEstimator->Update(GetAovBuffer(HdAovTokens->color));
+    }
+
+    m_regionConverged = IsConverged();
+    if (m_frameCache) {
+        _StoreFrameCache();
+    }
+    _UpdateRenderProgress(m_regionConverged);
+
+    _UpdateFrameStats(std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count());
+}
+
+HdRprRenderProgress HdRprEngine::GetRenderProgress() const {
+    std::lock_guard<std::mutex> lock(m_renderProgressMutex);
+    return m_renderProgress;
+}
+
+void HdRprEngine::SetRenderRoots(SdfPathVector const& paths) {
+    // Callers usually pass the same sorted roots every batch
+    if (paths == m_renderRoots) {
+        return;
+    }
+
+    m_renderRoots = paths;
+    if (!std::is_sorted(m_renderRoots.begin(), m_renderRoots.end())) {
+        std::sort(m_renderRoots.begin(), m_renderRoots.end());
+    }
+    m_renderRoots.erase(std::unique(m_renderRoots.begin(), m_renderRoots.end()), m_renderRoots.end());
+    m_populationMaskDirty = true;
+}
+
+void HdRprEngine::AddRenderRoots(SdfPathVector const& paths) {
+    SdfPathVector added = paths;
+    std::sort(added.begin(), added.end());
+
+    SdfPathVector roots;
+    roots.reserve(m_renderRoots.size() + added.size());
+    std::set_union(m_renderRoots.begin(), m_renderRoots.end(),
+                   added.begin(), added.end(), std::back_inserter(roots));
+    roots.erase(std::unique(roots.begin(), roots.end()), roots.end());
+    m_renderRoots = std::move(roots);
+    m_populationMaskDirty = true;
+}
+
+void HdRprEngine::RemoveRenderRoots(SdfPathVector const& paths) {
+    SdfPathVector removed = paths;
+    std::sort(removed.begin(), removed.end());
+
+    SdfPathVector roots;
+    roots.reserve(m_renderRoots.size());
+    std::set_difference(m_renderRoots.begin(), m_renderRoots.end(),
+                        removed.begin(), removed.end(), std::back_inserter(roots));
+    m_renderRoots = std::move(roots);
 }
 
 void HdRprEngine::Render(
@@ -120,19 +549,50 @@ void HdRprEngine::Render(
     const HdRprEngineRenderParams &params) {
     TF_VERIFY(m_taskController);
 
+    _BeginRenderCall();
     PrepareBatch(root, params);
+    if (_IsCancelled()) {
+        _EndRenderCall();
+        return;
+    }
 
     // XXX(UsdImagingPaths): Is it correct to map USD root path directly
     // to the cachePath here?
     SdfPath cachePath = root.GetPath();
-    SdfPathVector paths(1, m_delegate->ConvertCachePathToIndexPath(cachePath));
+    SdfPathVector paths;
+    _ForEachDelegate([&paths, &cachePath](UsdImagingDelegate* delegate) {
+        paths.push_back(delegate->ConvertCachePathToIndexPath(cachePath));
+    });
 
     RenderBatch(paths, params);
+    _EndRenderCall();
+}
+
+void HdRprEngine::Cancel() {
+    // The time goes first, the rendering thread reads it after the flag
+    if (!m_cancelRequested.load()) {
+        m_cancelRequestTime.store(std::chrono::steady_clock::now().time_since_epoch().count());
+        m_cancelRequested.store(true);
+    }
 }
 
 bool HdRprEngine::IsConverged() const {
     TF_VERIFY(m_taskController);
-    return m_taskController->IsConverged();
+    if (m_frameCacheHit || m_taskController->IsConverged()) {
+        return true;
+    }
+
+    // Allow to stop progressive rendering once the image is good enough
+    return m_convergenceThreshold > 0.0f &&
+           m_convergenceEstimator->IsConverged(m_convergenceThreshold);
+}
+
+std::vector<float> HdRprEngine::GetConvergenceMap(GfVec2i* tileCount) const {
+    return m_convergenceEstimator->GetConvergenceMap(tileCount);
+}
+
+float HdRprEngine::GetConvergenceError() const {
+    return m_convergenceEstimator->GetError();
 }
 
 //----------------------------------------------------------------------------
@@ -141,7 +601,14 @@ bool HdRprEngine::IsConverged() const {
 
 void HdRprEngine::SetRenderViewport(GfVec4d const& viewport) {
     TF_VERIFY(m_taskController);
-    m_taskController->SetRenderViewport(viewport);
+    if (viewport != m_viewport) {
+        m_viewport = viewport;
+        _ResetAccumulation();
+
+        // Forwarded to the task controller by the next render, which may
+        // render a region or at a lower resolution.
+        m_appliedRegion = GfVec4i(0);
+    }
 }
 
 void HdRprEngine::SetWindowPolicy(CameraUtilConformWindowPolicy policy) {
@@ -150,163 +617,632 @@ void HdRprEngine::SetWindowPolicy(CameraUtilConformWindowPolicy policy) {
     // pre-adjusted for the viewport size.
     
     // The usdImagingDelegate manages the window policy for scene cameras.
-    m_delegate->SetWindowPolicy(policy);
+    _ForEachDelegate([policy](UsdImagingDelegate* delegate) {
+        delegate->SetWindowPolicy(policy);
+    });
+    if (policy != m_windowPolicy) {
+        m_windowPolicy = policy;
+        m_appliedRegion = GfVec4i(0);
+    }
 }
 
 void HdRprEngine::SetCameraPath(SdfPath const& id) {
     TF_VERIFY(m_taskController);
-    m_taskController->SetCameraPath(id);
+    if (id != m_cameraPath) {
+        m_cameraPath = id;
+        m_cameraMoved = true;
+        m_appliedRegion = GfVec4i(0);
+        _ResetAccumulation();
+    }
 
     // The camera that is set for viewing will also be used for
     // time sampling.
-    m_delegate->SetCameraForSampling(id);
+    _ForEachDelegate([&id](UsdImagingDelegate* delegate) {
+        delegate->SetCameraForSampling(id);
+    });
 }
 
 void HdRprEngine::SetCameraState(
     const GfMatrix4d& viewMatrix,
     const GfMatrix4d& projectionMatrix) {
     TF_VERIFY(m_taskController);
-    m_taskController->SetFreeCameraMatrices(viewMatrix, projectionMatrix);
+    if (!m_cameraPath.IsEmpty() ||
+        viewMatrix != m_viewMatrix || projectionMatrix != m_projectionMatrix) {
+        m_cameraPath = SdfPath();
+        m_viewMatrix = viewMatrix;
+        m_projectionMatrix = projectionMatrix;
+        m_cameraMoved = true;
+        m_appliedRegion = GfVec4i(0);
+        _ResetAccumulation();
+    }
+}
+
+void HdRprEngine::PostCameraState(HdRprCameraState const& state) {
+    m_cameraMailbox->Post(state);
 }
 
 //----------------------------------------------------------------------------
-// Renderer Plugin Management
+// Dynamic Resolution
 //----------------------------------------------------------------------------
 
-/* static */
-TfTokenVector HdRprEngine::GetRendererPlugins() {
-    HfPluginDescVector pluginDescriptors;
-    HdRendererPluginRegistry::GetInstance().GetPluginDescs(&pluginDescriptors);
+void HdRprEngine::SetTargetFrameTime(double seconds) {
+    m_resolutionController->SetTargetFrameTime(seconds);
+}
 
-    TfTokenVector plugins;
-    for(size_t i = 0; i < pluginDescriptors.size(); ++i) {
-        plugins.push_back(pluginDescriptors[i].id);
-    }
-    return plugins;
+void HdRprEngine::SetMinRenderScale(float scale) {
+    m_resolutionController->SetMinScale(scale);
 }
 
-/* static */
-std::string HdRprEngine::GetRendererDisplayName(TfToken const &id) {
-    if (id.IsEmpty()) {
-        return std::string();
-    }
+float HdRprEngine::GetRenderScale() const {
+    return m_resolutionController->IsEnabled() ? m_resolutionController->GetScale() : 1.0f;
+}
 
-    HfPluginDesc pluginDescriptor;
-    if (!TF_VERIFY(HdRendererPluginRegistry::GetInstance().GetPluginDesc(id, &pluginDescriptor))) {
-        return std::string();
+//----------------------------------------------------------------------------
+// Reprojection
+//----------------------------------------------------------------------------
+
+void HdRprEngine::SetReprojection(bool enabled, int historyFrames) {
+    m_reprojectionHistoryFrames = std::max(historyFrames, 1);
+    if (enabled == m_reprojection) {
+        return;
     }
 
-    return pluginDescriptor.displayName;
+    m_reprojection = enabled;
+    m_reprojectionWarpPending = false;
+    m_reprojectionFrameValid = false;
+    m_reprojector->Invalidate();
+
+    if (enabled &&
+        std::find(m_rendererAovs.begin(), m_rendererAovs.end(), HdAovTokens->depth) == m_rendererAovs.end()) {
+        TF_WARN("Reprojection needs the depth AOV, which is not set");
+    }
 }
 
-bool HdRprEngine::SetRendererPlugin(TfToken const &id) {
-    HdRendererPlugin *plugin = nullptr;
-    TfToken actualId = id;
+//----------------------------------------------------------------------------
+// Frame Cache
+//----------------------------------------------------------------------------
 
-    // Special case: TfToken() selects the first plugin in the list.
-    if (actualId.IsEmpty()) {
-        actualId = HdRendererPluginRegistry::GetInstance().GetDefaultPluginId();
+bool HdRprEngine::SetFrameCache(std::string const& directory, size_t maxBytes) {
+    m_frameCacheKey = HdRprFrameDigest();
+    m_frameCacheHit = false;
+    m_frameCacheStored = false;
+
+    if (directory.empty()) {
+        m_frameCache.reset();
+        return true;
     }
-    plugin = HdRendererPluginRegistry::GetInstance().GetRendererPlugin(actualId);
 
-    if (plugin == nullptr) {
-        TF_CODING_ERROR("Couldn't find plugin for id %s", actualId.GetText());
-        return false;
-    } else if (plugin == m_rendererPlugin) {
-        // It's a no-op to load the same plugin twice.
-        HdRendererPluginRegistry::GetInstance().ReleasePlugin(plugin);
+    if (m_frameCache && m_frameCache->GetDirectory() == directory) {
+        m_frameCache->SetMaxBytes(maxBytes);
         return true;
-    } else if (!plugin->IsSupported()) {
-        // Don't do anything if the plugin isn't supported on the running
-        // system, just return that we're not able to set it.
-        HdRendererPluginRegistry::GetInstance().ReleasePlugin(plugin);
-        return false;
     }
 
-    HdRenderDelegate *renderDelegate = plugin->CreateRenderDelegate();
-    if(!renderDelegate) {
-        HdRendererPluginRegistry::GetInstance().ReleasePlugin(plugin);
+    m_frameCache.reset(new HdRprFrameCache(directory, maxBytes));
+    if (!m_frameCache->IsValid()) {
+        m_frameCache.reset();
         return false;
     }
+    m_stats.frameCacheBytes = m_frameCache->GetSize();
+    return true;
+}
 
-    // Pull old delegate/task controller state.
-    GfMatrix4d rootTransform = GfMatrix4d(1.0);
-    bool isVisible = true;
-    if (m_delegate != nullptr) {
-        rootTransform = m_delegate->GetRootTransform();
-        isVisible = m_delegate->GetRootVisibility();
+//----------------------------------------------------------------------------
+// Tiled Rendering
+//----------------------------------------------------------------------------
+
+bool HdRprEngine::RenderTiled(
+    UsdPrim const& root,
+    HdRprEngineRenderParams const& params,
+    GfVec2i const& imageSize,
+    int tileSize,
+    std::map<TfToken, std::string> const& outputFiles,
+    int maxIterations) {
+    if (imageSize[0] <= 0 || imageSize[1] <= 0 || tileSize <= 0) {
+        TF_CODING_ERROR("Invalid tiled render of %dx%d pixels in tiles of %d",
+                        imageSize[0], imageSize[1], tileSize);
+        return false;
+    }
+    for (auto const& output : outputFiles) {
+        if (std::find(m_rendererAovs.begin(), m_rendererAovs.end(), output.first) == m_rendererAovs.end()) {
+            TF_CODING_ERROR("AOV %s is not set", output.first.GetText());
+            return false;
+        }
+    }
+    if (!m_imagingCacheDelegate && !root) {
+        TF_CODING_ERROR("Invalid root prim for a tiled render");
+        return false;
     }
-    // HdSelectionSharedPtr selection = m_selTracker->GetSelectionMap();
-    // if (!selection) {
-    //     selection.reset(new HdSelection);
-    // }
 
-    // Delete hydra state.
-    _DeleteHydraResources();
+    // Keeps cancellation requests across the batches of all tiles
+    _BeginRenderCall();
+
+    // Each tile is a frame of its own to screen-space features, which would
+    // carry one tile over to the next
+    GfVec4d viewport = m_viewport;
+    SdfPath cameraPath = m_cameraPath;
+    GfMatrix4d viewMatrix = m_viewMatrix;
+    GfMatrix4d projectionMatrix = m_projectionMatrix;
+    GfVec4i renderRegion = m_renderRegion;
+    bool autoRenderRegion = m_autoRenderRegion;
+    double targetFrameTime = m_resolutionController->GetTargetFrameTime();
+    bool reprojection = m_reprojection;
+    ClearRenderRegion();
+    SetAutoRenderRegionEnabled(false);
+    SetTargetFrameTime(0.0);
+    SetReprojection(false, m_reprojectionHistoryFrames);
+
+    // The camera is conformed to the whole image, then narrowed to each tile
+    SetRenderViewport(GfVec4d(0.0, 0.0, imageSize[0], imageSize[1]));
+    if (m_imagingCacheDelegate) {
+        PrepareBatch(params);
+    } else {
+        PrepareBatch(root, params);
+    }
+    GfMatrix4d imageViewMatrix, imageProjectionMatrix;
+    bool success = !_IsCancelled() && _ComputeCameraMatrices(&imageViewMatrix, &imageProjectionMatrix);
+
+    SetRenderViewport(GfVec4d(0.0, 0.0, tileSize, tileSize));
+
+    std::map<TfToken, HdRprTiledExrWriter> writers;
+    GfVec2i tileCount((imageSize[0] + tileSize - 1) / tileSize, (imageSize[1] + tileSize - 1) / tileSize);
+    for (int tileY = 0; success && tileY < tileCount[1]; ++tileY) {
+        for (int tileX = 0; success && tileX < tileCount[0]; ++tileX) {
+            // Tiles are counted from the top left like EXR tiles, regions
+            // from the bottom left. Edge tiles extend past the image and are
+            // cropped on write.
+            GfVec4i tileRegion(tileX * tileSize, imageSize[1] - (tileY + 1) * tileSize, tileSize, tileSize);
+            SetCameraState(imageViewMatrix,
+                HdRprComputeRegionProjection(imageProjectionMatrix, imageSize, tileRegion));
+
+            int iteration = 0;
+            do {
+                if (m_imagingCacheDelegate) {
+                    PrepareBatch(params);
+                    RenderBatch(params);
+                } else {
+                    Render(root, params);
+                }
+            } while (!_IsCancelled() && !IsConverged() && ++iteration < maxIterations);
+            if (_IsCancelled()) {
+                success = false;
+                break;
+            }
 
-    // Recreate the render index.
-    m_rendererPlugin = plugin;
-    m_rendererId = actualId;
+            for (auto const& output : outputFiles) {
+                HdRprTiledExrWriter& writer = writers[output.first];
+
+                // Frame cache hits are only available as AOV images
+                HdRprAovImage const* image = GetAovImage(output.first);
+                if (image && !image->IsEmpty()) {
+                    if (!writer.IsOpen() &&
+                        !writer.Open(output.second, imageSize[0], imageSize[1], image->GetFormat(), tileSize)) {
+                        success = false;
+                        break;
+                    }
+                    success = writer.WriteTile(tileX, tileY, image->GetData(), image->GetWidth(), image->GetHeight());
+                } else {
+                    HdRenderBuffer* buffer = GetAovBuffer(output.first);
+                    if (!buffer) {
+                        success = false;
+                        break;
+                    }
+                    buffer->Resolve();
+                    if (!writer.IsOpen() &&
+                        !writer.Open(output.second, imageSize[0], imageSize[1], buffer->GetFormat(), tileSize)) {
+                        success = false;
+                        break;
+                    }
+                    void* data = buffer->Map();
+                    success = data && writer.WriteTile(tileX, tileY, data, int(buffer->GetWidth()), int(buffer->GetHeight()));
+                    buffer->Unmap();
+                }
+                if (!success) {
+                    break;
+                }
+            }
+        }
+    }
 
-    auto hgi = Hgi::GetPlatformDefaultHgi();
-    HdDriver hgiDriver{HgiTokens->renderDriver, VtValue(hgi)};
-    m_renderIndex = HdRenderIndex::New(renderDelegate, {&hgiDriver});
+    for (auto& writer : writers) {
+        success = writer.second.Close() && success;
+    }
 
-    // Create the new delegate & task controller.
-    m_delegate = new UsdImagingDelegate(m_renderIndex, m_delegateID);
-    m_isPopulated = false;
+    SetRenderViewport(viewport);
+    if (cameraPath.IsEmpty()) {
+        SetCameraState(viewMatrix, projectionMatrix);
+    } else {
+        SetCameraPath(cameraPath);
+    }
+    if (!HdRprIsRectEmpty(renderRegion)) {
+        SetRenderRegion(renderRegion);
+    }
+    SetAutoRenderRegionEnabled(autoRenderRegion);
+    SetTargetFrameTime(targetFrameTime);
+    SetReprojection(reprojection, m_reprojectionHistoryFrames);
 
-    m_taskController = new HdxTaskController(m_renderIndex,
-        m_delegateID.AppendChild(TfToken(TfStringPrintf(
-            "_UsdImaging_%s_%p",
-            TfMakeValidIdentifier(actualId.GetText()).c_str(),
-            this))));
+    _EndRenderCall();
+    return success;
+}
 
-    // Rebuild state in the new delegate/task controller.
-    m_delegate->SetRootVisibility(isVisible);
-    m_delegate->SetRootTransform(rootTransform);
-    // m_selTracker->SetSelection(selection);
-    // m_taskController->SetSelectionColor(m_selectionColor);
+//----------------------------------------------------------------------------
+// Frustum Culling
+//----------------------------------------------------------------------------
 
-    return true;
+void HdRprEngine::SetFrustumCulling(bool enabled, double margin) {
+    m_frustumCulling = enabled;
+    m_frustumCullingMargin = std::max(margin, 0.0);
 }
 
 //----------------------------------------------------------------------------
-// AOVs and Renderer Settings
+// Mesh Deduplication
 //----------------------------------------------------------------------------
 
-bool HdRprEngine::SetRendererAovs(TfTokenVector const &ids) {
-    TF_VERIFY(m_renderIndex);
-    if (m_renderIndex->IsBprimTypeSupported(HdPrimTypeTokens->renderBuffer)) {
-        m_rendererAovs = TfTokenVector();
-        auto renderDelegate = m_renderIndex->GetRenderDelegate();
-        for (auto const& aov : ids) {
-            if (renderDelegate->GetDefaultAovDescriptor(aov).format != HdFormatInvalid) {
-                m_rendererAovs.push_back(aov);
-            } else {
-                TF_RUNTIME_ERROR("Could not set \"%s\" AOV: unsupported by render delegate\n", aov.GetText());
-            }
-        }
-
-        m_taskController->SetRenderOutputs(m_rendererAovs);
-        return true;
+void HdRprEngine::SetMeshDeduplicationEnabled(bool enabled) {
+    if (m_meshDeduplication != enabled) {
+        m_meshDeduplication = enabled;
+        m_meshDeduplicationDirty = true;
     }
-    return false;
 }
 
-HdRenderBuffer* HdRprEngine::GetAovBuffer(TfToken const& id) {
-    TF_VERIFY(m_taskController);
-    return m_taskController->GetRenderOutput(id);
+//----------------------------------------------------------------------------
+// Population
+//----------------------------------------------------------------------------
+
+void HdRprEngine::SetPopulationShardCount(int count) {
+    m_populationShardCount = std::max(count, 1);
 }
 
 //----------------------------------------------------------------------------
-// Private/Protected
+// Threading
 //----------------------------------------------------------------------------
 
-bool  HdRprEngine::_CanPrepareBatch(
-    const UsdPrim& root, 
-    const HdRprEngineRenderParams& params) {
-    HD_TRACE_FUNCTION();
+void HdRprEngine::Execute(std::function<void()> const& fn) {
+    m_threadArena->Execute(fn);
+}
+
+//----------------------------------------------------------------------------
+// Imaging Cache
+//----------------------------------------------------------------------------
+
+bool HdRprEngine::LoadImagingCache(std::string const& filePath) {
+    std::unique_ptr<HdRprImagingCache> cache = HdRprImagingCache::Open(filePath);
+    if (!cache) {
+        return false;
+    }
+
+    UnloadImagingCache();
+    m_imagingCache = std::move(cache);
+    if (m_renderIndex) {
+        _CreateImagingCacheDelegate();
+    }
+    return true;
+}
+
+void HdRprEngine::UnloadImagingCache() {
+    if (m_imagingCacheDelegate) {
+        RemoveRenderRoots({m_imagingCacheDelegate->GetDelegateID()});
+        m_imagingCacheDelegate.reset();
+        _ResetAccumulation();
+        m_fullFrameDirty = true;
+    }
+
+    // Rprims referencing the mapping are gone with the delegate
+    m_imagingCache.reset();
+}
+
+//----------------------------------------------------------------------------
+// Visibility and Exclusion
+//----------------------------------------------------------------------------
+
+void HdRprEngine::AddInvisedPaths(SdfPathVector const& paths) {
+    for (SdfPath const& path : paths) {
+        if (m_invisedPathTrie.Insert(path)) {
+            m_invisedPathsDirty = true;
+        }
+    }
+}
+
+void HdRprEngine::RemoveInvisedPaths(SdfPathVector const& paths) {
+    for (SdfPath const& path : paths) {
+        if (m_invisedPathTrie.Erase(path)) {
+            m_invisedPathsDirty = true;
+        }
+    }
+}
+
+void HdRprEngine::ClearInvisedPaths() {
+    if (!m_invisedPathTrie.IsEmpty()) {
+        m_invisedPathTrie.Clear();
+        m_invisedPathsDirty = true;
+    }
+}
+
+bool HdRprEngine::IsInvised(SdfPath const& path) const {
+    return m_invisedPathTrie.IsCovered(path);
+}
+
+void HdRprEngine::AddExcludedPaths(SdfPathVector const& paths) {
+    for (SdfPath const& path : paths) {
+        if (m_excludedPathTrie.Insert(path)) {
+            m_excludedPathsDirty = true;
+        }
+    }
+}
+
+void HdRprEngine::RemoveExcludedPaths(SdfPathVector const& paths) {
+    for (SdfPath const& path : paths) {
+        if (m_excludedPathTrie.Erase(path)) {
+            m_excludedPathsDirty = true;
+            m_populationMaskDirty = true;
+        }
+    }
+}
+
+void HdRprEngine::ClearExcludedPaths() {
+    if (!m_excludedPathTrie.IsEmpty()) {
+        m_excludedPathTrie.Clear();
+        m_excludedPathsDirty = true;
+        m_populationMaskDirty = true;
+    }
+}
+
+bool HdRprEngine::IsExcluded(SdfPath const& path) const {
+    return m_excludedPathTrie.IsCovered(path);
+}
+
+//----------------------------------------------------------------------------
+// Region of Interest
+//----------------------------------------------------------------------------
+
+void HdRprEngine::SetRenderRegion(GfVec4i const& region) {
+    m_renderRegion = region;
+}
+
+void HdRprEngine::ClearRenderRegion() {
+    m_renderRegion = GfVec4i(0);
+}
+
+void HdRprEngine::SetAutoRenderRegionEnabled(bool enabled) {
+    if (enabled != m_autoRenderRegion) {
+        m_autoRenderRegion = enabled;
+        m_dirtyPrims.clear();
+        m_primScreenRects.clear();
+        m_fullFrameDirty = true;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Renderer Plugin Management
+//----------------------------------------------------------------------------
+
+/* static */
+TfTokenVector HdRprEngine::GetRendererPlugins() {
+    HfPluginDescVector pluginDescriptors;
+    HdRendererPluginRegistry::GetInstance().GetPluginDescs(&pluginDescriptors);
+
+    TfTokenVector plugins;
+    for(size_t i = 0; i < pluginDescriptors.size(); ++i) {
+        plugins.push_back(pluginDescriptors[i].id);
+    }
+    return plugins;
+}
+
+/* static */
+std::string HdRprEngine::GetRendererDisplayName(TfToken const &id) {
+    if (id.IsEmpty()) {
+        return std::string();
+    }
+
+    HfPluginDesc pluginDescriptor;
+    if (!TF_VERIFY(HdRendererPluginRegistry::GetInstance().GetPluginDesc(id, &pluginDescriptor))) {
+        return std::string();
+    }
+
+    return pluginDescriptor.displayName;
+}
+
+bool HdRprEngine::SetRendererPlugin(TfToken const &id) {
+    auto startupStart = std::chrono::steady_clock::now();
+
+    HdRendererPlugin *plugin = nullptr;
+    TfToken actualId = id;
+
+    // Special case: TfToken() selects the first plugin in the list.
+    if (actualId.IsEmpty()) {
+        actualId = HdRendererPluginRegistry::GetInstance().GetDefaultPluginId();
+    }
+    plugin = HdRendererPluginRegistry::GetInstance().GetRendererPlugin(actualId);
+
+    if (plugin == nullptr) {
+        TF_CODING_ERROR("Couldn't find plugin for id %s", actualId.GetText());
+        return false;
+    } else if (plugin == m_rendererPlugin) {
+        // It's a no-op to load the same plugin twice.
+        HdRendererPluginRegistry::GetInstance().ReleasePlugin(plugin);
+        return true;
+    } else if (!plugin->IsSupported()) {
+        // Don't do anything if the plugin isn't supported on the running
+        // system, just return that we're not able to set it.
+        HdRendererPluginRegistry::GetInstance().ReleasePlugin(plugin);
+        return false;
+    }
+
+    HdRenderDelegate *renderDelegate = plugin->CreateRenderDelegate();
+    if(!renderDelegate) {
+        HdRendererPluginRegistry::GetInstance().ReleasePlugin(plugin);
+        return false;
+    }
+
+    // Pull old delegate/task controller state.
+    GfMatrix4d rootTransform = GfMatrix4d(1.0);
+    bool isVisible = true;
+    if (m_delegate != nullptr) {
+        rootTransform = m_delegate->GetRootTransform();
+        isVisible = m_delegate->GetRootVisibility();
+    }
+    // HdSelectionSharedPtr selection = m_selTracker->GetSelectionMap();
+    // if (!selection) {
+    //     selection.reset(new HdSelection);
+    // }
+
+    // Delete hydra state.
+    _DeleteHydraResources();
+
+    // Recreate the render index.
+    m_rendererPlugin = plugin;
+    m_rendererId = actualId;
+
+    HdDriverVector drivers;
+    m_stats.hgiStartupTime = 0.0;
+#ifndef HDRPR_ENGINE_HEADLESS
+    HdDriver hgiDriver;
+    if (!m_headless) {
+        auto hgiStart = std::chrono::steady_clock::now();
+        hgiDriver.name = HgiTokens->renderDriver;
+        hgiDriver.driver = VtValue(Hgi::GetPlatformDefaultHgi());
+        drivers.push_back(&hgiDriver);
+        m_stats.hgiStartupTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - hgiStart).count();
+    }
+#endif
+    m_renderIndex = HdRenderIndex::New(renderDelegate, drivers);
+
+    // Create the new delegate & task controller.
+    m_delegate = new UsdImagingDelegate(m_renderIndex, m_delegateID);
+    m_isPopulated = false;
+    if (m_imagingCache) {
+        _CreateImagingCacheDelegate();
+    }
+
+    m_taskController = new HdxTaskController(m_renderIndex,
+        m_delegateID.AppendChild(TfToken(TfStringPrintf(
+            "_UsdImaging_%s_%p",
+            TfMakeValidIdentifier(actualId.GetText()).c_str(),
+            this))));
+
+    // Rebuild state in the new delegate/task controller.
+    m_delegate->SetRootVisibility(isVisible);
+    m_delegate->SetRootTransform(rootTransform);
+    // m_selTracker->SetSelection(selection);
+    // m_taskController->SetSelectionColor(m_selectionColor);
+
+    // Per-prim state of the old delegate is gone
+    m_refineLevelController->Clear(nullptr);
+
+    // Camera, viewport and collection are forwarded to the new task
+    // controller by the next render.
+    m_appliedRegion = GfVec4i(0);
+    m_renderCollection = HdRprimCollection();
+    _ResetAccumulation();
+
+    // The new task controller has its default outputs until
+    // SetRendererAovs() is called again
+    m_rendererAovs.clear();
+
+    m_stats.rendererStartupTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startupStart).count();
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// AOVs and Renderer Settings
+//----------------------------------------------------------------------------
+
+void HdRprEngine::SetRendererSetting(TfToken const& id, VtValue const& value) {
+    TF_VERIFY(m_renderIndex);
+    HdRenderDelegate* renderDelegate = m_renderIndex->GetRenderDelegate();
+    if (renderDelegate->GetRenderSetting(id) != value) {
+        renderDelegate->SetRenderSetting(id, value);
+        m_fullFrameDirty = true;
+        _ResetAccumulation();
+    }
+}
+
+VtValue HdRprEngine::GetRendererSetting(TfToken const& id) const {
+    TF_VERIFY(m_renderIndex);
+    return m_renderIndex->GetRenderDelegate()->GetRenderSetting(id);
+}
+
+bool HdRprEngine::SetRendererAovs(TfTokenVector const &ids) {
+    TF_VERIFY(m_renderIndex);
+    if (m_renderIndex->IsBprimTypeSupported(HdPrimTypeTokens->renderBuffer)) {
+        TfTokenVector rendererAovs;
+        auto renderDelegate = m_renderIndex->GetRenderDelegate();
+        for (auto const& aov : ids) {
+            if (renderDelegate->GetDefaultAovDescriptor(aov).format != HdFormatInvalid) {
+                rendererAovs.push_back(aov);
+            } else {
+                TF_RUNTIME_ERROR("Could not set \"%s\" AOV: unsupported by render delegate\n", aov.GetText());
+            }
+        }
+
+        // The task controller recreates all render buffers for a new set
+        if (rendererAovs == m_rendererAovs) {
+            return true;
+        }
+        m_rendererAovs = rendererAovs;
+
+        m_taskController->SetRenderOutputs(m_rendererAovs);
+        m_aovImages.clear();
+        TfTokenVector removedAovs;
+        for (auto const& entry : m_aovDeltaTrackers) {
+            if (std::find(m_rendererAovs.begin(), m_rendererAovs.end(), entry.first) == m_rendererAovs.end()) {
+                removedAovs.push_back(entry.first);
+            }
+        }
+        for (auto const& aov : removedAovs) {
+            m_aovDeltaTrackers.erase(aov);
+        }
+        _ResetAccumulation();
+        return true;
+    }
+    return false;
+}
+
+HdRenderBuffer* HdRprEngine::GetAovBuffer(TfToken const& id) {
+    TF_VERIFY(m_taskController);
+    return m_taskController->GetRenderOutput(id);
+}
+
+HdRprAovImage const* HdRprEngine::GetAovImage(TfToken const& id) const {
+    if (!_UsesAovImages() || !m_aovImagesValid) {
+        return nullptr;
+    }
+    return TfMapLookupPtr(m_aovImages, id);
+}
+
+bool HdRprEngine::ReadAovDelta(
+    TfToken const& id,
+    uint64_t sinceGeneration,
+    std::vector<HdRprAovTile>* tiles,
+    uint64_t* generation) {
+    if (!TF_VERIFY(tiles && generation)) {
+        return false;
+    }
+    tiles->clear();
+
+    if (std::find(m_rendererAovs.begin(), m_rendererAovs.end(), id) == m_rendererAovs.end()) {
+        return false;
+    }
+
+    auto it = m_aovDeltaTrackers.find(id);
+    if (it == m_aovDeltaTrackers.end()) {
+        // Later frames update the tracker as part of RenderBatch
+        it = m_aovDeltaTrackers.emplace(id, HdRprAovDeltaTracker()).first;
+        _UpdateAovDelta(id, &it->second);
+    }
+
+    it->second.ReadDelta(sinceGeneration, tiles);
+    *generation = it->second.GetGeneration();
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// Private/Protected
+//----------------------------------------------------------------------------
+
+bool  HdRprEngine::_CanPrepareBatch(
+    const UsdPrim& root, 
+    const HdRprEngineRenderParams& params) {
+    HD_TRACE_FUNCTION();
 
     if (!TF_VERIFY(root, "Attempting to draw an invalid/null prim\n")) 
         return false;
@@ -324,6 +1260,7 @@ bool  HdRprEngine::_CanPrepareBatch(
 bool HdRprEngine::_UpdateHydraCollection(
     HdRprimCollection *collection,
     SdfPathVector const& roots,
+    SdfPathVector const& excludePaths,
     HdRprEngineRenderParams const& params) {
     if (collection == nullptr) {
         TF_CODING_ERROR("Null passed to _UpdateHydraCollection");
@@ -338,38 +1275,28 @@ bool HdRprEngine::_UpdateHydraCollection(
     // By default our main collection will be called geometry
     TfToken colName = HdTokens->geometry;
 
-    // Check if the collection needs to be updated (so we can avoid the sort).
-    SdfPathVector const& oldRoots = collection->GetRootPaths();
-
-    // inexpensive comparison first
-    bool match = collection->GetName() == colName &&
-                 oldRoots.size() == roots.size() &&
-                 collection->GetReprSelector() == reprSelector;
-
-    // Only take the time to compare root paths if everything else matches.
-    if (match) {
-        // Note that oldRoots is guaranteed to be sorted.
-        for(size_t i = 0; i < roots.size(); i++) {
-            // Avoid binary search when both vectors are sorted.
-            if (oldRoots[i] == roots[i])
-                continue;
-            // Binary search to find the current root.
-            if (!std::binary_search(oldRoots.begin(), oldRoots.end(), roots[i])) 
-            {
-                match = false;
-                break;
-            }
-        }
-
-        // if everything matches, do nothing.
-        if (match) return false;
+    // Only a change of the collection kind requires to recreate it.
+    if (collection->GetName() != colName ||
+        collection->GetReprSelector() != reprSelector) {
+        *collection = HdRprimCollection(colName, reprSelector);
+        collection->SetRootPaths(roots);
+        collection->SetExcludePaths(excludePaths);
+        return true;
     }
 
-    // Recreate the collection.
-    *collection = HdRprimCollection(colName, reprSelector);
-    collection->SetRootPaths(roots);
+    // Both root vectors are sorted, so a linear comparison detects any
+    // difference.
+    bool changed = false;
+    if (collection->GetRootPaths() != roots) {
+        collection->SetRootPaths(roots);
+        changed = true;
+    }
+    if (collection->GetExcludePaths() != excludePaths) {
+        collection->SetExcludePaths(excludePaths);
+        changed = true;
+    }
 
-    return true;
+    return changed;
 }
 
 /* static */
@@ -417,10 +1344,12 @@ void HdRprEngine::_DeleteHydraResources() {
         delete m_taskController;
         m_taskController = nullptr;
     }
+    _DeleteShardDelegates();
     if (m_delegate != nullptr) {
         delete m_delegate;
         m_delegate = nullptr;
     }
+    m_imagingCacheDelegate.reset();
     HdRenderDelegate* renderDelegate = nullptr;
     if (m_renderIndex != nullptr) {
         renderDelegate = m_renderIndex->GetRenderDelegate();
@@ -437,6 +1366,912 @@ void HdRprEngine::_DeleteHydraResources() {
     }
 }
 
+void HdRprEngine::_BeginRenderCall() {
+    // A request that arrived between calls was meant for the previous one
+    if (m_renderCallDepth++ == 0) {
+        m_cancelRequested.store(false);
+    }
+}
+
+void HdRprEngine::_EndRenderCall() {
+    if (--m_renderCallDepth > 0 || !m_cancelRequested.exchange(false)) {
+        return;
+    }
+
+    auto requestTime = std::chrono::steady_clock::time_point(
+        std::chrono::steady_clock::duration(m_cancelRequestTime.load()));
+    double latency = std::chrono::duration<double>(std::chrono::steady_clock::now() - requestTime).count();
+    ++m_stats.cancelCount;
+    m_stats.lastCancelLatency = latency;
+    m_stats.maxCancelLatency = std::max(m_stats.maxCancelLatency, latency);
+
+    m_regionConverged = false;
+    m_fullFrameDirty = true;
+    _ResetAccumulation();
+    _RecreateRenderBuffers();
+}
+
+void HdRprEngine::_RecreateRenderBuffers() {
+    if (!m_taskController) {
+        return;
+    }
+
+    // Until SetRendererAovs() is called the task controller has its default
+    // outputs, of which color is the one the engine reads
+    TfTokenVector aovs = m_rendererAovs;
+    if (aovs.empty() && m_taskController->GetRenderOutput(HdAovTokens->color)) {
+        aovs.push_back(HdAovTokens->color);
+    }
+    if (aovs.empty()) {
+        return;
+    }
+
+    // The task controller ignores a repeated set of outputs, dropping them
+    // first makes it create new render buffers and rebind the render task
+    m_taskController->SetRenderOutputs(TfTokenVector());
+    m_taskController->SetRenderOutputs(aovs);
+}
+
+void HdRprEngine::_ResetAccumulation() {
+    if (m_convergenceEstimator) {
+        m_convergenceEstimator->Reset();
+    }
+    m_aovImagesValid = false;
+    m_accumulationStart = std::chrono::steady_clock::now();
+    m_accumulationFrameCount = 0;
+}
+
+void HdRprEngine::_SetStage(UsdStageWeakPtr const& stage) {
+    if (stage == m_stage) {
+        return;
+    }
+
+    // Proxies and instances are authored on the old stage
+    m_drawModeController->Restore();
+    m_meshDeduplicator->Restore();
+    m_meshDeduplicationDirty = m_meshDeduplication;
+    m_drawModeController->Invalidate();
+    m_refineLevelController->Invalidate();
+    m_frustumCuller->Invalidate();
+
+    // Only the scene delegate contents go, the render delegate and its
+    // buffers are kept for the next stage
+    if (m_isPopulated) {
+        _RecreateSceneDelegate();
+    }
+
+    TfNotice::Revoke(m_objectsChangedKey);
+    m_stage = stage;
+    ++m_stageRevision;
+    m_populationMaskDirty = true;
+    if (m_stage) {
+        m_objectsChangedKey = TfNotice::Register(
+            TfCreateWeakPtr(this), &HdRprEngine::_OnObjectsChanged, m_stage);
+    }
+    m_fullFrameDirty = true;
+}
+
+void HdRprEngine::_WidenPopulationMask() {
+    m_populationMaskDirty = false;
+
+    UsdStageRefPtr stage = m_stage;
+    if (!stage) {
+        return;
+    }
+
+    // Stages opened without a mask include everything already
+    SdfPathVector includedPaths;
+    _GetRenderRootScenePaths(&includedPaths);
+    HdRprWidenPopulationMask(stage, includedPaths, m_excludedPathTrie.GetCover());
+}
+
+void HdRprEngine::_OnObjectsChanged(
+    UsdNotice::ObjectsChanged const& notice,
+    UsdStageWeakPtr const& sender) {
+    ++m_stageRevision;
+
+    // Proxies authored by the draw mode controller resync only properties,
+    // don't let them trigger a gather of all meshes and models
+    for (SdfPath const& path : notice.GetResyncedPaths()) {
+        if (path.IsPrimPath() || path.IsAbsoluteRootPath()) {
+            m_refineLevelController->Invalidate();
+            m_drawModeController->Invalidate();
+            m_frustumCuller->Invalidate();
+            break;
+        }
+    }
+
+    // Bounds may have changed with any property but shading ones
+    for (SdfPath const& path : notice.GetChangedInfoOnlyPaths()) {
+        if (!IsShadingOnlyProperty(path)) {
+            m_frustumCuller->InvalidateBounds();
+            break;
+        }
+    }
+
+    // Changes the deduplicator authors itself are notified while it
+    // applies, the dirty flag is cleared once it is done
+    if (m_meshDeduplication) {
+        for (SdfPath const& path : notice.GetResyncedPaths()) {
+            if (m_meshDeduplicationDirty) {
+                break;
+            }
+            m_meshDeduplicationDirty = m_meshDeduplicator->IsAffectedBy(path);
+        }
+        for (SdfPath const& path : notice.GetChangedInfoOnlyPaths()) {
+            if (m_meshDeduplicationDirty) {
+                break;
+            }
+            m_meshDeduplicationDirty = m_meshDeduplicator->IsAffectedBy(path);
+        }
+    }
+
+    // A new top-level prim is not assigned to any shard
+    if (!m_shardDelegateMap.empty()) {
+        for (SdfPath const& path : notice.GetResyncedPaths()) {
+            if (path.IsAbsoluteRootPath() || path == m_rootPath ||
+                (path.IsPrimPath() && path.GetParentPath() == m_rootPath &&
+                 !m_shardDelegateMap.count(path) && !m_excludedPathTrie.IsCovered(path))) {
+                m_shardsDirty = true;
+                break;
+            }
+        }
+    }
+
+    if (!m_autoRenderRegion) {
+        return;
+    }
+
+    for (SdfPath const& path : notice.GetResyncedPaths()) {
+        m_dirtyPrims[path.GetPrimPath()] = true;
+    }
+    for (SdfPath const& path : notice.GetChangedInfoOnlyPaths()) {
+        bool& moved = m_dirtyPrims[path.GetPrimPath()];
+        moved = moved || !IsShadingOnlyProperty(path);
+    }
+}
+
+void HdRprEngine::_ApplyPostedCameraState() {
+    HdRprCameraState state;
+    HdRprCameraMailbox::Clock::time_point postTime;
+    if (!m_cameraMailbox->Take(&state, &postTime)) {
+        return;
+    }
+
+    SetRenderViewport(state.viewport);
+    if (state.cameraPath.IsEmpty()) {
+        SetCameraState(state.viewMatrix, state.projectionMatrix);
+    } else {
+        SetCameraPath(state.cameraPath);
+    }
+
+    ++m_stats.cameraStatesApplied;
+    m_stats.cameraStatesDropped = m_cameraMailbox->GetDroppedCount();
+    m_stats.lastCameraLatency = std::chrono::duration<double>(HdRprCameraMailbox::Clock::now() - postTime).count();
+}
+
+bool HdRprEngine::_ComputeCameraMatrices(
+    GfMatrix4d* viewMatrix,
+    GfMatrix4d* projectionMatrix) const {
+    if (m_cameraPath.IsEmpty()) {
+        *viewMatrix = m_viewMatrix;
+        *projectionMatrix = m_projectionMatrix;
+        return true;
+    }
+
+    UsdStageRefPtr stage = m_stage;
+    if (!stage) {
+        return false;
+    }
+
+    UsdGeomCamera camera(stage->GetPrimAtPath(m_cameraPath));
+    if (!camera) {
+        return false;
+    }
+
+    GfFrustum frustum = camera.GetCamera(m_frame).GetFrustum();
+    double aspectRatio = m_viewport[3] > 0.0 ? m_viewport[2] / m_viewport[3] : 1.0;
+    CameraUtilConformWindow(&frustum, m_windowPolicy, aspectRatio);
+
+    *viewMatrix = frustum.ComputeViewMatrix();
+    *projectionMatrix = frustum.ComputeProjectionMatrix();
+    return true;
+}
+
+bool HdRprEngine::_UsesAovImages() const {
+    return !HdRprIsRectEmpty(m_renderRegion) || m_autoRenderRegion ||
+           m_resolutionController->IsEnabled() || m_reprojection || m_frameCache;
+}
+
+GfVec4i HdRprEngine::_ComputeRenderRegion() {
+    GfVec2i viewportSize(int(m_viewport[2]), int(m_viewport[3]));
+    GfVec4i fullFrame(0, 0, viewportSize[0], viewportSize[1]);
+
+    // Regions are rendered at full resolution only
+    GfMatrix4d viewMatrix, projectionMatrix;
+    if (!_UsesAovImages() || !m_aovImagesValid || GetRenderScale() < 1.0f ||
+        !_ComputeCameraMatrices(&viewMatrix, &projectionMatrix)) {
+        m_dirtyPrims.clear();
+        m_fullFrameDirty = false;
+        m_autoRegion = fullFrame;
+        return fullFrame;
+    }
+
+    if (!HdRprIsRectEmpty(m_renderRegion)) {
+        int x0 = std::max(m_renderRegion[0], 0);
+        int y0 = std::max(m_renderRegion[1], 0);
+        int x1 = std::min(m_renderRegion[0] + m_renderRegion[2], viewportSize[0]);
+        int y1 = std::min(m_renderRegion[1] + m_renderRegion[3], viewportSize[1]);
+        if (x0 >= x1 || y0 >= y1) {
+            return fullFrame;
+        }
+        return GfVec4i(x0, y0, x1 - x0, y1 - y0);
+    }
+
+    if (m_dirtyPrims.empty() && !m_fullFrameDirty) {
+        // Nothing changed, keep refining the current region
+        return m_autoRegion;
+    }
+
+    GfVec4i dirtyRect(0);
+    bool isBounded = _ComputeDirtyRect(&dirtyRect);
+    m_dirtyPrims.clear();
+    m_fullFrameDirty = false;
+
+    if (!isBounded) {
+        m_autoRegion = fullFrame;
+    } else if (!HdRprIsRectEmpty(dirtyRect)) {
+        // Once the previous region converged only the new changes need to
+        // be refined, otherwise keep refining the previous region too
+        m_autoRegion = m_regionConverged ? dirtyRect : HdRprUnionRect(m_autoRegion, dirtyRect);
+    }
+    return m_autoRegion;
+}
+
+bool HdRprEngine::_ComputeDirtyRect(GfVec4i* rect) {
+    UsdStageRefPtr stage = m_stage;
+    GfMatrix4d viewMatrix, projectionMatrix;
+    if (m_fullFrameDirty || !stage ||
+        !_ComputeCameraMatrices(&viewMatrix, &projectionMatrix)) {
+        return false;
+    }
+
+    GfMatrix4d viewProjection = viewMatrix * projectionMatrix;
+    GfVec2i viewportSize(int(m_viewport[2]), int(m_viewport[3]));
+    UsdGeomBBoxCache bboxCache(m_frame, {UsdGeomTokens->default_, UsdGeomTokens->render},
+                               /* useExtentsHint = */ true);
+
+    GfVec4i dirtyRect(0);
+    for (auto const& entry : m_dirtyPrims) {
+        SdfPath const& path = entry.first;
+        bool moved = entry.second;
+
+        GfVec4i newRect(0);
+        if (UsdPrim prim = stage->GetPrimAtPath(path)) {
+            // Lights, cameras, materials, etc. may affect the whole image
+            if (!prim.IsA<UsdGeomImageable>() ||
+                prim.IsA<UsdLuxLight>() ||
+                prim.IsA<UsdGeomCamera>()) {
+                return false;
+            }
+
+            if (!HdRprComputeScreenRect(bboxCache.ComputeWorldBound(prim),
+                                        viewProjection, viewportSize, &newRect)) {
+                return false;
+            }
+        }
+
+        if (moved) {
+            // The area the prim covered before the change is dirty too
+            auto it = m_primScreenRects.find(path);
+            if (it == m_primScreenRects.end()) {
+                return false;
+            }
+            dirtyRect = HdRprUnionRect(dirtyRect, it->second);
+
+            // Descendants moved with it, forget their previous location
+            for (auto descendant = m_primScreenRects.begin(); descendant != m_primScreenRects.end();) {
+                if (descendant->first != path && descendant->first.HasPrefix(path)) {
+                    descendant = m_primScreenRects.erase(descendant);
+                } else {
+                    ++descendant;
+                }
+            }
+        }
+
+        dirtyRect = HdRprUnionRect(dirtyRect, newRect);
+        m_primScreenRects[path] = newRect;
+    }
+
+    *rect = dirtyRect;
+    return true;
+}
+
+void HdRprEngine::_ApplyRenderRegion(GfVec4i const& region) {
+    GfVec2i viewportSize(int(m_viewport[2]), int(m_viewport[3]));
+    bool isFullFrame = region == GfVec4i(0, 0, viewportSize[0], viewportSize[1]);
+
+    GfVec2i renderSize(region[2], region[3]);
+    if (isFullFrame) {
+        float scale = GetRenderScale();
+        renderSize[0] = std::max(int(std::round(viewportSize[0] * scale)), 1);
+        renderSize[1] = std::max(int(std::round(viewportSize[1] * scale)), 1);
+    }
+
+    if (region == m_appliedRegion && renderSize == m_appliedRenderSize) {
+        return;
+    }
+
+    m_taskController->SetRenderViewport(GfVec4d(m_viewport[0], m_viewport[1], renderSize[0], renderSize[1]));
+    if (isFullFrame) {
+        if (m_cameraPath.IsEmpty()) {
+            m_taskController->SetFreeCameraMatrices(m_viewMatrix, m_projectionMatrix);
+        } else {
+            m_taskController->SetCameraPath(m_cameraPath);
+        }
+    } else {
+        GfMatrix4d viewMatrix, projectionMatrix;
+        _ComputeCameraMatrices(&viewMatrix, &projectionMatrix);
+
+        // Render the region only, through an off-center projection
+        m_taskController->SetFreeCameraMatrices(viewMatrix,
+            HdRprComputeRegionProjection(projectionMatrix, viewportSize, region));
+    }
+
+    m_appliedRegion = region;
+    m_appliedRenderSize = renderSize;
+    m_regionConverged = false;
+    m_convergenceEstimator->Reset();
+}
+
+void HdRprEngine::_UpdateMeshDeduplication(UsdPrim const& root) {
+    if (m_meshDeduplication) {
+        static TfToken const scopeName("__HdRprDeduplicatedMeshes", TfToken::Immortal);
+        m_meshDeduplicator->Apply(root, m_excludedPathTrie, m_invisedPathTrie, m_rootPath.AppendChild(scopeName));
+        m_measureDeduplication = m_meshDeduplicator->IsApplied();
+    } else {
+        m_meshDeduplicator->Restore();
+        m_measureDeduplication = false;
+        m_stats.dedupSyncTimeSaved = 0.0;
+    }
+
+    m_meshDeduplicationDirty = false;
+    m_stats.dedupMeshCount = m_meshDeduplicator->GetMeshCount();
+    m_stats.dedupPrototypeCount = m_meshDeduplicator->GetPrototypeCount();
+    m_stats.dedupBytesSaved = m_meshDeduplicator->GetBytesSaved();
+    m_fullFrameDirty = true;
+}
+
+void HdRprEngine::_UpdateExcludedPaths() {
+    m_excludedPrimPaths = m_excludedPathTrie.GetCover();
+    m_excludedPathsDirty = false;
+
+    // Prims left out of population can't be brought back by the collection
+    if (m_isPopulated) {
+        bool isIncluded = std::any_of(m_populateExcludedPrimPaths.begin(), m_populateExcludedPrimPaths.end(),
+            [this](SdfPath const& path) { return !m_excludedPathTrie.IsCovered(path); });
+        if (isIncluded) {
+            _RecreateSceneDelegate();
+        }
+    }
+
+    m_collectionExcludePaths.clear();
+    m_collectionExcludePaths.reserve(m_excludedPrimPaths.size());
+    _ForEachDelegate([this](UsdImagingDelegate* delegate) {
+        for (SdfPath const& path : m_excludedPrimPaths) {
+            m_collectionExcludePaths.push_back(delegate->ConvertCachePathToIndexPath(path));
+        }
+    });
+
+    // Gathered meshes and models may have been excluded or included
+    m_refineLevelController->Invalidate();
+    m_drawModeController->Invalidate();
+    m_frustumCuller->Invalidate();
+    m_fullFrameDirty = true;
+}
+
+void HdRprEngine::_UpdateFrustumCulling() {
+    UsdStageRefPtr stage = m_stage;
+    GfMatrix4d viewMatrix, projectionMatrix;
+    if (!m_frustumCulling || !stage || !m_isPopulated ||
+        !_ComputeCameraMatrices(&viewMatrix, &projectionMatrix)) {
+        if (!m_culledCollectionPaths.empty()) {
+            m_culledCollectionPaths.clear();
+            m_fullFrameDirty = true;
+        }
+        m_frustumCuller->Clear();
+        m_stats.frustumCulledPrimCount = 0;
+        return;
+    }
+
+    if (m_frustumCuller->Update(stage->GetPrimAtPath(m_rootPath), m_excludedPathTrie, m_frame,
+                                viewMatrix * projectionMatrix, m_frustumCullingMargin)) {
+        m_culledCollectionPaths.clear();
+        for (SdfPath const& path : m_frustumCuller->GetCulledPaths()) {
+            if (UsdImagingDelegate* delegate = _GetDelegate(path)) {
+                m_culledCollectionPaths.push_back(delegate->ConvertCachePathToIndexPath(path));
+            }
+        }
+        m_fullFrameDirty = true;
+    }
+    m_stats.frustumCulledPrimCount = m_frustumCuller->GetCulledPaths().size();
+}
+
+void HdRprEngine::_RecreateSceneDelegate() {
+    GfMatrix4d rootTransform = m_delegate->GetRootTransform();
+    bool isVisible = m_delegate->GetRootVisibility();
+
+    // The delegates remove their prims from the render index
+    _DeleteShardDelegates();
+    delete m_delegate;
+    m_delegate = new UsdImagingDelegate(m_renderIndex, m_delegateID);
+    m_delegate->SetRootVisibility(isVisible);
+    m_delegate->SetRootTransform(rootTransform);
+    m_isPopulated = false;
+
+    m_refineLevelController->Clear(nullptr);
+    // Culled prims get index paths of the new delegates
+    m_frustumCuller->Clear();
+    _ResetAccumulation();
+}
+
+void HdRprEngine::_Populate(UsdPrim const& root, bool enableUsdDrawModes) {
+    HD_TRACE_FUNCTION();
+
+    auto populateStart = std::chrono::steady_clock::now();
+
+    _DeleteShardDelegates();
+    std::vector<SdfPathVector> shards = _ComputeShards(root);
+
+    if (shards.empty()) {
+        m_delegate->SetUsdDrawModesEnabled(enableUsdDrawModes);
+        m_delegate->Populate(root, m_excludedPrimPaths);
+    } else {
+        for (size_t i = 1; i < shards.size(); ++i) {
+            TfToken shardName(TfStringPrintf("_HdRprShard%zu", i));
+            m_shardDelegates.emplace_back(new UsdImagingDelegate(m_renderIndex, m_delegateID.AppendChild(shardName)));
+            m_shardDelegates.back()->SetRootVisibility(m_delegate->GetRootVisibility());
+            m_shardDelegates.back()->SetRootTransform(m_delegate->GetRootTransform());
+        }
+
+        for (size_t i = 0; i < shards.size(); ++i) {
+            UsdImagingDelegate* delegate = i == 0 ? m_delegate : m_shardDelegates[i - 1].get();
+            for (SdfPath const& path : shards[i]) {
+                m_shardDelegateMap[path] = delegate;
+            }
+        }
+
+        // Every delegate traverses from the root, leaving out the subtrees of
+        // the other shards. Populate inserts into the render index, which is
+        // not safe to do concurrently, so the shards populate one after the
+        // other; each of them runs its own time-varying analysis in parallel.
+        for (size_t i = 0; i < shards.size(); ++i) {
+            SdfPathVector excludedPaths = m_excludedPrimPaths;
+            for (size_t j = 0; j < shards.size(); ++j) {
+                if (j != i) {
+                    excludedPaths.insert(excludedPaths.end(), shards[j].begin(), shards[j].end());
+                }
+            }
+
+            UsdImagingDelegate* delegate = i == 0 ? m_delegate : m_shardDelegates[i - 1].get();
+            delegate->SetUsdDrawModesEnabled(enableUsdDrawModes);
+            delegate->Populate(root, excludedPaths);
+        }
+
+        // Forward the state set before the shards existed
+        for (auto& delegate : m_shardDelegates) {
+            delegate->SetWindowPolicy(m_windowPolicy);
+            delegate->SetCameraForSampling(m_cameraPath);
+        }
+    }
+
+    m_stats.populationShardCount = std::max(shards.size(), size_t(1));
+    m_stats.populateTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - populateStart).count();
+}
+
+std::vector<SdfPathVector> HdRprEngine::_ComputeShards(UsdPrim const& root) const {
+    // Only split at prims that aren't imaged themselves, every delegate
+    // traverses the root
+    if (m_populationShardCount < 2 || !root || root.IsInstance() ||
+        !(root.IsPseudoRoot() || root.IsA<UsdGeomXform>() || root.IsA<UsdGeomScope>() || root.GetTypeName().IsEmpty())) {
+        return {};
+    }
+
+    std::vector<UsdPrim> children;
+    for (UsdPrim const& child : root.GetChildren()) {
+        if (!m_excludedPathTrie.IsCovered(child.GetPath())) {
+            children.push_back(child);
+        }
+    }
+    if (children.size() < 2) {
+        return {};
+    }
+
+    std::vector<size_t> primCounts(children.size(), 0);
+    WorkParallelForN(children.size(), [&children, &primCounts](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            UsdPrimRange range(children[i]);
+            primCounts[i] = size_t(std::distance(range.begin(), range.end()));
+        }
+    });
+
+    // Largest subtrees first, each to the shard with the fewest prims so far
+    std::vector<size_t> order(children.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(),
+        [&primCounts](size_t lhs, size_t rhs) { return primCounts[lhs] > primCounts[rhs]; });
+
+    size_t shardCount = std::min(size_t(m_populationShardCount), children.size());
+    std::vector<SdfPathVector> shards(shardCount);
+    std::vector<size_t> shardPrimCounts(shardCount, 0);
+    for (size_t i : order) {
+        size_t shard = std::min_element(shardPrimCounts.begin(), shardPrimCounts.end()) - shardPrimCounts.begin();
+        shards[shard].push_back(children[i].GetPath());
+        shardPrimCounts[shard] += primCounts[i];
+    }
+    return shards;
+}
+
+void HdRprEngine::_DeleteShardDelegates() {
+    m_shardDelegates.clear();
+    m_shardDelegateMap.clear();
+}
+
+UsdImagingDelegate* HdRprEngine::_GetDelegate(SdfPath const& usdPath) const {
+    if (m_shardDelegateMap.empty() || usdPath == m_rootPath || !usdPath.HasPrefix(m_rootPath)) {
+        return m_delegate;
+    }
+
+    size_t topLevelDepth = m_rootPath.GetPathElementCount() + 1;
+    SdfPath topLevelPath = usdPath;
+    while (topLevelPath.GetPathElementCount() > topLevelDepth) {
+        topLevelPath = topLevelPath.GetParentPath();
+    }
+
+    auto it = m_shardDelegateMap.find(topLevelPath);
+    return it != m_shardDelegateMap.end() ? it->second : m_delegate;
+}
+
+void HdRprEngine::_CreateImagingCacheDelegate() {
+    static TfToken const delegateName("_HdRprImagingCache", TfToken::Immortal);
+
+    m_imagingCacheDelegate.reset(new HdRprImagingCacheDelegate(
+        m_renderIndex, m_delegateID.AppendChild(delegateName), m_imagingCache.get()));
+    m_imagingCacheDelegate->Populate();
+    AddRenderRoots({m_imagingCacheDelegate->GetDelegateID()});
+
+    _ResetAccumulation();
+    m_fullFrameDirty = true;
+}
+
+void HdRprEngine::_UpdateFrameStats(double frameTime) {
+    // Smoothing factor of the average frame time
+    const double kAverageWeight = 0.1;
+
+    m_stats.lastFrameTime = frameTime;
+    m_stats.averageFrameTime = m_stats.frameCount == 0 ? frameTime :
+        m_stats.averageFrameTime + (frameTime - m_stats.averageFrameTime) * kAverageWeight;
+    ++m_stats.frameCount;
+    m_stats.renderScale = GetRenderScale();
+
+    // The first frame after deduplication syncs all of the remaining meshes
+    if (m_measureDeduplication) {
+        size_t bytesKept = m_meshDeduplicator->GetBytesKept();
+        m_stats.dedupSyncTimeSaved = bytesKept > 0 ?
+            frameTime * double(m_stats.dedupBytesSaved) / double(bytesKept) : 0.0;
+        m_measureDeduplication = false;
+    }
+
+    if (m_resolutionController->IsEnabled()) {
+        m_resolutionController->Update(frameTime, m_cameraMoved);
+    }
+    m_cameraMoved = false;
+}
+
+void HdRprEngine::_ReadAovImages(GfVec4i const& region) {
+    GfVec2i viewportSize(int(m_viewport[2]), int(m_viewport[3]));
+    bool isFullFrame = region == GfVec4i(0, 0, viewportSize[0], viewportSize[1]);
+    if (!isFullFrame && !m_aovImagesValid) {
+        return;
+    }
+
+    for (auto const& aov : m_rendererAovs) {
+        HdRenderBuffer* buffer = GetAovBuffer(aov);
+        if (!buffer) {
+            continue;
+        }
+
+        HdRprAovImage& image = m_aovImages[aov];
+        image.Resize(viewportSize[0], viewportSize[1], buffer->GetFormat());
+        if (isFullFrame) {
+            // Upscales frames rendered at a lower resolution
+            image.ReadResampled(buffer);
+        } else {
+            image.Read(buffer, GfVec2i(region[0], region[1]));
+        }
+    }
+
+    if (isFullFrame) {
+        m_aovImagesValid = true;
+    }
+}
+
+bool HdRprEngine::_UpdateAovDelta(TfToken const& aov, HdRprAovDeltaTracker* tracker) {
+    if (_UsesAovImages()) {
+        HdRprAovImage const* image = GetAovImage(aov);
+        if (!image || image->IsEmpty()) {
+            return false;
+        }
+        tracker->Update(image->GetData(), image->GetWidth(), image->GetHeight(), image->GetFormat(), m_aovDeltaThreshold);
+        return true;
+    }
+
+    HdRenderBuffer* buffer = GetAovBuffer(aov);
+    if (!buffer) {
+        return false;
+    }
+
+    auto data = static_cast<uint8_t const*>(buffer->Map());
+    if (data) {
+        tracker->Update(data, int(buffer->GetWidth()), int(buffer->GetHeight()), buffer->GetFormat(), m_aovDeltaThreshold);
+    }
+    buffer->Unmap();
+    return data != nullptr;
+}
+
+void HdRprEngine::_BeginReprojection() {
+    if (!m_reprojection) {
+        return;
+    }
+
+    // Scene or setting changes make the displayed frame wrong from any view
+    if (!m_dirtyPrims.empty() || m_fullFrameDirty) {
+        m_reprojector->Invalidate();
+        m_reprojectionWarpPending = false;
+        m_reprojectionFrameValid = false;
+    }
+
+    GfMatrix4d viewMatrix, projectionMatrix;
+    if (!_ComputeCameraMatrices(&viewMatrix, &projectionMatrix)) {
+        return;
+    }
+    GfMatrix4d viewProjection = viewMatrix * projectionMatrix;
+    if (viewProjection == m_reprojectionViewProjection) {
+        return;
+    }
+
+    if (m_reprojectionFrameValid) {
+        HdRprAovImage const* color = TfMapLookupPtr(m_aovImages, HdAovTokens->color);
+        HdRprAovImage const* depth = TfMapLookupPtr(m_aovImages, HdAovTokens->depth);
+        if (color && depth) {
+            m_reprojector->StoreHistory(*color, *depth, m_reprojectionViewProjection);
+        }
+    }
+    m_reprojectionViewProjection = viewProjection;
+    m_reprojectionWarpPending = m_reprojector->HasHistory();
+    m_reprojectionFrameValid = false;
+}
+
+void HdRprEngine::_ApplyReprojection() {
+    if (!m_reprojection || !m_aovImagesValid) {
+        return;
+    }
+
+    HdRprAovImage* color = TfMapLookupPtr(m_aovImages, HdAovTokens->color);
+    HdRprAovImage* depth = TfMapLookupPtr(m_aovImages, HdAovTokens->depth);
+    if (!color || !depth) {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (m_reprojectionWarpPending) {
+        m_stats.reprojectedFraction = m_reprojector->Warp(m_reprojectionViewProjection, *depth);
+        m_reprojectionWarpPending = false;
+        m_reprojectionFrame = 0;
+    }
+
+    // The history stands in for the samples the new view doesn't have yet
+    float weight = 1.0f - float(m_reprojectionFrame + 1) / float(m_reprojectionHistoryFrames + 1);
+    if (weight > 0.0f) {
+        m_reprojector->Blend(color, weight);
+        ++m_reprojectionFrame;
+    }
+    m_reprojectionFrameValid = true;
+
+    m_stats.reprojectionTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool HdRprEngine::_GetRenderRootScenePaths(SdfPathVector* paths) {
+    bool allConverted = true;
+    for (SdfPath const& root : m_renderRoots) {
+        UsdImagingDelegate* owner = nullptr;
+        _ForEachDelegate([&root, &owner](UsdImagingDelegate* delegate) {
+            SdfPath const& id = delegate->GetDelegateID();
+            if (root.HasPrefix(id) && (!owner || id.HasPrefix(owner->GetDelegateID()))) {
+                owner = delegate;
+            }
+        });
+        if (owner) {
+            paths->push_back(owner->ConvertIndexPathToCachePath(root));
+        } else {
+            allConverted = false;
+        }
+    }
+    if (m_renderRoots.empty()) {
+        paths->push_back(m_rootPath);
+    }
+    return allConverted;
+}
+
+bool HdRprEngine::_ComputeFrameCacheKey(HdRprEngineRenderParams const& params, HdRprFrameDigest* key) {
+    UsdStageRefPtr stage = m_stage;
+    GfMatrix4d viewMatrix;
+    GfMatrix4d projectionMatrix;
+    if (!stage || !_ComputeCameraMatrices(&viewMatrix, &projectionMatrix)) {
+        return false;
+    }
+
+    // Imaging cache content is not on the stage
+    SdfPathVector rootPaths;
+    if (!_GetRenderRootScenePaths(&rootPaths)) {
+        return false;
+    }
+
+    // Hashing the stage reads every attribute, only redo it on changes
+    size_t stageHashInputs = m_stageRevision;
+    boost::hash_combine(stageHashInputs, params.frame);
+    for (SdfPath const& path : rootPaths) {
+        boost::hash_combine(stageHashInputs, path.GetHash());
+    }
+    if (stageHashInputs != m_stageHashInputs) {
+        m_stageHash = HdRprHashStageState(stage, rootPaths, params.frame);
+        m_stageHashInputs = stageHashInputs;
+    }
+
+    // Keys are shared between processes, only stable representations of
+    // the inputs go into them
+    HdRprFrameHasher hasher;
+    hasher.Append(m_stageHash);
+    for (SdfPath const& path : m_excludedPathTrie.GetCover()) {
+        hasher.AppendPath(path);
+    }
+    hasher.AppendPod(uint64_t(0));
+    for (SdfPath const& path : m_invisedPathTrie.GetCover()) {
+        hasher.AppendPath(path);
+    }
+    hasher.AppendPod(uint64_t(0));
+
+    hasher.Append(viewMatrix.GetArray(), 16 * sizeof(double));
+    hasher.Append(projectionMatrix.GetArray(), 16 * sizeof(double));
+    hasher.AppendPod(int(m_viewport[2]));
+    hasher.AppendPod(int(m_viewport[3]));
+    hasher.Append(m_renderRegion.data(), 4 * sizeof(int));
+    // Culling drops off-screen casters and reflectors
+    hasher.AppendPod(m_frustumCulling);
+    hasher.AppendPod(m_frustumCulling ? m_frustumCullingMargin : 0.0);
+
+    hasher.Append(m_rendererId);
+    HdRenderDelegate* renderDelegate = m_renderIndex->GetRenderDelegate();
+    for (HdRenderSettingDescriptor const& setting : renderDelegate->GetRenderSettingDescriptors()) {
+        hasher.Append(setting.key);
+        hasher.AppendValue(renderDelegate->GetRenderSetting(setting.key));
+    }
+    for (TfToken const& aov : m_rendererAovs) {
+        hasher.Append(aov);
+    }
+
+    hasher.AppendPod(params.frame.IsDefault());
+    hasher.AppendPod(params.frame.GetValue());
+    hasher.AppendPod(params.refineLevel);
+    hasher.AppendPod(uint64_t(params.clipPlanes.size()));
+    for (GfVec4d const& plane : params.clipPlanes) {
+        hasher.Append(plane.data(), 4 * sizeof(double));
+    }
+    hasher.AppendPod(params.enableSceneMaterials);
+    hasher.AppendPod(params.enableUsdDrawModes);
+    hasher.Append(params.clearColor.data(), 4 * sizeof(float));
+    hasher.AppendPod(params.convergenceThreshold);
+    hasher.AppendPod(params.adaptiveRefineLevel);
+    hasher.AppendPod(params.drawModeLodThreshold);
+    hasher.Append(params.drawModeLodMode);
+
+    *key = hasher.GetDigest();
+    return true;
+}
+
+bool HdRprEngine::_LookUpFrameCache(HdRprEngineRenderParams const& params) {
+    HdRprFrameDigest key;
+    if (!_ComputeFrameCacheKey(params, &key)) {
+        m_frameCacheKey = HdRprFrameDigest();
+        m_frameCacheHit = false;
+        // Nothing to store the frame under
+        m_frameCacheStored = true;
+        return false;
+    }
+
+    // Progressive rendering asks for the same frame until it converges
+    if (key == m_frameCacheKey) {
+        return m_frameCacheHit;
+    }
+
+    m_frameCacheKey = key;
+    m_frameCacheStored = false;
+    m_frameCacheHit = m_frameCache->Load(key, m_rendererAovs, &m_aovImages);
+    if (m_frameCacheHit) {
+        m_aovImagesValid = true;
+        // The render buffers still hold the last rendered frame, the next one
+        // has to replace the images entirely
+        m_fullFrameDirty = true;
+    }
+
+    size_t lookups = m_frameCache->GetHitCount() + m_frameCache->GetMissCount();
+    m_stats.frameCacheHits = m_frameCache->GetHitCount();
+    m_stats.frameCacheMisses = m_frameCache->GetMissCount();
+    m_stats.frameCacheHitRate = lookups ? float(m_stats.frameCacheHits) / float(lookups) : 0.0f;
+    m_stats.frameCacheBytes = m_frameCache->GetSize();
+    return m_frameCacheHit;
+}
+
+void HdRprEngine::_StoreFrameCache() {
+    // Frames rendered at a lower resolution are not final
+    if (m_frameCacheStored || m_frameCacheHit || !m_regionConverged ||
+        !m_aovImagesValid || GetRenderScale() < 1.0f) {
+        return;
+    }
+
+    // Failed writes are not retried every frame
+    m_frameCacheStored = true;
+    m_frameCache->Store(m_frameCacheKey, m_rendererAovs, m_aovImages);
+    m_stats.frameCacheBytes = m_frameCache->GetSize();
+}
+
+void HdRprEngine::_UpdateRenderProgress(bool converged) {
+    ++m_accumulationFrameCount;
+
+    HdRprRenderProgress progress;
+    progress.converged = converged;
+    progress.elapsedTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_accumulationStart).count();
+
+    HdRenderDelegate* renderDelegate = m_renderIndex->GetRenderDelegate();
+    int found = HdRprReadRenderStats(renderDelegate->GetRenderStats(), &progress);
+    if (!(found & HdRprRenderStatsSamples)) {
+        progress.samplesCompleted = m_accumulationFrameCount;
+    }
+    if (!(found & HdRprRenderStatsPeakMemory)) {
+        progress.peakMemory = HdRprGetPeakResidentMemory();
+    }
+    if (progress.elapsedTime > 0.0) {
+        progress.samplesPerSecond = progress.samplesCompleted / progress.elapsedTime;
+    }
+
+    if (converged) {
+        progress.percentDone = 100.0f;
+    } else if (!(found & HdRprRenderStatsPercentDone)) {
+        float error = m_convergenceEstimator->GetError();
+        VtValue maxSamples = renderDelegate->GetRenderSetting(_tokens->maxSamples);
+        if (m_convergenceThreshold > 0.0f && std::isfinite(error) && error > 0.0f) {
+            // Noise falls with the square root of the sample count
+            float ratio = m_convergenceThreshold / error;
+            progress.percentDone = std::min(ratio * ratio * 100.0f, 100.0f);
+        } else if (maxSamples.CanCast<double>()) {
+            double samples = maxSamples.Cast<double>().UncheckedGet<double>();
+            if (samples > 0.0) {
+                progress.percentDone = float(std::min(progress.samplesCompleted / samples * 100.0, 100.0));
+            }
+        }
+    }
+
+    if (progress.percentDone >= 100.0f) {
+        progress.estimatedTimeRemaining = 0.0;
+    } else if (progress.percentDone > 0.0f) {
+        progress.estimatedTimeRemaining = progress.elapsedTime * (100.0 - progress.percentDone) / progress.percentDone;
+    }
+
+    std::lock_guard<std::mutex> lock(m_renderProgressMutex);
+    m_renderProgress = progress;
+}
+
 /* static */
 TfToken HdRprEngine::_GetDefaultRendererPluginId() {
     std::string defaultRendererDisplayName = 
@@ -16,12 +16,46 @@
 #include "pxr/usdImaging/usdImaging/delegate.h"
 
 #include "pxr/rprImaging/rprEngine/renderParams.h"
-
+#include "pxr/rprImaging/rprEngine/aovImage.h"
+#include "pxr/rprImaging/rprEngine/aovDeltaTracker.h"
+#include "pxr/rprImaging/rprEngine/cameraMailbox.h"
+#include "pxr/rprImaging/rprEngine/engineOptions.h"
+#include "pxr/rprImaging/rprEngine/engineStats.h"
+#include "pxr/rprImaging/rprEngine/frameCache.h"
+#include "pxr/rprImaging/rprEngine/pathTrie.h"
+#include "pxr/rprImaging/rprEngine/renderProgress.h"
+
+#include "pxr/usd/usd/notice.h"
 #include "pxr/usd/sdf/path.h"
 
+#include "pxr/base/tf/hashmap.h"
+#include "pxr/base/tf/weakBase.h"
+
+#include "pxr/base/gf/vec2i.h"
+#include "pxr/base/gf/vec4i.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 PXR_NAMESPACE_OPEN_SCOPE
 
-class HdRprEngine {
+class HdRprConvergenceEstimator;
+class HdRprResolutionController;
+class HdRprRefineLevelController;
+class HdRprDrawModeController;
+class HdRprMeshDeduplicator;
+class HdRprImagingCache;
+class HdRprImagingCacheDelegate;
+class HdRprThreadArena;
+class HdRprReprojector;
+class HdRprFrustumCuller;
+
+class HdRprEngine : public TfWeakBase {
 public:
 
     // ---------------------------------------------------------------------
@@ -32,7 +66,8 @@ public:
     HdRprEngine(const SdfPath& rootPath= SdfPath::AbsoluteRootPath(),
                 const SdfPathVector& excludedPaths=SdfPathVector(),
                 const SdfPathVector& invisedPaths=SdfPathVector(),
-                const SdfPath& delegateID = SdfPath::AbsoluteRootPath());
+                const SdfPath& delegateID = SdfPath::AbsoluteRootPath(),
+                const HdRprEngineOptions& options = HdRprEngineOptions());
 
     // Disallow copies
     HdRprEngine(const HdRprEngine&) = delete;
@@ -43,6 +78,40 @@ public:
 
     /// @}
 
+    // ---------------------------------------------------------------------
+    /// \name Scene
+    /// @{
+    // ---------------------------------------------------------------------
+
+    /// Remove the prims of the current stage from the render index and let
+    /// go of the stage. The renderer plugin, render delegate, AOV buffers,
+    /// camera and renderer settings are kept, so another stage can be
+    /// rendered without creating them again. Excluded and invised paths are
+    /// kept as well.
+    HDRPR_API
+    void ResetScene();
+
+    /// Render \p stage from the next PrepareBatch() on, resetting the scene
+    /// if it is not the current stage. PrepareBatch() with a prim of another
+    /// stage does the same.
+    HDRPR_API
+    void SetStage(UsdStageRefPtr const& stage);
+
+    /// Open \p filePath composing only the prims the engine renders: those
+    /// under the render roots, or under the root path without any, and
+    /// \p additionalPaths, such as cameras outside of the root, minus the
+    /// excluded paths. Targets of their relationships, such as bound
+    /// materials, are composed as well. The stage is made the current one.
+    ///
+    /// Render roots added later and removed exclusions widen the population
+    /// of the stage with the next PrepareBatch().
+    HDRPR_API
+    UsdStageRefPtr OpenStage(std::string const& filePath,
+                             SdfPathVector const& additionalPaths = SdfPathVector(),
+                             UsdStage::InitialLoadSet load = UsdStage::LoadAll);
+
+    /// @}
+
     // ---------------------------------------------------------------------
     /// \name Rendering
     /// @{
@@ -56,16 +125,61 @@ public:
     void RenderBatch(const SdfPathVector& paths, 
                      const HdRprEngineRenderParams& params);
 
+    /// Prepare rendering the loaded imaging cache at \p params.frame, see
+    /// LoadImagingCache().
+    HDRPR_API
+    void PrepareBatch(const HdRprEngineRenderParams& params);
+
+    /// Render the root paths set up by SetRenderRoots(), AddRenderRoots()
+    /// and RemoveRenderRoots(). Only root changes since the last batch
+    /// update the render collection.
+    HDRPR_API
+    void RenderBatch(const HdRprEngineRenderParams& params);
+
+    /// Replace the root paths of batch rendering. \p paths are render index
+    /// paths, see UsdImagingDelegate::ConvertCachePathToIndexPath().
+    HDRPR_API
+    void SetRenderRoots(SdfPathVector const& paths);
+
+    HDRPR_API
+    void AddRenderRoots(SdfPathVector const& paths);
+
+    HDRPR_API
+    void RemoveRenderRoots(SdfPathVector const& paths);
+
+    /// Returns the sorted root paths of batch rendering.
+    SdfPathVector const& GetRenderRoots() const { return m_renderRoots; }
+
     /// Entry point for kicking off a render
     HDRPR_API
     void Render(const UsdPrim& root, 
                 const HdRprEngineRenderParams &params);
 
+    /// Interrupt a PrepareBatch(), RenderBatch() or Render() in progress on
+    /// another thread at its next safe point: between the steps of the
+    /// scene update and before and after task execution. The AOV images,
+    /// convergence state and render buffers accumulated so far are
+    /// discarded and the next call starts over. Without a call in progress this has no effect.
+    /// Safe to call from any thread.
+    HDRPR_API
+    void Cancel();
+
     /// Returns true if the resulting image is fully converged.
     /// (otherwise, caller may need to call Render() again to refine the result)
     HDRPR_API
     bool IsConverged() const;
 
+    /// Returns the per-tile relative luminance error of the color AOV as
+    /// estimated over the last iterations. \p tileCount receives the number
+    /// of tiles along x and y. Empty unless
+    /// HdRprEngineRenderParams::convergenceThreshold is enabled.
+    HDRPR_API
+    std::vector<float> GetConvergenceMap(GfVec2i* tileCount = nullptr) const;
+
+    /// Returns the global error metric the convergence map is reduced to.
+    HDRPR_API
+    float GetConvergenceError() const;
+
     /// @}
 
     // ---------------------------------------------------------------------
@@ -98,6 +212,227 @@ public:
     void SetCameraState(const GfMatrix4d& viewMatrix,
                         const GfMatrix4d& projectionMatrix);
 
+    /// Post the complete framing for the next frame. Unlike the setters
+    /// above, this may be called from any thread while another one renders,
+    /// without blocking. Only the latest posted state is applied, at the
+    /// start of the next PrepareBatch() or RenderBatch().
+    HDRPR_API
+    void PostCameraState(HdRprCameraState const& state);
+
+    /// @}
+
+    // ---------------------------------------------------------------------
+    /// \name Region of Interest
+    /// @{
+    // ---------------------------------------------------------------------
+
+    /// Restrict rendering and readback to \p region given as (x,y,w,h) in
+    /// viewport pixels, with (x,y) being the lower left corner. The rest of
+    /// the image is kept from previous renders; the composited result is
+    /// available through GetAovImage().
+    HDRPR_API
+    void SetRenderRegion(GfVec4i const& region);
+
+    /// Render the full viewport again.
+    HDRPR_API
+    void ClearRenderRegion();
+
+    /// When enabled and no explicit region is set, the region is computed
+    /// from the screen-space bounds of prims changed since the last frame.
+    /// Changes that may affect the whole image (time, camera, lights,
+    /// materials, or transforms of prims not seen before) fall back to
+    /// full-frame rendering. Indirect effects of a change outside of its
+    /// bounds, such as shadows and reflections, are not tracked.
+    HDRPR_API
+    void SetAutoRenderRegionEnabled(bool enabled);
+
+    /// Return the region rendered by the last frame.
+    HDRPR_API
+    GfVec4i const& GetLastRenderRegion() const { return m_appliedRegion; }
+
+    /// @}
+
+    // ---------------------------------------------------------------------
+    /// \name Dynamic Resolution
+    /// @{
+    // ---------------------------------------------------------------------
+
+    /// Aim for \p seconds per RenderBatch() call. While the camera moves the
+    /// internal render resolution is lowered to meet the target and raised
+    /// back step by step once the view settles. Frames are upscaled to the
+    /// viewport size into GetAovImage(). Zero disables adaptive resolution.
+    HDRPR_API
+    void SetTargetFrameTime(double seconds);
+
+    /// Set the lowest fraction of the viewport size to render at.
+    HDRPR_API
+    void SetMinRenderScale(float scale);
+
+    /// Return the fraction of the viewport size the next frame renders at.
+    HDRPR_API
+    float GetRenderScale() const;
+
+    /// @}
+
+    // ---------------------------------------------------------------------
+    /// \name Reprojection
+    /// @{
+    // ---------------------------------------------------------------------
+
+    /// When enabled, the frame shown before a camera change is warped into
+    /// the new view using the depth AOV and blended with the new samples,
+    /// fading out over \p historyFrames frames. Needs the color and depth
+    /// AOVs, the blended color is available through GetAovImage().
+    HDRPR_API
+    void SetReprojection(bool enabled, int historyFrames = 8);
+
+    /// @}
+
+    // ---------------------------------------------------------------------
+    /// \name Frame Cache
+    /// @{
+    // ---------------------------------------------------------------------
+
+    /// Store converged frames in \p directory, keyed by a hash of the
+    /// composed stage under the render roots at the frame time, the camera,
+    /// the viewport, the AOVs, the renderer and its settings, and the render
+    /// params. RenderBatch() serves a frame found in the cache through
+    /// GetAovImage() without rendering it. Entries beyond \p maxBytes are
+    /// evicted least recently used first. An empty \p directory disables
+    /// the cache; returns false if the directory can't be created.
+    HDRPR_API
+    bool SetFrameCache(std::string const& directory, size_t maxBytes = size_t(4) << 30);
+
+    /// @}
+
+    // ---------------------------------------------------------------------
+    /// \name Tiled Rendering
+    /// @{
+    // ---------------------------------------------------------------------
+
+    /// Render \p root into an image of \p imageSize with the current camera
+    /// in tiles of \p tileSize pixels, each rendered until converged, or for
+    /// \p maxIterations render calls, through an off-center projection and
+    /// streamed to the tiled EXR files of \p outputFiles, keyed by AOV. The
+    /// AOVs are only allocated at the tile size, so the image may be far
+    /// larger than the renderer could hold at once. Render regions, dynamic
+    /// resolution and reprojection are suspended meanwhile. With an imaging
+    /// cache loaded \p root is ignored. Returns false if cancelled or an
+    /// output could not be written.
+    HDRPR_API
+    bool RenderTiled(UsdPrim const& root,
+                     HdRprEngineRenderParams const& params,
+                     GfVec2i const& imageSize,
+                     int tileSize,
+                     std::map<TfToken, std::string> const& outputFiles,
+                     int maxIterations = 256);
+
+    /// @}
+
+    // ---------------------------------------------------------------------
+    /// \name Frustum Culling
+    /// @{
+    // ---------------------------------------------------------------------
+
+    /// Leave prims whose bounds are entirely outside of the camera frustum,
+    /// widened by \p margin in world units, out of the render collection,
+    /// so that the renderer doesn't sync them. Off-screen geometry beyond
+    /// the margin no longer shows in reflections or casts shadows on
+    /// screen, nor does emissive geometry light the scene; lights are not
+    /// affected. Native instances and prims with native instances below
+    /// them are not culled. Bounds are cached until the stage or the frame
+    /// changes.
+    HDRPR_API
+    void SetFrustumCulling(bool enabled, double margin = 0.0);
+
+    /// @}
+
+    // ---------------------------------------------------------------------
+    /// \name Mesh Deduplication
+    /// @{
+    // ---------------------------------------------------------------------
+
+    /// When enabled, static meshes that are identical apart from their
+    /// transform are turned into instances of a shared prototype before the
+    /// scene is populated, or right away if it already is. The instances
+    /// live in the stage session layer; disabling restores the stage.
+    /// Edits to a deduplicated mesh or its ancestors deduplicate again on
+    /// the next PrepareBatch().
+    HDRPR_API
+    void SetMeshDeduplicationEnabled(bool enabled);
+
+    /// @}
+
+    // ---------------------------------------------------------------------
+    /// \name Population
+    /// @{
+    // ---------------------------------------------------------------------
+
+    /// Split the scene into up to \p count shards at the children of the
+    /// root prim, balanced by prim count, each populated by its own scene
+    /// delegate under the engine's delegate ID. The top-level subtrees are
+    /// traversed concurrently on the Work pool to balance the shards. The
+    /// delegates then populate one after another, because they insert into
+    /// the shared render index. Takes effect the next time the scene is
+    /// populated; 1 populates through a single delegate.
+    HDRPR_API
+    void SetPopulationShardCount(int count);
+
+    /// @}
+
+    // ---------------------------------------------------------------------
+    /// \name Imaging Cache
+    /// @{
+    // ---------------------------------------------------------------------
+
+    /// Populate from an imaging cache baked with HdRprImagingCache::Bake()
+    /// instead of a USD stage. Its root is added to the render roots, so it
+    /// renders through PrepareBatch(params) and RenderBatch(params). Scene
+    /// cameras are not part of the cache, use SetCameraState().
+    HDRPR_API
+    bool LoadImagingCache(std::string const& filePath);
+
+    HDRPR_API
+    void UnloadImagingCache();
+
+    /// @}
+
+    // ---------------------------------------------------------------------
+    /// \name Visibility and Exclusion
+    /// @{
+    // ---------------------------------------------------------------------
+
+    /// Hide the prims at \p paths and their descendants. Only the prims
+    /// whose visibility actually changes get dirtied.
+    HDRPR_API
+    void AddInvisedPaths(SdfPathVector const& paths);
+
+    HDRPR_API
+    void RemoveInvisedPaths(SdfPathVector const& paths);
+
+    HDRPR_API
+    void ClearInvisedPaths();
+
+    /// Returns true if \p path or one of its ancestors is hidden.
+    HDRPR_API
+    bool IsInvised(SdfPath const& path) const;
+
+    /// Leave the prims at \p paths and their descendants out of rendering.
+    /// Paths excluded before the scene is populated are not loaded at all;
+    /// including any of them again repopulates the scene.
+    HDRPR_API
+    void AddExcludedPaths(SdfPathVector const& paths);
+
+    HDRPR_API
+    void RemoveExcludedPaths(SdfPathVector const& paths);
+
+    HDRPR_API
+    void ClearExcludedPaths();
+
+    /// Returns true if \p path or one of its ancestors is excluded.
+    HDRPR_API
+    bool IsExcluded(SdfPath const& path) const;
+
     // /// @}
 
     // // ---------------------------------------------------------------------
@@ -241,6 +576,18 @@ public:
     HDRPR_API
     bool SetRendererPlugin(TfToken const &id);
 
+    /// Return true if the engine runs without Hgi, see HdRprEngineOptions.
+    HDRPR_API
+    bool IsHeadless() const { return m_headless; }
+
+    /// Forward a setting, e.g. the sample count, to the render delegate.
+    /// Settings don't survive a change of the renderer plugin.
+    HDRPR_API
+    void SetRendererSetting(TfToken const& id, VtValue const& value);
+
+    HDRPR_API
+    VtValue GetRendererSetting(TfToken const& id) const;
+
     /// @}
     
     // ---------------------------------------------------------------------
@@ -259,6 +606,30 @@ public:
     HDRPR_API
     HdRenderBuffer* GetAovBuffer(TfToken const& id);
 
+    /// Return the full-viewport image of \p id the engine composites frames
+    /// into, or null if no full frame has been rendered yet or none of
+    /// SetRenderRegion(), SetAutoRenderRegionEnabled(), SetTargetFrameTime(),
+    /// SetReprojection() and SetFrameCache() is in use. Frames served from
+    /// the frame cache are only available here, not in the render buffers.
+    HDRPR_API
+    HdRprAovImage const* GetAovImage(TfToken const& id) const;
+
+    /// Return in \p tiles the tiles of AOV \p id that changed after
+    /// \p sinceGeneration, and in \p generation the generation to pass on
+    /// the next call. Tracking of \p id starts with its first call, which
+    /// returns all tiles. Pixels come from GetAovImage() when it is
+    /// available, otherwise from the render buffer. Returns false
+    /// if \p id is not a current AOV.
+    HDRPR_API
+    bool ReadAovDelta(TfToken const& id, uint64_t sinceGeneration,
+                      std::vector<HdRprAovTile>* tiles, uint64_t* generation);
+
+    /// Set the largest change of a pixel component that ReadAovDelta()
+    /// doesn't report, so progressive refinement below it is not sent
+    /// again. Zero reports any change.
+    HDRPR_API
+    void SetAovDeltaThreshold(float threshold) { m_aovDeltaThreshold = threshold; }
+
     /// @}
 
     // // ---------------------------------------------------------------------
@@ -299,6 +670,37 @@ public:
 
     /// @}
 
+    // ---------------------------------------------------------------------
+    /// \name Threading
+    /// @{
+    // ---------------------------------------------------------------------
+
+    /// Run \p fn within the thread limit and CPU affinity of the engine,
+    /// see HdRprEngineOptions. Rendering calls do so already; use this for
+    /// CPU work on the results, like converting and writing images. Work
+    /// done by the renderer's own threads is not affected.
+    HDRPR_API
+    void Execute(std::function<void()> const& fn);
+
+    /// @}
+
+    // ---------------------------------------------------------------------
+    /// \name Statistics
+    /// @{
+    // ---------------------------------------------------------------------
+
+    HDRPR_API
+    HdRprEngineStats const& GetStats() const { return m_stats; }
+
+    /// Return the progress of the current view towards convergence,
+    /// combining the render delegate's render stats with the engine's own
+    /// counters. Updated by each RenderBatch(); safe and cheap to call from
+    /// any thread.
+    HDRPR_API
+    HdRprRenderProgress GetRenderProgress() const;
+
+    /// @}
+
 private:
     // These functions factor batch preparation into separate steps so they
     // can be reused by both the vectorized and non-vectorized API.
@@ -306,11 +708,30 @@ private:
     bool _CanPrepareBatch(const UsdPrim& root, 
         const HdRprEngineRenderParams& params);
 
+    // Bodies of PrepareBatch() and RenderBatch(), run in the thread arena
+    HDRPR_API
+    void _PrepareBatch(const UsdPrim& root,
+                       const HdRprEngineRenderParams& params);
+    HDRPR_API
+    void _PrepareBatch(const HdRprEngineRenderParams& params);
+    HDRPR_API
+    void _RenderBatch(const HdRprEngineRenderParams& params);
+
+    // Bracket the public rendering calls. Cancellation requested outside of
+    // them is dropped, a cancelled call discards its accumulation on exit.
+    HDRPR_API
+    void _BeginRenderCall();
+    HDRPR_API
+    void _EndRenderCall();
+
+    bool _IsCancelled() const { return m_cancelRequested.load(std::memory_order_relaxed); }
+
     // Create a hydra collection given root paths and render params.
     // Returns true if the collection was updated.
     HDRPR_API
     static bool _UpdateHydraCollection(HdRprimCollection *collection,
                           SdfPathVector const& roots,
+                          SdfPathVector const& excludePaths,
                           HdRprEngineRenderParams const& params);
     HDRPR_API
     static HdxRenderTaskParams _MakeHydraHdRprEngineRenderParams(
@@ -327,6 +748,134 @@ private:
     HDRPR_API
     static TfToken _GetDefaultRendererPluginId();
 
+    // Discards the engine-side state accumulated over progressive iterations.
+    HDRPR_API
+    void _ResetAccumulation();
+
+    // Replaces the render buffers with new ones, so that the render delegate
+    // discards its accumulation as well even if nothing else changed.
+    HDRPR_API
+    void _RecreateRenderBuffers();
+
+    HDRPR_API
+    void _SetStage(UsdStageWeakPtr const& stage);
+
+    // Adds prims under new render roots or removed exclusions to the
+    // population of a masked stage
+    HDRPR_API
+    void _WidenPopulationMask();
+
+    HDRPR_API
+    void _OnObjectsChanged(UsdNotice::ObjectsChanged const& notice,
+                           UsdStageWeakPtr const& sender);
+
+    // Applies the latest state posted with PostCameraState(), if any.
+    HDRPR_API
+    void _ApplyPostedCameraState();
+
+    // Returns the matrices of the active camera, either the free camera or
+    // the scene camera evaluated at the current frame.
+    HDRPR_API
+    bool _ComputeCameraMatrices(GfMatrix4d* viewMatrix,
+                                GfMatrix4d* projectionMatrix) const;
+
+    HDRPR_API
+    bool _UsesAovImages() const;
+
+    HDRPR_API
+    GfVec4i _ComputeRenderRegion();
+
+    // Returns false if the changes since the last frame can't be bounded
+    // on screen.
+    HDRPR_API
+    bool _ComputeDirtyRect(GfVec4i* rect);
+
+    HDRPR_API
+    void _ApplyRenderRegion(GfVec4i const& region);
+
+    HDRPR_API
+    void _ReadAovImages(GfVec4i const& region);
+
+    // Keeps the displayed frame as reprojection history when the camera
+    // changed, before the next frame overwrites it.
+    HDRPR_API
+    void _BeginReprojection();
+
+    // Blends the warped history into the color image just read.
+    HDRPR_API
+    void _ApplyReprojection();
+
+    // Looks the frame up in the frame cache, returns true if it was served
+    // from it
+    HDRPR_API
+    bool _LookUpFrameCache(HdRprEngineRenderParams const& params);
+
+    HDRPR_API
+    void _StoreFrameCache();
+
+    // Converts the render roots to scene paths, the root path if there are
+    // none. Returns false if some root is not populated from the stage.
+    HDRPR_API
+    bool _GetRenderRootScenePaths(SdfPathVector* paths);
+
+    // Returns false if the frame can't be keyed, e.g. without a camera
+    HDRPR_API
+    bool _ComputeFrameCacheKey(HdRprEngineRenderParams const& params, HdRprFrameDigest* key);
+
+    // Compares the current pixels of \p aov against its delta tracker.
+    HDRPR_API
+    bool _UpdateAovDelta(TfToken const& aov, HdRprAovDeltaTracker* tracker);
+
+    HDRPR_API
+    void _UpdateFrameStats(double frameTime);
+
+    HDRPR_API
+    void _UpdateRenderProgress(bool converged);
+
+    HDRPR_API
+    void _UpdateMeshDeduplication(UsdPrim const& root);
+
+    // Culls the prims under m_rootPath against the current camera and
+    // updates m_culledCollectionPaths.
+    HDRPR_API
+    void _UpdateFrustumCulling();
+
+    // Refreshes the cached covers of the path tries after they changed.
+    HDRPR_API
+    void _UpdateExcludedPaths();
+
+    // Replaces the scene delegate with an empty one to be populated again.
+    HDRPR_API
+    void _RecreateSceneDelegate();
+
+    // Populates the scene under m_rootPath through one delegate per shard.
+    HDRPR_API
+    void _Populate(UsdPrim const& root, bool enableUsdDrawModes);
+
+    // Partitions the children of \p root into shards of similar prim count.
+    // Returns no shards if the scene should not be split.
+    HDRPR_API
+    std::vector<SdfPathVector> _ComputeShards(UsdPrim const& root) const;
+
+    HDRPR_API
+    void _DeleteShardDelegates();
+
+    // Returns the delegate that populates the prim at \p usdPath
+    HDRPR_API
+    UsdImagingDelegate* _GetDelegate(SdfPath const& usdPath) const;
+
+    // Invokes \p fn with every scene delegate, the main one first
+    template <typename F>
+    void _ForEachDelegate(F&& fn) {
+        fn(m_delegate);
+        for (auto& delegate : m_shardDelegates) {
+            fn(delegate.get());
+        }
+    }
+
+    HDRPR_API
+    void _CreateImagingCacheDelegate();
+
 private:
     HdEngine m_engine;
     HdRenderIndex* m_renderIndex;
@@ -334,17 +883,134 @@ private:
     SdfPath const m_delegateID;
     UsdImagingDelegate* m_delegate;
 
+    // Delegates of all shards but the first, which m_delegate populates,
+    // and the delegate of every shard's top-level prims
+    std::vector<std::unique_ptr<UsdImagingDelegate>> m_shardDelegates;
+    TfHashMap<SdfPath, UsdImagingDelegate*, SdfPath::Hash> m_shardDelegateMap;
+    int m_populationShardCount;
+    bool m_shardsDirty;
+
     SdfPath m_rootPath;
+    // Minimal covers of the tries, see HdRprPathTrie::GetCover()
     SdfPathVector m_excludedPrimPaths;
     SdfPathVector m_invisedPrimPaths;
+    HdRprPathTrie m_excludedPathTrie;
+    HdRprPathTrie m_invisedPathTrie;
+    bool m_excludedPathsDirty;
+    bool m_populationMaskDirty;
+    bool m_invisedPathsDirty;
+
+    // Excluded paths the scene delegate was populated without, and the
+    // index paths of all of them for the render collection
+    SdfPathVector m_populateExcludedPrimPaths;
+    SdfPathVector m_collectionExcludePaths;
     bool m_isPopulated;
 
+    std::unique_ptr<HdRprFrustumCuller> m_frustumCuller;
+    bool m_frustumCulling;
+    double m_frustumCullingMargin;
+    // Index paths of the culled prims, excluded from the render collection
+    // along with m_collectionExcludePaths
+    SdfPathVector m_culledCollectionPaths;
+
     HdRendererPlugin* m_rendererPlugin;
     TfToken m_rendererId;
     TfTokenVector m_rendererAovs;
 
+    // No Hgi is created and only render tasks run, see HdRprEngineOptions
+    bool m_headless;
+
     HdxTaskController* m_taskController;
     HdRprimCollection m_renderCollection;
+
+    // Sorted and unique root paths of the render collection
+    SdfPathVector m_renderRoots;
+
+    GfVec4d m_viewport;
+    GfMatrix4d m_viewMatrix;
+    GfMatrix4d m_projectionMatrix;
+    SdfPath m_cameraPath;
+    CameraUtilConformWindowPolicy m_windowPolicy;
+
+    std::unique_ptr<HdRprCameraMailbox> m_cameraMailbox;
+
+    UsdStageWeakPtr m_stage;
+    TfNotice::Key m_objectsChangedKey;
+    UsdTimeCode m_frame;
+    HdRprEngineRenderParams m_lastRenderParams;
+
+    GfVec4i m_renderRegion;
+    bool m_autoRenderRegion;
+    GfVec4i m_autoRegion;
+    GfVec4i m_appliedRegion;
+    GfVec2i m_appliedRenderSize;
+    bool m_regionConverged;
+
+    // Prims changed since the last frame, mapped to whether the change may
+    // have moved them on screen.
+    TfHashMap<SdfPath, bool, SdfPath::Hash> m_dirtyPrims;
+    bool m_fullFrameDirty;
+    TfHashMap<SdfPath, GfVec4i, SdfPath::Hash> m_primScreenRects;
+
+    TfHashMap<TfToken, HdRprAovImage, TfToken::HashFunctor> m_aovImages;
+    bool m_aovImagesValid;
+
+    TfHashMap<TfToken, HdRprAovDeltaTracker, TfToken::HashFunctor> m_aovDeltaTrackers;
+    float m_aovDeltaThreshold;
+
+    std::unique_ptr<HdRprConvergenceEstimator> m_convergenceEstimator;
+    float m_convergenceThreshold;
+
+    std::unique_ptr<HdRprResolutionController> m_resolutionController;
+    bool m_cameraMoved;
+
+    std::unique_ptr<HdRprReprojector> m_reprojector;
+    bool m_reprojection;
+    int m_reprojectionHistoryFrames;
+    int m_reprojectionFrame;
+    bool m_reprojectionWarpPending;
+    // Whether the AOV images hold a frame displayed through
+    // m_reprojectionViewProjection
+    bool m_reprojectionFrameValid;
+    GfMatrix4d m_reprojectionViewProjection;
+
+    std::unique_ptr<HdRprFrameCache> m_frameCache;
+    // Key of the frame last looked up, whether it was served from the cache
+    // and whether it was stored after converging
+    HdRprFrameDigest m_frameCacheKey;
+    bool m_frameCacheHit;
+    bool m_frameCacheStored;
+    // Incremented on stage changes, the stage hash is recomputed when it,
+    // the frame or the render roots change
+    size_t m_stageRevision;
+    size_t m_stageHashInputs;
+    HdRprFrameDigest m_stageHash;
+
+    std::unique_ptr<HdRprRefineLevelController> m_refineLevelController;
+    std::unique_ptr<HdRprDrawModeController> m_drawModeController;
+
+    std::unique_ptr<HdRprMeshDeduplicator> m_meshDeduplicator;
+    bool m_meshDeduplication;
+    bool m_meshDeduplicationDirty;
+    bool m_measureDeduplication;
+
+    std::unique_ptr<HdRprImagingCache> m_imagingCache;
+    std::unique_ptr<HdRprImagingCacheDelegate> m_imagingCacheDelegate;
+
+    HdRprEngineStats m_stats;
+
+    // Written by the rendering thread at the end of each frame, read from any
+    // thread by GetRenderProgress()
+    mutable std::mutex m_renderProgressMutex;
+    HdRprRenderProgress m_renderProgress;
+    std::chrono::steady_clock::time_point m_accumulationStart;
+    size_t m_accumulationFrameCount;
+
+    std::unique_ptr<HdRprThreadArena> m_threadArena;
+
+    std::atomic<bool> m_cancelRequested;
+    std::atomic<std::chrono::steady_clock::rep> m_cancelRequestTime;
+    int m_renderCallDepth;
 };
 
 PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,35 @@
+#ifndef HDRPR_ENGINE_OPTIONS_H
+#define HDRPR_ENGINE_OPTIONS_H
+
+#include "pxr/pxr.h"
+
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class HdRprEngineOptions
+///
+/// Settings fixed for the lifetime of an HdRprEngine.
+///
+struct HdRprEngineOptions {
+    // Most threads the CPU work of the engine runs on at once, 0 allows as
+    // many as the Work concurrency limit, or as the pinned CPUs if fewer
+    int threadLimit = 0;
+
+    // CPUs the threads running CPU work of the engine are pinned to while
+    // they do, empty doesn't pin
+    std::vector<int> cpuAffinity;
+
+    // NUMA node whose CPUs are added to cpuAffinity, -1 for none
+    int numaNode = -1;
+
+    // Create no Hgi and run only the render tasks, so that no GL context is
+    // needed. The GL libraries hdx links are still loaded. Also enabled by
+    // the HDRPR_ENGINE_HEADLESS environment variable, and always in builds
+    // with the HDRPR_ENGINE_HEADLESS option.
+    bool headless = false;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_ENGINE_OPTIONS_H
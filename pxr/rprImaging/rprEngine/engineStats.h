@@ -0,0 +1,90 @@
+#ifndef HDRPR_ENGINE_STATS_H
+#define HDRPR_ENGINE_STATS_H
+
+#include "pxr/pxr.h"
+
+#include <cstddef>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class HdRprEngineStats
+///
+/// Counters HdRprEngine collects while rendering.
+///
+struct HdRprEngineStats {
+    // Duration of RenderBatch calls, in seconds
+    size_t frameCount = 0;
+    double lastFrameTime = 0.0;
+    double averageFrameTime = 0.0;
+
+    // Fraction of the viewport size the last frame was rendered at
+    float renderScale = 1.0f;
+
+    // Subdivision meshes with screen-space refine levels, and the estimated
+    // number of triangles not generated compared to the global refine level
+    size_t adaptiveRefineMeshCount = 0;
+    size_t adaptiveRefineTrianglesSaved = 0;
+
+    // Models currently drawn as their draw mode proxy
+    size_t drawModeProxyCount = 0;
+
+    // Topmost prims left out of the render collection by frustum culling
+    size_t frustumCulledPrimCount = 0;
+
+    // Meshes replaced by instances of shared prototypes, the size of the
+    // mesh data no longer duplicated, and the sync time that saved,
+    // estimated from the first frame after deduplication assuming sync time
+    // proportional to mesh data size
+    size_t dedupMeshCount = 0;
+    size_t dedupPrototypeCount = 0;
+    size_t dedupBytesSaved = 0;
+    double dedupSyncTimeSaved = 0.0;
+
+    // Scene delegates the scene was last populated through, and the time
+    // the population took in seconds
+    size_t populationShardCount = 0;
+    double populateTime = 0.0;
+
+    // Thread limit of the CPU work of the engine, and the most and average
+    // number of threads busy with it during the last frame
+    size_t threadLimit = 0;
+    size_t peakThreadCount = 0;
+    double averageParallelism = 0.0;
+
+    // Duration of the last renderer plugin switch in seconds, including
+    // loading the plugin and creating its render delegate, and the part of
+    // it spent creating the Hgi, zero when headless
+    double rendererStartupTime = 0.0;
+    double hgiStartupTime = 0.0;
+
+    // Frames served from the frame cache and looked up without being found,
+    // the fraction of lookups served, and the disk space the cache takes in
+    // bytes
+    size_t frameCacheHits = 0;
+    size_t frameCacheMisses = 0;
+    float frameCacheHitRate = 0.0f;
+    size_t frameCacheBytes = 0;
+
+    // Fraction of the pixels covered by the reprojected history after the
+    // last camera change, and the time the reprojection took in the last
+    // frame in seconds
+    float reprojectedFraction = 0.0f;
+    double reprojectionTime = 0.0;
+
+    // Camera states posted from other threads that were applied, replaced
+    // before a frame picked them up, and the time from posting to applying
+    // the last one in seconds
+    size_t cameraStatesApplied = 0;
+    size_t cameraStatesDropped = 0;
+    double lastCameraLatency = 0.0;
+
+    // Cancelled calls, and the time from Cancel() to the cancelled call
+    // returning, in seconds
+    size_t cancelCount = 0;
+    double lastCancelLatency = 0.0;
+    double maxCancelLatency = 0.0;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_ENGINE_STATS_H
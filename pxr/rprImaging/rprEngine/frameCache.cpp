@@ -0,0 +1,683 @@
+#include "pxr/rprImaging/rprEngine/frameCache.h"
+#include "pxr/rprImaging/rprEngine/pathTrie.h"
+
+#include "pxr/usd/usd/attribute.h"
+#include "pxr/usd/usd/primRange.h"
+#include "pxr/usd/usd/relationship.h"
+#include "pxr/usd/sdf/assetPath.h"
+#include "pxr/base/arch/fileSystem.h"
+#include "pxr/base/tf/diagnostic.h"
+#include "pxr/base/tf/fileUtils.h"
+#include "pxr/base/tf/pathUtils.h"
+#include "pxr/base/tf/stringUtils.h"
+#include "pxr/base/vt/types.h"
+#include "pxr/base/work/loops.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <utility>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+
+const char kMagic[8] = {'H', 'D', 'R', 'P', 'R', 'F', 'C', '\0'};
+const uint32_t kVersion = 2;
+
+// Written in native byte order, a reader with another one sees it swapped
+const uint32_t kByteOrderMark = 0x01020304;
+
+const char kEntryExtension[] = ".frame";
+
+// File layout:
+//   FileHeader
+//   per AOV: FileAov, name, pixel data
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrderMark;
+    uint64_t keyLo;
+    uint64_t keyHi;
+    uint64_t aovCount;
+};
+
+struct FileAov {
+    uint64_t nameSize;
+    uint64_t dataSize;
+    int32_t width;
+    int32_t height;
+    int32_t format;
+    int32_t padding;
+};
+
+double GetCurrentTime() {
+    return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+template <typename T>
+bool ReadValue(std::ifstream& file, T* value) {
+    return bool(file.read(reinterpret_cast<char*>(value), sizeof(T)));
+}
+
+template <typename T>
+void WriteValue(std::ofstream& file, T const& value) {
+    file.write(reinterpret_cast<char const*>(&value), sizeof(T));
+}
+
+uint64_t RotateLeft(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+uint64_t FinalMix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+const uint64_t kMurmurC1 = 0x87c37b91114253d5ULL;
+const uint64_t kMurmurC2 = 0x4cf5ad432745937fULL;
+
+const char kMasterPrefix[] = "/__Master_";
+
+bool IsInMasterPath(SdfPath const& path) {
+    return TfStringStartsWith(path.GetString(), kMasterPrefix);
+}
+
+template <typename T>
+bool AppendPlainValue(VtValue const& value, HdRprFrameHasher* hasher) {
+    if (value.IsHolding<T>()) {
+        hasher->Append(&value.UncheckedGet<T>(), sizeof(T));
+        return true;
+    }
+    if (value.IsHolding<VtArray<T>>()) {
+        VtArray<T> const& array = value.UncheckedGet<VtArray<T>>();
+        hasher->AppendPod(uint64_t(array.size()));
+        hasher->Append(array.cdata(), array.size() * sizeof(T));
+        return true;
+    }
+    return false;
+}
+
+template <typename T, typename AppendFn>
+bool AppendTextValue(VtValue const& value, HdRprFrameHasher* hasher, AppendFn const& append) {
+    if (value.IsHolding<T>()) {
+        append(value.UncheckedGet<T>());
+        return true;
+    }
+    if (value.IsHolding<VtArray<T>>()) {
+        VtArray<T> const& array = value.UncheckedGet<VtArray<T>>();
+        hasher->AppendPod(uint64_t(array.size()));
+        for (T const& element : array) {
+            append(element);
+        }
+        return true;
+    }
+    return false;
+}
+
+// Textures and other files can change on disk under the same path, so the
+// size and modification time of the resolved file are appended as well
+void AppendAssetPath(SdfAssetPath const& assetPath, HdRprFrameHasher* hasher) {
+    hasher->Append(assetPath.GetAssetPath());
+    std::string const& resolvedPath = assetPath.GetResolvedPath();
+    hasher->Append(resolvedPath);
+    if (resolvedPath.empty()) {
+        return;
+    }
+
+    double modificationTime = 0.0;
+    if (ArchGetModificationTime(resolvedPath.c_str(), &modificationTime)) {
+        hasher->AppendPod(int64_t(ArchGetFileLength(resolvedPath.c_str())));
+        hasher->AppendPod(modificationTime);
+    }
+}
+
+using MasterDigests = std::map<SdfPath, HdRprFrameDigest>;
+
+HdRprFrameDigest HashPrim(
+    UsdPrim const& prim,
+    UsdTimeCode time,
+    MasterDigests const& masterDigests,
+    SdfPathVector* targets) {
+    HdRprFrameHasher hasher;
+    hasher.AppendPath(prim.GetPath());
+    hasher.Append(prim.GetTypeName());
+
+    for (UsdAttribute const& attribute : prim.GetAttributes()) {
+        hasher.Append(attribute.GetName());
+
+        VtValue value;
+        if (attribute.Get(&value, time)) {
+            hasher.AppendValue(value);
+        }
+
+        SdfPathVector connections;
+        if (attribute.GetConnections(&connections)) {
+            for (SdfPath const& path : connections) {
+                hasher.AppendPath(path);
+                targets->push_back(path.GetPrimPath());
+            }
+        }
+    }
+
+    for (UsdRelationship const& relationship : prim.GetRelationships()) {
+        hasher.Append(relationship.GetName());
+
+        SdfPathVector relationshipTargets;
+        relationship.GetTargets(&relationshipTargets);
+        for (SdfPath const& path : relationshipTargets) {
+            hasher.AppendPath(path);
+            targets->push_back(path.GetPrimPath());
+        }
+    }
+
+    // Master paths depend on the order masters were created in
+    if (prim.IsInstance()) {
+        auto it = masterDigests.find(prim.GetMaster().GetPath());
+        if (TF_VERIFY(it != masterDigests.end())) {
+            hasher.Append(it->second);
+        }
+    }
+
+    return hasher.GetDigest();
+}
+
+// Hashes \p prims in parallel, after the masters of instances among them,
+// adding the targets they reach to \p targets
+HdRprFrameDigest HashPrims(
+    std::vector<UsdPrim> const& prims,
+    UsdTimeCode time,
+    MasterDigests* masterDigests,
+    SdfPathVector* targets) {
+    for (UsdPrim const& prim : prims) {
+        if (!prim.IsInstance()) {
+            continue;
+        }
+        UsdPrim master = prim.GetMaster();
+        if (masterDigests->count(master.GetPath())) {
+            continue;
+        }
+        std::vector<UsdPrim> masterPrims;
+        for (UsdPrim const& masterPrim : UsdPrimRange(master)) {
+            masterPrims.push_back(masterPrim);
+        }
+        HdRprFrameDigest digest = HashPrims(masterPrims, time, masterDigests, targets);
+        (*masterDigests)[master.GetPath()] = digest;
+    }
+
+    std::vector<HdRprFrameDigest> primDigests(prims.size());
+    std::vector<SdfPathVector> primTargets(prims.size());
+    WorkParallelForN(prims.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            primDigests[i] = HashPrim(prims[i], time, *masterDigests, &primTargets[i]);
+        }
+    });
+
+    HdRprFrameHasher hasher;
+    for (size_t i = 0; i < prims.size(); ++i) {
+        hasher.Append(primDigests[i]);
+        targets->insert(targets->end(), primTargets[i].begin(), primTargets[i].end());
+    }
+    return hasher.GetDigest();
+}
+
+} // namespace anonymous
+
+HdRprFrameHasher::HdRprFrameHasher()
+    : m_h1(0)
+    , m_h2(0)
+    , m_length(0)
+    , m_bufferSize(0) {
+
+}
+
+void HdRprFrameHasher::_MixBlock(uint8_t const* block) {
+    uint64_t k1;
+    uint64_t k2;
+    std::memcpy(&k1, block, 8);
+    std::memcpy(&k2, block + 8, 8);
+
+    k1 *= kMurmurC1;
+    k1 = RotateLeft(k1, 31);
+    k1 *= kMurmurC2;
+    m_h1 ^= k1;
+    m_h1 = RotateLeft(m_h1, 27);
+    m_h1 += m_h2;
+    m_h1 = m_h1 * 5 + 0x52dce729;
+
+    k2 *= kMurmurC2;
+    k2 = RotateLeft(k2, 33);
+    k2 *= kMurmurC1;
+    m_h2 ^= k2;
+    m_h2 = RotateLeft(m_h2, 31);
+    m_h2 += m_h1;
+    m_h2 = m_h2 * 5 + 0x38495ab5;
+}
+
+void HdRprFrameHasher::Append(void const* data, size_t size) {
+    auto bytes = static_cast<uint8_t const*>(data);
+    m_length += size;
+
+    if (m_bufferSize > 0) {
+        size_t count = std::min(size, sizeof(m_buffer) - m_bufferSize);
+        std::memcpy(m_buffer + m_bufferSize, bytes, count);
+        m_bufferSize += count;
+        bytes += count;
+        size -= count;
+        if (m_bufferSize < sizeof(m_buffer)) {
+            return;
+        }
+        _MixBlock(m_buffer);
+        m_bufferSize = 0;
+    }
+
+    for (; size >= sizeof(m_buffer); bytes += sizeof(m_buffer), size -= sizeof(m_buffer)) {
+        _MixBlock(bytes);
+    }
+
+    std::memcpy(m_buffer, bytes, size);
+    m_bufferSize = size;
+}
+
+void HdRprFrameHasher::AppendPath(SdfPath const& path) {
+    std::string const& string = path.GetString();
+    if (!IsInMasterPath(path)) {
+        Append(string);
+        return;
+    }
+
+    size_t end = string.find_first_of("/.", 1);
+    Append("/__Master" + (end == std::string::npos ? std::string() : string.substr(end)));
+}
+
+void HdRprFrameHasher::AppendValue(VtValue const& value) {
+    Append(value.GetTypeName());
+    if (value.IsEmpty()) {
+        return;
+    }
+
+    bool isAppended =
+        AppendPlainValue<bool>(value, this) ||
+        AppendPlainValue<unsigned char>(value, this) ||
+        AppendPlainValue<int>(value, this) ||
+        AppendPlainValue<unsigned int>(value, this) ||
+        AppendPlainValue<int64_t>(value, this) ||
+        AppendPlainValue<uint64_t>(value, this) ||
+        AppendPlainValue<GfHalf>(value, this) ||
+        AppendPlainValue<float>(value, this) ||
+        AppendPlainValue<double>(value, this) ||
+        AppendPlainValue<GfVec2i>(value, this) ||
+        AppendPlainValue<GfVec3i>(value, this) ||
+        AppendPlainValue<GfVec4i>(value, this) ||
+        AppendPlainValue<GfVec2h>(value, this) ||
+        AppendPlainValue<GfVec3h>(value, this) ||
+        AppendPlainValue<GfVec4h>(value, this) ||
+        AppendPlainValue<GfVec2f>(value, this) ||
+        AppendPlainValue<GfVec3f>(value, this) ||
+        AppendPlainValue<GfVec4f>(value, this) ||
+        AppendPlainValue<GfVec2d>(value, this) ||
+        AppendPlainValue<GfVec3d>(value, this) ||
+        AppendPlainValue<GfVec4d>(value, this) ||
+        AppendPlainValue<GfQuath>(value, this) ||
+        AppendPlainValue<GfQuatf>(value, this) ||
+        AppendPlainValue<GfQuatd>(value, this) ||
+        AppendPlainValue<GfMatrix2d>(value, this) ||
+        AppendPlainValue<GfMatrix3d>(value, this) ||
+        AppendPlainValue<GfMatrix4d>(value, this) ||
+        AppendTextValue<std::string>(value, this, [this](std::string const& v) { Append(v); }) ||
+        AppendTextValue<TfToken>(value, this, [this](TfToken const& v) { Append(v); }) ||
+        AppendTextValue<SdfAssetPath>(value, this, [this](SdfAssetPath const& v) { AppendAssetPath(v, this); }) ||
+        AppendTextValue<SdfPath>(value, this, [this](SdfPath const& v) { AppendPath(v); });
+    if (!isAppended) {
+        Append(TfStringify(value));
+    }
+}
+
+HdRprFrameDigest HdRprFrameHasher::GetDigest() const {
+    uint64_t h1 = m_h1;
+    uint64_t h2 = m_h2;
+
+    // The tail, zero padded, read as little-endian words
+    uint8_t tail[sizeof(m_buffer)] = {};
+    std::memcpy(tail, m_buffer, m_bufferSize);
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+    for (int i = 7; i >= 0; --i) {
+        k1 = (k1 << 8) | tail[i];
+        k2 = (k2 << 8) | tail[8 + i];
+    }
+    if (m_bufferSize > 8) {
+        k2 *= kMurmurC2;
+        k2 = RotateLeft(k2, 33);
+        k2 *= kMurmurC1;
+        h2 ^= k2;
+    }
+    if (m_bufferSize > 0) {
+        k1 *= kMurmurC1;
+        k1 = RotateLeft(k1, 31);
+        k1 *= kMurmurC2;
+        h1 ^= k1;
+    }
+
+    h1 ^= m_length;
+    h2 ^= m_length;
+    h1 += h2;
+    h2 += h1;
+    h1 = FinalMix(h1);
+    h2 = FinalMix(h2);
+    h1 += h2;
+    h2 += h1;
+
+    HdRprFrameDigest digest;
+    digest.lo = h1;
+    digest.hi = h2;
+    return digest;
+}
+
+HdRprFrameCache::HdRprFrameCache(std::string const& directory, size_t maxBytes)
+    : m_directory(directory)
+    , m_isValid(false)
+    , m_maxBytes(maxBytes)
+    , m_size(0)
+    , m_hitCount(0)
+    , m_missCount(0) {
+    if (!TfIsDir(m_directory) && !TfMakeDirs(m_directory)) {
+        TF_RUNTIME_ERROR("Failed to create frame cache directory %s", m_directory.c_str());
+        return;
+    }
+    m_isValid = true;
+
+    _Index();
+    _Evict();
+}
+
+std::string HdRprFrameCache::_GetEntryPath(HdRprFrameDigest const& key) const {
+    return TfStringCatPaths(m_directory, TfStringPrintf("%016llx%016llx%s",
+        (unsigned long long)key.hi, (unsigned long long)key.lo, kEntryExtension));
+}
+
+void HdRprFrameCache::_Index() {
+    std::vector<std::string> dirNames;
+    std::vector<std::string> fileNames;
+    if (!TfReadDir(m_directory, &dirNames, &fileNames, nullptr)) {
+        return;
+    }
+
+    for (std::string const& fileName : fileNames) {
+        // Skips temporary files of writes in progress or interrupted
+        if (!TfStringEndsWith(fileName, kEntryExtension)) {
+            continue;
+        }
+
+        std::string keyString = TfStringGetBeforeSuffix(fileName);
+        if (keyString.size() != 32 ||
+            keyString.find_first_not_of("0123456789abcdef") != std::string::npos) {
+            continue;
+        }
+        HdRprFrameDigest key;
+        key.hi = std::strtoull(keyString.substr(0, 16).c_str(), nullptr, 16);
+        key.lo = std::strtoull(keyString.substr(16).c_str(), nullptr, 16);
+
+        std::string path = TfStringCatPaths(m_directory, fileName);
+        int64_t size = ArchGetFileLength(path.c_str());
+        double modificationTime = 0.0;
+        if (size < 0 || !ArchGetModificationTime(path.c_str(), &modificationTime)) {
+            continue;
+        }
+
+        m_entries[key] = {size_t(size), modificationTime};
+        m_size += size_t(size);
+    }
+}
+
+void HdRprFrameCache::SetMaxBytes(size_t maxBytes) {
+    m_maxBytes = maxBytes;
+    _Evict();
+}
+
+void HdRprFrameCache::_Evict() {
+    while (m_size > m_maxBytes && !m_entries.empty()) {
+        auto oldest = std::min_element(m_entries.begin(), m_entries.end(),
+            [](std::pair<const HdRprFrameDigest, _Entry> const& lhs,
+               std::pair<const HdRprFrameDigest, _Entry> const& rhs) {
+                return lhs.second.useTime < rhs.second.useTime;
+            });
+        ArchUnlinkFile(_GetEntryPath(oldest->first).c_str());
+        _Erase(oldest->first);
+    }
+}
+
+void HdRprFrameCache::_Erase(HdRprFrameDigest const& key) {
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        m_size -= it->second.size;
+        m_entries.erase(it);
+    }
+}
+
+bool HdRprFrameCache::Load(
+    HdRprFrameDigest const& key,
+    TfTokenVector const& aovs,
+    AovImageMap* images) {
+    if (!m_isValid || aovs.empty()) {
+        ++m_missCount;
+        return false;
+    }
+
+    // Other processes sharing the directory may have stored the entry since
+    // it was indexed, or evicted it
+    std::string path = _GetEntryPath(key);
+    auto entryIt = m_entries.find(key);
+    if (entryIt == m_entries.end()) {
+        int64_t size = ArchGetFileLength(path.c_str());
+        if (size < 0) {
+            ++m_missCount;
+            return false;
+        }
+        entryIt = m_entries.emplace(key, _Entry{size_t(size), 0.0}).first;
+        m_size += size_t(size);
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    FileHeader header;
+    if (!file || !ReadValue(file, &header) ||
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.version != kVersion || header.byteOrderMark != kByteOrderMark ||
+        header.keyLo != key.lo || header.keyHi != key.hi) {
+        _Erase(key);
+        ++m_missCount;
+        return false;
+    }
+
+    struct AovLocation {
+        FileAov aov;
+        std::streamoff dataOffset;
+    };
+    TfHashMap<TfToken, AovLocation, TfToken::HashFunctor> locations;
+    for (uint64_t i = 0; i < header.aovCount; ++i) {
+        AovLocation location;
+        std::string name;
+        if (!ReadValue(file, &location.aov) || location.aov.nameSize > 1024) {
+            break;
+        }
+        name.resize(location.aov.nameSize);
+        if (!file.read(&name[0], std::streamsize(name.size()))) {
+            break;
+        }
+        location.dataOffset = file.tellg();
+        file.seekg(std::streamoff(location.aov.dataSize), std::ios::cur);
+        locations[TfToken(name)] = location;
+    }
+
+    for (TfToken const& aov : aovs) {
+        auto it = locations.find(aov);
+        if (it == locations.end()) {
+            ++m_missCount;
+            return false;
+        }
+
+        FileAov const& fileAov = it->second.aov;
+        HdFormat format = HdFormat(fileAov.format);
+        if (fileAov.width <= 0 || fileAov.height <= 0 || format <= HdFormatInvalid || format >= HdFormatCount ||
+            fileAov.dataSize != uint64_t(fileAov.width) * fileAov.height * HdDataSizeOfFormat(format)) {
+            TF_WARN("Frame cache entry %s is corrupted", path.c_str());
+            _Erase(key);
+            ++m_missCount;
+            return false;
+        }
+    }
+
+    // Read into separate images so that a truncated entry leaves the
+    // output images unchanged
+    AovImageMap loadedImages;
+    file.clear();
+    for (TfToken const& aov : aovs) {
+        AovLocation const& location = locations[aov];
+        HdRprAovImage& image = loadedImages[aov];
+        image.Resize(location.aov.width, location.aov.height, HdFormat(location.aov.format));
+        file.seekg(location.dataOffset);
+        if (!file.read(reinterpret_cast<char*>(image.GetData()), std::streamsize(location.aov.dataSize))) {
+            break;
+        }
+    }
+    if (!file) {
+        TF_WARN("Failed to read frame cache entry %s", path.c_str());
+        _Erase(key);
+        ++m_missCount;
+        return false;
+    }
+
+    for (auto& entry : loadedImages) {
+        std::swap((*images)[entry.first], entry.second);
+    }
+
+    entryIt->second.useTime = GetCurrentTime();
+    ++m_hitCount;
+    return true;
+}
+
+bool HdRprFrameCache::Store(HdRprFrameDigest const& key, TfTokenVector const& aovs, AovImageMap const& images) {
+    if (!m_isValid) {
+        return false;
+    }
+
+    std::vector<std::pair<TfToken, HdRprAovImage const*>> stored;
+    for (TfToken const& aov : aovs) {
+        auto it = images.find(aov);
+        if (it != images.end() && !it->second.IsEmpty()) {
+            stored.emplace_back(aov, &it->second);
+        }
+    }
+    if (stored.empty()) {
+        return false;
+    }
+
+    std::string path = _GetEntryPath(key);
+    std::string tempPath = TfStringPrintf("%s.%08x.tmp", path.c_str(), unsigned(std::random_device()()));
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            TF_RUNTIME_ERROR("Failed to open %s for writing", tempPath.c_str());
+            return false;
+        }
+
+        FileHeader header = {};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.byteOrderMark = kByteOrderMark;
+        header.keyLo = key.lo;
+        header.keyHi = key.hi;
+        header.aovCount = stored.size();
+        WriteValue(file, header);
+
+        for (auto const& entry : stored) {
+            HdRprAovImage const& image = *entry.second;
+            std::string const& name = entry.first.GetString();
+
+            FileAov aov = {};
+            aov.nameSize = name.size();
+            aov.dataSize = uint64_t(image.GetWidth()) * image.GetHeight() * image.GetPixelSize();
+            aov.width = image.GetWidth();
+            aov.height = image.GetHeight();
+            aov.format = int32_t(image.GetFormat());
+            WriteValue(file, aov);
+            file.write(name.data(), std::streamsize(name.size()));
+            file.write(reinterpret_cast<char const*>(image.GetData()), std::streamsize(aov.dataSize));
+        }
+
+        if (!file) {
+            file.close();
+            ArchUnlinkFile(tempPath.c_str());
+            TF_RUNTIME_ERROR("Failed to write frame cache entry %s", path.c_str());
+            return false;
+        }
+    }
+
+    // Windows doesn't rename over existing files, another process may have
+    // stored the same frame meanwhile
+    ArchUnlinkFile(path.c_str());
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        ArchUnlinkFile(tempPath.c_str());
+        return false;
+    }
+
+    int64_t size = ArchGetFileLength(path.c_str());
+    _Erase(key);
+    m_entries[key] = {size_t(std::max(size, int64_t(0))), GetCurrentTime()};
+    m_size += m_entries[key].size;
+    _Evict();
+    return true;
+}
+
+HdRprFrameDigest HdRprHashStageState(UsdStageRefPtr const& stage, SdfPathVector const& rootPaths, UsdTimeCode time) {
+    HdRprFrameHasher hasher;
+    if (!stage) {
+        return hasher.GetDigest();
+    }
+
+    // Subtrees already hashed, roots first and then the targets reached
+    // from them that lie outside. Masters are hashed through their
+    // instances.
+    HdRprPathTrie hashedPaths;
+    MasterDigests masterDigests;
+    SdfPathVector pending = rootPaths;
+    while (!pending.empty()) {
+        std::vector<UsdPrim> prims;
+        for (SdfPath const& path : pending) {
+            if (hashedPaths.IsCovered(path)) {
+                continue;
+            }
+            hashedPaths.Insert(path);
+
+            UsdPrim root = stage->GetPrimAtPath(path);
+            if (!root) {
+                continue;
+            }
+            for (UsdPrim const& prim : UsdPrimRange(root)) {
+                prims.push_back(prim);
+            }
+        }
+        pending.clear();
+
+        SdfPathVector targets;
+        hasher.Append(HashPrims(prims, time, &masterDigests, &targets));
+
+        for (SdfPath const& target : targets) {
+            if (!IsInMasterPath(target) && !hashedPaths.IsCovered(target)) {
+                pending.push_back(target);
+            }
+        }
+    }
+
+    return hasher.GetDigest();
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
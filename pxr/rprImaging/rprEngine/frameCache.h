@@ -0,0 +1,168 @@
+#ifndef HDRPR_FRAME_CACHE_H
+#define HDRPR_FRAME_CACHE_H
+
+#include "api.h"
+
+#include "pxr/rprImaging/rprEngine/aovImage.h"
+
+#include "pxr/usd/usd/stage.h"
+#include "pxr/usd/usd/timeCode.h"
+#include "pxr/usd/sdf/path.h"
+#include "pxr/base/tf/hashmap.h"
+#include "pxr/base/tf/token.h"
+#include "pxr/base/vt/value.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <type_traits>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+/// 128-bit digest identifying a frame across processes.
+struct HdRprFrameDigest {
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+
+    bool operator==(HdRprFrameDigest const& other) const { return lo == other.lo && hi == other.hi; }
+    bool operator!=(HdRprFrameDigest const& other) const { return !(*this == other); }
+    bool operator<(HdRprFrameDigest const& other) const {
+        return hi < other.hi || (hi == other.hi && lo < other.lo);
+    }
+};
+
+/// \class HdRprFrameHasher
+///
+/// Computes a HdRprFrameDigest with MurmurHash3 (x64, 128-bit) over the
+/// bytes appended to it. Unlike TfHash and VtValue::GetHash(), the result
+/// doesn't depend on addresses or interned handles, so the same input gives
+/// the same digest in every process on machines of the same byte order.
+///
+class HdRprFrameHasher {
+public:
+    HDRPR_API
+    HdRprFrameHasher();
+
+    HDRPR_API
+    void Append(void const* data, size_t size);
+
+    void Append(std::string const& string) {
+        AppendPod(uint64_t(string.size()));
+        Append(string.data(), string.size());
+    }
+
+    void Append(TfToken const& token) { Append(token.GetString()); }
+
+    void Append(HdRprFrameDigest const& digest) { AppendPod(digest.lo); AppendPod(digest.hi); }
+
+    template <typename T>
+    void AppendPod(T const& value) {
+        static_assert(std::is_arithmetic<T>::value, "Only arithmetic values have a stable layout");
+        Append(&value, sizeof(T));
+    }
+
+    /// Appends the text of \p path, with instance master paths, which
+    /// depend on the order masters were created in, replaced by a fixed one.
+    HDRPR_API
+    void AppendPath(SdfPath const& path);
+
+    /// Appends the type and content of \p value: the bytes of plain values
+    /// and arrays of them, the text of strings, tokens and paths, the
+    /// authored and resolved paths of asset paths along with the size and
+    /// modification time of the resolved file, and the streamed text of
+    /// anything else.
+    HDRPR_API
+    void AppendValue(VtValue const& value);
+
+    HDRPR_API
+    HdRprFrameDigest GetDigest() const;
+
+private:
+    void _MixBlock(uint8_t const* block);
+
+private:
+    uint64_t m_h1;
+    uint64_t m_h2;
+    uint64_t m_length;
+    uint8_t m_buffer[16];
+    size_t m_bufferSize;
+};
+
+/// \class HdRprFrameCache
+///
+/// Stores finished frames on disk, one file per frame named after a digest
+/// that the engine computes from everything the frame depends on. The
+/// digest is stored in the file as well and verified on load. Entries
+/// are evicted least recently used first once their total size exceeds the
+/// limit. Several processes may share a directory, entries are written to
+/// a temporary file first and renamed into place.
+///
+/// Not thread-safe, the engine uses it from the rendering thread only.
+///
+class HdRprFrameCache {
+public:
+    using AovImageMap = TfHashMap<TfToken, HdRprAovImage, TfToken::HashFunctor>;
+
+    /// Opens the cache in \p directory, creating it if needed, and indexes
+    /// the entries already in it.
+    HDRPR_API
+    HdRprFrameCache(std::string const& directory, size_t maxBytes);
+
+    /// Return false if the directory couldn't be created.
+    bool IsValid() const { return m_isValid; }
+
+    std::string const& GetDirectory() const { return m_directory; }
+
+    /// Set the most disk space entries may take, evicting as needed.
+    HDRPR_API
+    void SetMaxBytes(size_t maxBytes);
+
+    /// Reads the \p aovs of the frame with \p key into \p images. Returns
+    /// false, leaving \p images unchanged, if the frame or any of the AOVs
+    /// is not in the cache.
+    HDRPR_API
+    bool Load(HdRprFrameDigest const& key, TfTokenVector const& aovs, AovImageMap* images);
+
+    /// Stores the \p aovs of \p images as the frame with \p key.
+    HDRPR_API
+    bool Store(HdRprFrameDigest const& key, TfTokenVector const& aovs, AovImageMap const& images);
+
+    size_t GetHitCount() const { return m_hitCount; }
+    size_t GetMissCount() const { return m_missCount; }
+    size_t GetEntryCount() const { return m_entries.size(); }
+    size_t GetSize() const { return m_size; }
+
+private:
+    std::string _GetEntryPath(HdRprFrameDigest const& key) const;
+
+    void _Index();
+    void _Evict();
+    void _Erase(HdRprFrameDigest const& key);
+
+private:
+    struct _Entry {
+        size_t size;
+        // Modification time of the file, updated on use by this process
+        double useTime;
+    };
+
+    std::string m_directory;
+    bool m_isValid;
+    size_t m_maxBytes;
+    size_t m_size;
+    size_t m_hitCount;
+    size_t m_missCount;
+    std::map<HdRprFrameDigest, _Entry> m_entries;
+};
+
+/// Hashes the composed state of the prims under \p rootPaths at \p time:
+/// their paths, types, attribute values and relationship targets. Prims
+/// outside of the roots that are targeted, such as bound materials, are
+/// hashed as well, and instances by the content of their master.
+HDRPR_API
+HdRprFrameDigest HdRprHashStageState(UsdStageRefPtr const& stage, SdfPathVector const& rootPaths, UsdTimeCode time);
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_FRAME_CACHE_H
@@ -0,0 +1,294 @@
+#include "pxr/rprImaging/rprEngine/frustumCuller.h"
+
+#include "pxr/usd/usd/primRange.h"
+#include "pxr/usd/usd/stage.h"
+#include "pxr/usd/usdGeom/bboxCache.h"
+#include "pxr/usd/usdGeom/tokens.h"
+#include "pxr/base/arch/defines.h"
+#include "pxr/base/gf/vec4d.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(ARCH_CPU_INTEL)
+#include <xmmintrin.h>
+#endif
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+
+// The near and side planes padded to a multiple of the SIMD width. There is
+// no far plane, renderers don't necessarily clip there.
+const int kPlaneCount = 8;
+
+// Planes stored one array per coefficient, with the normals pointing into
+// the frustum and d already moved outwards by the margin
+struct Planes {
+    alignas(16) float a[kPlaneCount];
+    alignas(16) float b[kPlaneCount];
+    alignas(16) float c[kPlaneCount];
+    alignas(16) float d[kPlaneCount];
+};
+
+enum class Containment {
+    Outside,
+    Inside,
+    Intersecting
+};
+
+GfVec4d GetColumn(GfMatrix4d const& m, int j) {
+    return GfVec4d(m[0][j], m[1][j], m[2][j], m[3][j]);
+}
+
+Planes MakePlanes(GfMatrix4d const& viewProjection, double margin) {
+    GfVec4d x = GetColumn(viewProjection, 0);
+    GfVec4d y = GetColumn(viewProjection, 1);
+    GfVec4d z = GetColumn(viewProjection, 2);
+    GfVec4d w = GetColumn(viewProjection, 3);
+    GfVec4d clipPlanes[] = {w + x, w - x, w + y, w - y, w + z};
+
+    // Padding planes everything is inside of
+    Planes planes;
+    std::fill(planes.a, planes.a + kPlaneCount, 0.0f);
+    std::fill(planes.b, planes.b + kPlaneCount, 0.0f);
+    std::fill(planes.c, planes.c + kPlaneCount, 0.0f);
+    std::fill(planes.d, planes.d + kPlaneCount, std::numeric_limits<float>::max());
+
+    int count = 0;
+    for (GfVec4d const& plane : clipPlanes) {
+        double length = GfVec3d(plane[0], plane[1], plane[2]).GetLength();
+        if (length <= 0.0) {
+            continue;
+        }
+        planes.a[count] = float(plane[0] / length);
+        planes.b[count] = float(plane[1] / length);
+        planes.c[count] = float(plane[2] / length);
+        planes.d[count] = float(plane[3] / length + margin);
+        ++count;
+    }
+    return planes;
+}
+
+// Tests the corner of \p bound farthest along each plane normal, which is
+// outside of the plane only if the whole box is, and the nearest corner,
+// which is inside only if the whole box is
+Containment Classify(Planes const& planes, GfRange3f const& bound) {
+    GfVec3f const& lo = bound.GetMin();
+    GfVec3f const& hi = bound.GetMax();
+    bool isInside = true;
+
+#if defined(ARCH_CPU_INTEL)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 loX = _mm_set1_ps(lo[0]);
+    const __m128 loY = _mm_set1_ps(lo[1]);
+    const __m128 loZ = _mm_set1_ps(lo[2]);
+    const __m128 hiX = _mm_set1_ps(hi[0]);
+    const __m128 hiY = _mm_set1_ps(hi[1]);
+    const __m128 hiZ = _mm_set1_ps(hi[2]);
+    for (int i = 0; i < kPlaneCount; i += 4) {
+        __m128 a = _mm_load_ps(planes.a + i);
+        __m128 b = _mm_load_ps(planes.b + i);
+        __m128 c = _mm_load_ps(planes.c + i);
+        __m128 d = _mm_load_ps(planes.d + i);
+
+        __m128 aLo = _mm_mul_ps(a, loX);
+        __m128 aHi = _mm_mul_ps(a, hiX);
+        __m128 bLo = _mm_mul_ps(b, loY);
+        __m128 bHi = _mm_mul_ps(b, hiY);
+        __m128 cLo = _mm_mul_ps(c, loZ);
+        __m128 cHi = _mm_mul_ps(c, hiZ);
+
+        __m128 farthest = _mm_add_ps(_mm_add_ps(_mm_max_ps(aLo, aHi), _mm_max_ps(bLo, bHi)),
+                                     _mm_add_ps(_mm_max_ps(cLo, cHi), d));
+        if (_mm_movemask_ps(_mm_cmplt_ps(farthest, zero))) {
+            return Containment::Outside;
+        }
+
+        __m128 nearest = _mm_add_ps(_mm_add_ps(_mm_min_ps(aLo, aHi), _mm_min_ps(bLo, bHi)),
+                                    _mm_add_ps(_mm_min_ps(cLo, cHi), d));
+        if (_mm_movemask_ps(_mm_cmplt_ps(nearest, zero))) {
+            isInside = false;
+        }
+    }
+#else
+    for (int i = 0; i < kPlaneCount; ++i) {
+        float aLo = planes.a[i] * lo[0];
+        float aHi = planes.a[i] * hi[0];
+        float bLo = planes.b[i] * lo[1];
+        float bHi = planes.b[i] * hi[1];
+        float cLo = planes.c[i] * lo[2];
+        float cHi = planes.c[i] * hi[2];
+
+        float farthest = std::max(aLo, aHi) + std::max(bLo, bHi) + std::max(cLo, cHi) + planes.d[i];
+        if (farthest < 0.0f) {
+            return Containment::Outside;
+        }
+
+        float nearest = std::min(aLo, aHi) + std::min(bLo, bHi) + std::min(cLo, cHi) + planes.d[i];
+        if (nearest < 0.0f) {
+            isInside = false;
+        }
+    }
+#endif
+
+    return isInside ? Containment::Inside : Containment::Intersecting;
+}
+
+} // namespace anonymous
+
+HdRprFrustumCuller::HdRprFrustumCuller()
+    : m_nodesValid(false)
+    , m_boundsValid(false)
+    , m_viewProjection(1.0)
+    , m_margin(0.0)
+    , m_culledPathsValid(false) {
+
+}
+
+void HdRprFrustumCuller::Invalidate() {
+    m_nodesValid = false;
+    m_boundsValid = false;
+}
+
+void HdRprFrustumCuller::InvalidateBounds() {
+    m_boundsValid = false;
+}
+
+void HdRprFrustumCuller::Clear() {
+    m_culledPaths.clear();
+    m_culledPathsValid = false;
+}
+
+bool HdRprFrustumCuller::Update(
+    UsdPrim const& root,
+    HdRprPathTrie const& excludedPaths,
+    UsdTimeCode frame,
+    GfMatrix4d const& viewProjection,
+    double margin) {
+    if (!root) {
+        bool changed = !m_culledPaths.empty();
+        Clear();
+        return changed;
+    }
+
+    if (root.GetStage() != m_stage ||
+        (!m_nodes.empty() && m_nodes.front().path != root.GetPath())) {
+        m_nodesValid = false;
+    }
+
+    if (!m_nodesValid) {
+        _Gather(root, excludedPaths);
+        m_boundsValid = false;
+    }
+
+    UsdStageRefPtr stage = m_stage;
+    if (!stage) {
+        return false;
+    }
+
+    if (!m_boundsValid || frame != m_boundsFrame) {
+        _ComputeBounds(stage, frame);
+    } else if (m_culledPathsValid &&
+               viewProjection == m_viewProjection &&
+               margin == m_margin) {
+        return false;
+    }
+
+    m_viewProjection = viewProjection;
+    m_margin = margin;
+    m_culledPathsValid = true;
+
+    Planes planes = MakePlanes(viewProjection, margin);
+
+    SdfPathVector culledPaths;
+    for (size_t i = 0; i < m_nodes.size();) {
+        // Prims without geometry of their own, like the pseudo-root, may
+        // still have descendants with bounds
+        GfRange3f const& bound = m_bounds[i];
+        Containment containment = bound.IsEmpty() ? Containment::Intersecting : Classify(planes, bound);
+
+        if (containment == Containment::Outside && !m_nodes[i].hasInstances) {
+            culledPaths.push_back(m_nodes[i].path);
+            i = m_nodes[i].subtreeEnd;
+        } else if (containment == Containment::Inside) {
+            i = m_nodes[i].subtreeEnd;
+        } else {
+            ++i;
+        }
+    }
+    std::sort(culledPaths.begin(), culledPaths.end());
+
+    if (culledPaths == m_culledPaths) {
+        return false;
+    }
+    m_culledPaths.swap(culledPaths);
+    return true;
+}
+
+void HdRprFrustumCuller::_Gather(UsdPrim const& root, HdRprPathTrie const& excludedPaths) {
+    m_nodes.clear();
+    m_stage = root.GetStage();
+
+    // Nodes whose subtree is still being visited
+    std::vector<uint32_t> openNodes;
+
+    UsdPrimRange range = UsdPrimRange::PreAndPostVisit(root);
+    for (auto it = range.begin(); it != range.end(); ++it) {
+        UsdPrim prim = *it;
+
+        if (it.IsPostVisit()) {
+            if (!openNodes.empty() && m_nodes[openNodes.back()].path == prim.GetPath()) {
+                _Node& node = m_nodes[openNodes.back()];
+                node.subtreeEnd = uint32_t(m_nodes.size());
+                openNodes.pop_back();
+                if (node.hasInstances && !openNodes.empty()) {
+                    m_nodes[openNodes.back()].hasInstances = true;
+                }
+            }
+            continue;
+        }
+
+        if (excludedPaths.IsCovered(prim.GetPath())) {
+            it.PruneChildren();
+            continue;
+        }
+
+        // The rprims of all instances of a master live under the first
+        // instance, so excluding it would hide the others as well, and
+        // excluding any other instance has no effect. Neither instances nor
+        // their ancestors are culled as a whole.
+        if (prim.IsInstance()) {
+            it.PruneChildren();
+            m_nodes.push_back({prim.GetPath(), uint32_t(m_nodes.size() + 1), true});
+            if (!openNodes.empty()) {
+                m_nodes[openNodes.back()].hasInstances = true;
+            }
+            continue;
+        }
+
+        openNodes.push_back(uint32_t(m_nodes.size()));
+        m_nodes.push_back({prim.GetPath(), 0, false});
+    }
+
+    m_bounds.clear();
+    m_nodesValid = true;
+}
+
+void HdRprFrustumCuller::_ComputeBounds(UsdStageRefPtr const& stage, UsdTimeCode frame) {
+    // All purposes the renderer may draw, so that no drawn prim is culled
+    UsdGeomBBoxCache bboxCache(frame, {UsdGeomTokens->default_, UsdGeomTokens->render, UsdGeomTokens->proxy},
+                               /* useExtentsHint = */ true);
+
+    m_bounds.resize(m_nodes.size());
+    for (size_t i = 0; i < m_nodes.size(); ++i) {
+        UsdPrim prim = stage->GetPrimAtPath(m_nodes[i].path);
+        GfRange3d range = prim ? bboxCache.ComputeWorldBound(prim).ComputeAlignedRange() : GfRange3d();
+        m_bounds[i] = range.IsEmpty() ? GfRange3f() : GfRange3f(GfVec3f(range.GetMin()), GfVec3f(range.GetMax()));
+    }
+
+    m_boundsFrame = frame;
+    m_boundsValid = true;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
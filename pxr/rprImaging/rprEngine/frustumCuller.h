@@ -0,0 +1,90 @@
+#ifndef HDRPR_FRUSTUM_CULLER_H
+#define HDRPR_FRUSTUM_CULLER_H
+
+#include "api.h"
+
+#include "pxr/rprImaging/rprEngine/pathTrie.h"
+
+#include "pxr/usd/usd/common.h"
+#include "pxr/usd/usd/prim.h"
+#include "pxr/usd/usd/timeCode.h"
+#include "pxr/usd/sdf/path.h"
+#include "pxr/base/gf/matrix4d.h"
+#include "pxr/base/gf/range3f.h"
+
+#include <cstdint>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class HdRprFrustumCuller
+///
+/// Finds the topmost prims whose world bounds lie entirely outside of a
+/// camera frustum. The prim hierarchy and its bounds are gathered once and
+/// kept until the stage, the frame or the excluded paths change, so a camera
+/// move only walks the hierarchy, skipping subtrees that are entirely inside
+/// or outside of the frustum. Native instances are never culled, Hydra can't
+/// leave them out one by one.
+///
+class HdRprFrustumCuller {
+public:
+    HDRPR_API
+    HdRprFrustumCuller();
+
+    /// Forget the gathered hierarchy, e.g. after the stage was resynced.
+    HDRPR_API
+    void Invalidate();
+
+    /// Recompute the bounds, e.g. after prims were moved.
+    HDRPR_API
+    void InvalidateBounds();
+
+    /// Cull the prims under \p root that are not under \p excludedPaths
+    /// against the frustum of \p viewProjection, widened by \p margin in
+    /// world units. Returns true if the culled paths changed.
+    HDRPR_API
+    bool Update(UsdPrim const& root,
+                HdRprPathTrie const& excludedPaths,
+                UsdTimeCode frame,
+                GfMatrix4d const& viewProjection,
+                double margin);
+
+    /// Cull nothing until the next Update().
+    HDRPR_API
+    void Clear();
+
+    /// Sorted paths of the culled prims that don't have a culled ancestor.
+    SdfPathVector const& GetCulledPaths() const { return m_culledPaths; }
+
+private:
+    void _Gather(UsdPrim const& root, HdRprPathTrie const& excludedPaths);
+    void _ComputeBounds(UsdStageRefPtr const& stage, UsdTimeCode frame);
+
+private:
+    struct _Node {
+        SdfPath path;
+        // Index of the first node after the subtree of this one
+        uint32_t subtreeEnd;
+        // Whether the node is or has a native instance below it, such nodes
+        // are never culled
+        bool hasInstances;
+    };
+    // Nodes in pre-order, so the subtree of a node directly follows it
+    std::vector<_Node> m_nodes;
+    // Aligned world bounds of the nodes, empty for nodes without geometry
+    std::vector<GfRange3f> m_bounds;
+    bool m_nodesValid;
+    UsdStageWeakPtr m_stage;
+
+    UsdTimeCode m_boundsFrame;
+    bool m_boundsValid;
+
+    GfMatrix4d m_viewProjection;
+    double m_margin;
+    bool m_culledPathsValid;
+    SdfPathVector m_culledPaths;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_FRUSTUM_CULLER_H
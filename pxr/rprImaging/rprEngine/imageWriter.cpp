@@ -0,0 +1,592 @@
+#include "pxr/rprImaging/rprEngine/imageWriter.h"
+#include "pxr/rprImaging/rprEngine/aovImage.h"
+
+#include "pxr/base/gf/half.h"
+#include "pxr/base/tf/diagnostic.h"
+#include "pxr/base/tf/stringUtils.h"
+#include "pxr/base/work/loops.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+// Prman linear to display
+float LinearToSRGB(float u) {
+    return u < 0.0031308f ? 12.92f * u : 1.055f * std::pow(u, 0.4167f) - 0.055f;
+}
+
+float ReadComponent(uint8_t const* data, HdFormat componentFormat) {
+    switch (componentFormat) {
+        case HdFormatUNorm8: return *data / 255.0f;
+        case HdFormatSNorm8: return std::max(*reinterpret_cast<int8_t const*>(data) / 127.0f, -1.0f);
+        case HdFormatFloat16: return float(*reinterpret_cast<GfHalf const*>(data));
+        case HdFormatFloat32: return *reinterpret_cast<float const*>(data);
+        default: return 0.0f;
+    }
+}
+
+struct SourceImage {
+    uint8_t const* data;
+    int width;
+    int height;
+    HdFormat componentFormat;
+    size_t componentSize;
+    int componentCount;
+
+    uint8_t const* GetComponent(int x, int y, int c) const {
+        return data + ((size_t(y) * width + x) * componentCount + c) * componentSize;
+    }
+};
+
+// All multi-byte values are written explicitly, independent of the host
+// byte order
+
+void AppendLE16(Bytes* out, uint16_t value) {
+    out->push_back(uint8_t(value));
+    out->push_back(uint8_t(value >> 8));
+}
+
+void AppendLE32(Bytes* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out->push_back(uint8_t(value >> (8 * i)));
+    }
+}
+
+void AppendLE64(Bytes* out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out->push_back(uint8_t(value >> (8 * i)));
+    }
+}
+
+void AppendBE32(Bytes* out, uint32_t value) {
+    for (int i = 3; i >= 0; --i) {
+        out->push_back(uint8_t(value >> (8 * i)));
+    }
+}
+
+void AppendFloat(Bytes* out, float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    AppendLE32(out, bits);
+}
+
+void AppendString(Bytes* out, const char* str) {
+    out->insert(out->end(), str, str + std::strlen(str) + 1);
+}
+
+bool WriteFile(std::string const& filePath, Bytes const& bytes) {
+    std::ofstream file(filePath, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+    if (!file) {
+        TF_RUNTIME_ERROR("Failed to write image to \"%s\"", filePath.c_str());
+        return false;
+    }
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// 8-bit formats
+//----------------------------------------------------------------------------
+
+int Get8BitChannelCount(SourceImage const& image) {
+    return image.componentCount == 2 ? 3 : image.componentCount;
+}
+
+// Quantizes \p image to Get8BitChannelCount() channels of 8 bits. Rows are
+// written top to bottom if \p topDown, color channels swapped to BGR if
+// \p bgr.
+Bytes QuantizeTo8Bit(SourceImage const& image, bool topDown, bool bgr) {
+    int channelCount = Get8BitChannelCount(image);
+    bool encodeSRGB = image.componentFormat != HdFormatUNorm8 && image.componentCount >= 3;
+    size_t rowSize = size_t(image.width) * channelCount;
+
+    Bytes out(rowSize * image.height);
+    WorkParallelForN(size_t(image.height), [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; ++row) {
+            int y = topDown ? image.height - 1 - int(row) : int(row);
+            uint8_t* dst = out.data() + row * rowSize;
+            for (int x = 0; x < image.width; ++x, dst += channelCount) {
+                for (int c = 0; c < channelCount; ++c) {
+                    float value = 0.0f;
+                    if (c < image.componentCount) {
+                        value = ReadComponent(image.GetComponent(x, y, c), image.componentFormat);
+                        if (encodeSRGB && c < 3) {
+                            value = LinearToSRGB(value);
+                        }
+                    }
+                    int dstChannel = bgr && c < 3 && channelCount >= 3 ? 2 - c : c;
+                    dst[dstChannel] = value > 0.0f ? uint8_t(std::min(value, 1.0f) * 255.0f + 0.5f) : 0;
+                }
+            }
+        }
+    });
+    return out;
+}
+
+uint32_t Crc32(uint8_t const* data, size_t size) {
+    static const auto table = []() {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    uint32_t crc = 0xffffffffu;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffffu;
+}
+
+uint32_t Adler32(uint8_t const* data, size_t size) {
+    // Largest run of bytes whose sums can't overflow before the modulo
+    const size_t kMaxRun = 5552;
+
+    uint32_t a = 1;
+    uint32_t b = 0;
+    while (size > 0) {
+        size_t run = std::min(size, kMaxRun);
+        for (size_t i = 0; i < run; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += run;
+        size -= run;
+    }
+    return (b << 16) | a;
+}
+
+void AppendPngChunk(Bytes* out, const char* type, Bytes const& data) {
+    AppendBE32(out, uint32_t(data.size()));
+    size_t start = out->size();
+    out->insert(out->end(), type, type + 4);
+    out->insert(out->end(), data.begin(), data.end());
+    AppendBE32(out, Crc32(out->data() + start, out->size() - start));
+}
+
+// The image data is stored in uncompressed deflate blocks, which needs no
+// zlib. Files are larger than compressed ones but write much faster.
+bool WritePng(std::string const& filePath, SourceImage const& image) {
+    int channelCount = Get8BitChannelCount(image);
+    Bytes pixels = QuantizeTo8Bit(image, /* topDown = */ true, /* bgr = */ false);
+
+    // Every row starts with filter type None
+    size_t rowSize = size_t(image.width) * channelCount;
+    Bytes raw;
+    raw.reserve((rowSize + 1) * image.height);
+    for (int y = 0; y < image.height; ++y) {
+        raw.push_back(0);
+        raw.insert(raw.end(), pixels.begin() + y * rowSize, pixels.begin() + (y + 1) * rowSize);
+    }
+
+    // zlib stream of stored blocks
+    const size_t kMaxBlockSize = 65535;
+    Bytes idat = {0x78, 0x01};
+    idat.reserve(raw.size() + raw.size() / kMaxBlockSize * 5 + 16);
+    size_t offset = 0;
+    do {
+        size_t blockSize = std::min(raw.size() - offset, kMaxBlockSize);
+        idat.push_back(offset + blockSize == raw.size() ? 1 : 0);
+        AppendLE16(&idat, uint16_t(blockSize));
+        AppendLE16(&idat, uint16_t(~blockSize));
+        idat.insert(idat.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+        offset += blockSize;
+    } while (offset < raw.size());
+    AppendBE32(&idat, Adler32(raw.data(), raw.size()));
+
+    static const uint8_t kColorTypes[] = {0, 0, 0, 2, 6};
+    Bytes ihdr;
+    AppendBE32(&ihdr, uint32_t(image.width));
+    AppendBE32(&ihdr, uint32_t(image.height));
+    ihdr.push_back(8);
+    ihdr.push_back(kColorTypes[channelCount]);
+    ihdr.push_back(0); // deflate
+    ihdr.push_back(0); // adaptive filtering
+    ihdr.push_back(0); // no interlace
+
+    Bytes out = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    AppendPngChunk(&out, "IHDR", ihdr);
+    AppendPngChunk(&out, "IDAT", idat);
+    AppendPngChunk(&out, "IEND", Bytes());
+    return WriteFile(filePath, out);
+}
+
+bool WriteTga(std::string const& filePath, SourceImage const& image) {
+    if (image.width > 0xffff || image.height > 0xffff) {
+        TF_RUNTIME_ERROR("Image of %dx%d is too large for TGA", image.width, image.height);
+        return false;
+    }
+
+    int channelCount = Get8BitChannelCount(image);
+
+    // Bottom to top is the default TGA row order
+    Bytes pixels = QuantizeTo8Bit(image, /* topDown = */ false, /* bgr = */ true);
+
+    Bytes out;
+    out.reserve(18 + pixels.size());
+    out.push_back(0); // no image ID
+    out.push_back(0); // no color map
+    out.push_back(channelCount == 1 ? 3 : 2); // uncompressed grayscale or true-color
+    out.insert(out.end(), 5, 0); // color map specification
+    AppendLE16(&out, 0); // x origin
+    AppendLE16(&out, 0); // y origin
+    AppendLE16(&out, uint16_t(image.width));
+    AppendLE16(&out, uint16_t(image.height));
+    out.push_back(uint8_t(channelCount * 8));
+    out.push_back(channelCount == 4 ? 8 : 0); // alpha bits, lower left origin
+    out.insert(out.end(), pixels.begin(), pixels.end());
+    return WriteFile(filePath, out);
+}
+
+//----------------------------------------------------------------------------
+// OpenEXR
+//----------------------------------------------------------------------------
+
+enum ExrPixelType {
+    ExrUInt = 0,
+    ExrHalf = 1,
+    ExrFloat = 2
+};
+
+void AppendExrAttribute(Bytes* out, const char* name, const char* type, Bytes const& value) {
+    AppendString(out, name);
+    AppendString(out, type);
+    AppendLE32(out, uint32_t(value.size()));
+    out->insert(out->end(), value.begin(), value.end());
+}
+
+ExrPixelType GetExrPixelType(HdFormat componentFormat) {
+    return componentFormat == HdFormatFloat32 ? ExrFloat :
+           componentFormat == HdFormatInt32 ? ExrUInt : ExrHalf;
+}
+
+size_t GetExrPixelTypeSize(ExrPixelType pixelType) {
+    return pixelType == ExrHalf ? 2 : 4;
+}
+
+// Channel names and the components they are read from, sorted by name as
+// channels have to be stored
+std::vector<std::pair<std::string, int>> GetExrChannels(int componentCount) {
+    static const char* const kChannelNames[][4] = {
+        {"Y"}, {"R", "G"}, {"R", "G", "B"}, {"R", "G", "B", "A"}
+    };
+    std::vector<std::pair<std::string, int>> channels;
+    for (int c = 0; c < componentCount; ++c) {
+        channels.emplace_back(kChannelNames[componentCount - 1][c], c);
+    }
+    std::sort(channels.begin(), channels.end());
+    return channels;
+}
+
+// Header of a single-part file without compression, tiled if \p tileSize
+// isn't zero
+Bytes MakeExrHeader(
+    std::vector<std::pair<std::string, int>> const& channels,
+    ExrPixelType pixelType,
+    int width,
+    int height,
+    int tileSize) {
+    Bytes chlist;
+    for (auto const& channel : channels) {
+        AppendString(&chlist, channel.first.c_str());
+        AppendLE32(&chlist, uint32_t(pixelType));
+        chlist.insert(chlist.end(), 4, 0); // pLinear and reserved
+        AppendLE32(&chlist, 1); // x sampling
+        AppendLE32(&chlist, 1); // y sampling
+    }
+    chlist.push_back(0);
+
+    Bytes window;
+    AppendLE32(&window, 0);
+    AppendLE32(&window, 0);
+    AppendLE32(&window, uint32_t(width - 1));
+    AppendLE32(&window, uint32_t(height - 1));
+
+    Bytes one;
+    AppendFloat(&one, 1.0f);
+    Bytes origin;
+    AppendFloat(&origin, 0.0f);
+    AppendFloat(&origin, 0.0f);
+
+    Bytes out = {0x76, 0x2f, 0x31, 0x01};
+    // Version 2, the single tile flag marks single-part tiled files
+    AppendLE32(&out, tileSize > 0 ? 2 | 0x200 : 2);
+    AppendExrAttribute(&out, "channels", "chlist", chlist);
+    AppendExrAttribute(&out, "compression", "compression", Bytes{0});
+    AppendExrAttribute(&out, "dataWindow", "box2i", window);
+    AppendExrAttribute(&out, "displayWindow", "box2i", window);
+    // Tiles may be stored in any order, scanlines top to bottom
+    AppendExrAttribute(&out, "lineOrder", "lineOrder", Bytes{uint8_t(tileSize > 0 ? 2 : 0)});
+    AppendExrAttribute(&out, "pixelAspectRatio", "float", one);
+    AppendExrAttribute(&out, "screenWindowCenter", "v2f", origin);
+    AppendExrAttribute(&out, "screenWindowWidth", "float", one);
+    if (tileSize > 0) {
+        Bytes tiles;
+        AppendLE32(&tiles, uint32_t(tileSize));
+        AppendLE32(&tiles, uint32_t(tileSize));
+        tiles.push_back(0); // one level, rounded down
+        AppendExrAttribute(&out, "tiles", "tiledesc", tiles);
+    }
+    out.push_back(0);
+    return out;
+}
+
+// Appends \p width pixels of row \p y of \p image starting at \p x, all
+// pixels of one channel after another
+void AppendExrPixels(
+    Bytes* out,
+    SourceImage const& image,
+    int x,
+    int y,
+    int width,
+    std::vector<std::pair<std::string, int>> const& channels,
+    ExrPixelType pixelType) {
+    for (auto const& channel : channels) {
+        for (int i = x; i < x + width; ++i) {
+            uint8_t const* src = image.GetComponent(i, y, channel.second);
+            if (pixelType == ExrUInt) {
+                uint32_t value;
+                std::memcpy(&value, src, sizeof(value));
+                AppendLE32(out, value);
+            } else if (pixelType == ExrFloat) {
+                AppendFloat(out, ReadComponent(src, image.componentFormat));
+            } else {
+                AppendLE16(out, GfHalf(ReadComponent(src, image.componentFormat)).bits());
+            }
+        }
+    }
+}
+
+// Single-part scanline file without compression
+bool WriteExr(std::string const& filePath, SourceImage const& image) {
+    ExrPixelType pixelType = GetExrPixelType(image.componentFormat);
+    auto channels = GetExrChannels(image.componentCount);
+    Bytes out = MakeExrHeader(channels, pixelType, image.width, image.height, 0);
+
+    // Each scanline is a chunk of its y, its data size, then all pixels of
+    // one channel after another. EXR rows go top to bottom.
+    size_t lineDataSize = size_t(image.width) * channels.size() * GetExrPixelTypeSize(pixelType);
+    size_t chunkSize = 8 + lineDataSize;
+    size_t offsetTableStart = out.size();
+    size_t chunksStart = offsetTableStart + 8 * size_t(image.height);
+    for (int y = 0; y < image.height; ++y) {
+        AppendLE64(&out, uint64_t(chunksStart + y * chunkSize));
+    }
+
+    out.resize(chunksStart + chunkSize * image.height);
+    WorkParallelForN(size_t(image.height), [&](size_t begin, size_t end) {
+        Bytes line;
+        line.reserve(chunkSize);
+        for (size_t y = begin; y < end; ++y) {
+            line.clear();
+            AppendLE32(&line, uint32_t(y));
+            AppendLE32(&line, uint32_t(lineDataSize));
+            AppendExrPixels(&line, image, 0, image.height - 1 - int(y), image.width, channels, pixelType);
+            std::memcpy(out.data() + chunksStart + y * chunkSize, line.data(), chunkSize);
+        }
+    });
+
+    return WriteFile(filePath, out);
+}
+
+SourceImage MakeSourceImage(void const* data, int width, int height, HdFormat format) {
+    SourceImage image;
+    image.data = static_cast<uint8_t const*>(data);
+    image.width = width;
+    image.height = height;
+    image.componentFormat = HdGetComponentFormat(format);
+    image.componentSize = HdDataSizeOfFormat(image.componentFormat);
+    image.componentCount = int(HdGetComponentCount(format));
+    return image;
+}
+
+} // namespace anonymous
+
+bool HdRprWriteImage(
+    std::string const& filePath,
+    void const* data,
+    int width,
+    int height,
+    HdFormat format) {
+    if (!data || width <= 0 || height <= 0 || format == HdFormatInvalid) {
+        TF_CODING_ERROR("No image data to write to \"%s\"", filePath.c_str());
+        return false;
+    }
+
+    SourceImage image = MakeSourceImage(data, width, height, format);
+
+    std::string extension = TfStringToLower(TfStringGetSuffix(filePath));
+    if (extension == "exr") {
+        return WriteExr(filePath, image);
+    }
+
+    if (image.componentFormat == HdFormatInt32) {
+        TF_RUNTIME_ERROR("Integer images can only be written as EXR, not to \"%s\"", filePath.c_str());
+        return false;
+    }
+
+    if (extension == "png") {
+        return WritePng(filePath, image);
+    } else if (extension == "tga") {
+        return WriteTga(filePath, image);
+    }
+
+    TF_RUNTIME_ERROR("Unsupported image file format \"%s\"", filePath.c_str());
+    return false;
+}
+
+bool HdRprWriteImage(std::string const& filePath, HdRenderBuffer* buffer) {
+    if (!buffer) {
+        TF_CODING_ERROR("No render buffer to write to \"%s\"", filePath.c_str());
+        return false;
+    }
+
+    buffer->Resolve();
+    void const* data = buffer->Map();
+    bool written = HdRprWriteImage(filePath, data, int(buffer->GetWidth()), int(buffer->GetHeight()), buffer->GetFormat());
+    buffer->Unmap();
+    return written;
+}
+
+bool HdRprWriteImage(std::string const& filePath, HdRprAovImage const& image) {
+    return HdRprWriteImage(filePath, image.GetData(), image.GetWidth(), image.GetHeight(), image.GetFormat());
+}
+
+HdRprTiledExrWriter::HdRprTiledExrWriter()
+    : m_width(0)
+    , m_height(0)
+    , m_format(HdFormatInvalid)
+    , m_tileSize(0)
+    , m_tileCount(0)
+    , m_offsetTableStart(0) {
+
+}
+
+HdRprTiledExrWriter::~HdRprTiledExrWriter() {
+    if (m_file.is_open()) {
+        Close();
+    }
+}
+
+bool HdRprTiledExrWriter::Open(
+    std::string const& filePath,
+    int width,
+    int height,
+    HdFormat format,
+    int tileSize) {
+    if (m_file.is_open()) {
+        Close();
+    }
+    if (width <= 0 || height <= 0 || tileSize <= 0 || format == HdFormatInvalid) {
+        TF_CODING_ERROR("Invalid tiled image to write to \"%s\"", filePath.c_str());
+        return false;
+    }
+
+    m_filePath = filePath;
+    m_width = width;
+    m_height = height;
+    m_format = format;
+    m_tileSize = tileSize;
+    m_tileCount = GfVec2i((width + tileSize - 1) / tileSize, (height + tileSize - 1) / tileSize);
+    m_offsets.assign(size_t(m_tileCount[0]) * m_tileCount[1], 0);
+
+    m_file.open(filePath, std::ios::binary | std::ios::trunc);
+    if (!m_file) {
+        TF_RUNTIME_ERROR("Failed to open \"%s\" for writing", filePath.c_str());
+        return false;
+    }
+
+    // The offset table is filled in by Close()
+    Bytes header = MakeExrHeader(GetExrChannels(int(HdGetComponentCount(format))),
+                                 GetExrPixelType(HdGetComponentFormat(format)), width, height, tileSize);
+    m_offsetTableStart = header.size();
+    header.resize(header.size() + m_offsets.size() * 8, 0);
+    m_file.write(reinterpret_cast<const char*>(header.data()), std::streamsize(header.size()));
+    return bool(m_file);
+}
+
+bool HdRprTiledExrWriter::WriteTile(int tileX, int tileY, void const* data, int dataWidth, int dataHeight) {
+    if (!m_file.is_open() || tileX < 0 || tileX >= m_tileCount[0] || tileY < 0 || tileY >= m_tileCount[1]) {
+        TF_CODING_ERROR("Invalid tile (%d, %d) for \"%s\"", tileX, tileY, m_filePath.c_str());
+        return false;
+    }
+
+    int width = std::min(m_tileSize, m_width - tileX * m_tileSize);
+    int height = std::min(m_tileSize, m_height - tileY * m_tileSize);
+    if (!data || dataWidth < width || dataHeight < height) {
+        TF_CODING_ERROR("Not enough data for tile (%d, %d) of \"%s\"", tileX, tileY, m_filePath.c_str());
+        return false;
+    }
+
+    SourceImage image = MakeSourceImage(data, dataWidth, dataHeight, m_format);
+    ExrPixelType pixelType = GetExrPixelType(image.componentFormat);
+    auto channels = GetExrChannels(image.componentCount);
+    size_t dataSize = size_t(width) * height * channels.size() * GetExrPixelTypeSize(pixelType);
+
+    // Tile coordinates and level, data size, then the rows of the tile top
+    // to bottom
+    Bytes chunk;
+    chunk.reserve(20 + dataSize);
+    AppendLE32(&chunk, uint32_t(tileX));
+    AppendLE32(&chunk, uint32_t(tileY));
+    AppendLE32(&chunk, 0);
+    AppendLE32(&chunk, 0);
+    AppendLE32(&chunk, uint32_t(dataSize));
+    for (int y = 0; y < height; ++y) {
+        AppendExrPixels(&chunk, image, 0, dataHeight - 1 - y, width, channels, pixelType);
+    }
+
+    m_file.seekp(0, std::ios::end);
+    m_offsets[size_t(tileY) * m_tileCount[0] + tileX] = uint64_t(m_file.tellp());
+    m_file.write(reinterpret_cast<const char*>(chunk.data()), std::streamsize(chunk.size()));
+    if (!m_file) {
+        TF_RUNTIME_ERROR("Failed to write tile (%d, %d) to \"%s\"", tileX, tileY, m_filePath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool HdRprTiledExrWriter::Close() {
+    if (!m_file.is_open()) {
+        return false;
+    }
+
+    bool isComplete = std::find(m_offsets.begin(), m_offsets.end(), uint64_t(0)) == m_offsets.end();
+
+    Bytes table;
+    table.reserve(m_offsets.size() * 8);
+    for (uint64_t offset : m_offsets) {
+        AppendLE64(&table, offset);
+    }
+    m_file.seekp(std::streamoff(m_offsetTableStart));
+    m_file.write(reinterpret_cast<const char*>(table.data()), std::streamsize(table.size()));
+    bool written = bool(m_file);
+    m_file.close();
+
+    if (!written) {
+        TF_RUNTIME_ERROR("Failed to write image to \"%s\"", m_filePath.c_str());
+    } else if (!isComplete) {
+        TF_WARN("Tiles are missing from \"%s\"", m_filePath.c_str());
+    }
+    m_offsets.clear();
+    return written && isComplete;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
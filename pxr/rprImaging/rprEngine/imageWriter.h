@@ -0,0 +1,97 @@
+#ifndef HDRPR_IMAGE_WRITER_H
+#define HDRPR_IMAGE_WRITER_H
+
+#include "api.h"
+
+#include "pxr/imaging/hd/renderBuffer.h"
+#include "pxr/imaging/hd/types.h"
+#include "pxr/base/gf/vec2i.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+class HdRprAovImage;
+
+// Image files are written without Glf, GL or image plugins so that the
+// engine can save its output on machines without a graphics stack. The
+// file format follows the extension of the path:
+//  - .exr is uncompressed, with half, float or uint channels as in the
+//    source, 8-bit sources are widened to half;
+//  - .png and .tga have 8 bits per channel, the color channels of float
+//    sources are encoded to sRGB.
+// Two channel sources are written as RGB with an empty blue channel to the
+// 8-bit formats. Integer sources can only be written as EXR.
+
+/// Writes \p width x \p height pixels of \p format from \p data, with rows
+/// stored bottom to top, to \p filePath. Returns false on failure.
+HDRPR_API
+bool HdRprWriteImage(std::string const& filePath,
+                     void const* data,
+                     int width,
+                     int height,
+                     HdFormat format);
+
+/// Resolves \p buffer and writes its content to \p filePath.
+HDRPR_API
+bool HdRprWriteImage(std::string const& filePath, HdRenderBuffer* buffer);
+
+/// Writes \p image to \p filePath.
+HDRPR_API
+bool HdRprWriteImage(std::string const& filePath, HdRprAovImage const& image);
+
+/// \class HdRprTiledExrWriter
+///
+/// Writes an uncompressed tiled EXR file tile by tile, in any order, so that
+/// images larger than memory can be saved while they are rendered. Only the
+/// offset table of the file, one entry per tile, is kept in memory.
+///
+class HdRprTiledExrWriter {
+public:
+    HDRPR_API
+    HdRprTiledExrWriter();
+
+    /// Closes the file if it is still open.
+    HDRPR_API
+    ~HdRprTiledExrWriter();
+
+    /// Creates \p filePath for an image of \p width x \p height pixels of
+    /// \p format, split into tiles of \p tileSize x \p tileSize pixels.
+    HDRPR_API
+    bool Open(std::string const& filePath, int width, int height, HdFormat format, int tileSize);
+
+    /// Writes tile (\p tileX, \p tileY), counted from the top left corner
+    /// of the image. \p data holds \p dataWidth x \p dataHeight pixels of
+    /// the format given to Open(), rows stored bottom to top, with its top
+    /// left pixel at the top left corner of the tile. Pixels outside of the
+    /// image are skipped.
+    HDRPR_API
+    bool WriteTile(int tileX, int tileY, void const* data, int dataWidth, int dataHeight);
+
+    /// Completes the file. Returns false if writing failed or tiles are
+    /// missing, which readers fail on.
+    HDRPR_API
+    bool Close();
+
+    bool IsOpen() const { return m_file.is_open(); }
+
+    GfVec2i const& GetTileCount() const { return m_tileCount; }
+
+private:
+    std::string m_filePath;
+    std::ofstream m_file;
+    int m_width;
+    int m_height;
+    HdFormat m_format;
+    int m_tileSize;
+    GfVec2i m_tileCount;
+    uint64_t m_offsetTableStart;
+    // File offset of each tile, zero for the ones not written yet
+    std::vector<uint64_t> m_offsets;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_IMAGE_WRITER_H
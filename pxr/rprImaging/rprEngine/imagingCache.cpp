@@ -0,0 +1,1146 @@
+#include "pxr/rprImaging/rprEngine/imagingCache.h"
+
+#include "pxr/imaging/hd/tokens.h"
+#include "pxr/usd/usd/primRange.h"
+#include "pxr/usd/usd/stage.h"
+#include "pxr/usd/usdGeom/mesh.h"
+#include "pxr/usd/usdGeom/pointInstancer.h"
+#include "pxr/usd/usdGeom/primvarsAPI.h"
+#include "pxr/usd/usdGeom/tokens.h"
+#include "pxr/usd/usdGeom/xformCache.h"
+#include "pxr/usd/usdShade/connectableAPI.h"
+#include "pxr/usd/usdShade/material.h"
+#include "pxr/usd/usdShade/materialBindingAPI.h"
+#include "pxr/usd/usdShade/shader.h"
+#include "pxr/usd/usdShade/tokens.h"
+#include "pxr/usd/sdf/assetPath.h"
+#include "pxr/usd/sdf/types.h"
+#include "pxr/base/gf/matrix4d.h"
+#include "pxr/base/gf/range3f.h"
+#include "pxr/base/gf/vec2d.h"
+#include "pxr/base/gf/vec2f.h"
+#include "pxr/base/gf/vec2i.h"
+#include "pxr/base/gf/vec3d.h"
+#include "pxr/base/gf/vec3i.h"
+#include "pxr/base/gf/vec4d.h"
+#include "pxr/base/gf/vec4f.h"
+#include "pxr/base/gf/vec4i.h"
+#include "pxr/base/tf/diagnostic.h"
+#include "pxr/base/tf/stringUtils.h"
+#include "pxr/base/work/loops.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <set>
+#include <type_traits>
+#include <unordered_set>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+
+// All sections and arrays start at multiples of this
+const uint64_t kAlignment = 16;
+
+const char kMagic[8] = {'H', 'D', 'R', 'P', 'R', 'I', 'C', '\0'};
+
+// Written in native byte order, a reader with another one sees it swapped
+const uint32_t kByteOrderMark = 0x01020304;
+
+const uint64_t kNoString = ~uint64_t(0);
+
+enum MeshFlags : uint32_t {
+    MeshFlagDoubleSided = 1 << 0,
+    MeshFlagLeftHanded = 1 << 1,
+};
+
+// Element types of baked primvars
+enum ValueType : uint32_t {
+    ValueTypeInt,
+    ValueTypeVec2i,
+    ValueTypeVec3i,
+    ValueTypeVec4i,
+    ValueTypeFloat,
+    ValueTypeVec2f,
+    ValueTypeVec3f,
+    ValueTypeVec4f,
+    ValueTypeDouble,
+    ValueTypeVec2d,
+    ValueTypeVec3d,
+    ValueTypeVec4d,
+    ValueTypeMatrix4d,
+    ValueTypeCount
+};
+
+// Types of baked material parameters besides the primvar types
+enum ParameterType : uint32_t {
+    ParameterTypeBool = ValueTypeCount,
+    ParameterTypeToken,
+    ParameterTypeString,
+    ParameterTypeAssetPath,
+};
+
+// Most connections followed through node graphs and interface inputs to
+// reach a shader output or a value, guards against connection cycles
+const int kMaxConnectionDepth = 64;
+
+const uint64_t kValueSizes[ValueTypeCount] = {
+    sizeof(int), sizeof(GfVec2i), sizeof(GfVec3i), sizeof(GfVec4i),
+    sizeof(float), sizeof(GfVec2f), sizeof(GfVec3f), sizeof(GfVec4f),
+    sizeof(double), sizeof(GfVec2d), sizeof(GfVec3d), sizeof(GfVec4d),
+    sizeof(GfMatrix4d),
+};
+
+// File layout:
+//   FileHeader
+//   FileMesh[meshCount]
+//   FilePrimvar[primvarCount], mesh by mesh
+//   GfMatrix4d[frameCount * meshCount], frame by frame
+//   strings, null-terminated
+//   materials, serialized with StreamWriter
+//   array data
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrderMark;
+    uint64_t meshCount;
+    uint64_t frameCount;
+    double startFrame;
+    double frameStep;
+    uint64_t meshesOffset;
+    uint64_t primvarCount;
+    uint64_t primvarsOffset;
+    uint64_t transformsOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+    uint64_t materialsOffset;
+    uint64_t materialsSize;
+};
+
+struct FileMesh {
+    uint64_t pathOffset;
+    uint64_t materialPathOffset;
+    uint64_t subdivisionSchemeOffset;
+    uint64_t pointsOffset;
+    uint64_t pointCount;
+    uint64_t pointFrameCount;
+    uint64_t faceVertexCountsOffset;
+    uint64_t faceCount;
+    uint64_t faceVertexIndicesOffset;
+    uint64_t indexCount;
+    uint64_t firstPrimvar;
+    uint64_t primvarCount;
+    float extentMin[3];
+    float extentMax[3];
+    uint32_t flags;
+};
+
+struct FilePrimvar {
+    uint64_t nameOffset;
+    uint64_t roleOffset;
+    uint64_t dataOffset;
+    uint64_t elementCount;
+    uint32_t interpolation;
+    uint32_t valueType;
+    uint32_t isArray;
+    uint32_t padding;
+};
+
+uint64_t Align(uint64_t offset) {
+    return (offset + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+class Blob {
+public:
+    template <typename T>
+    uint64_t Append(T const* data, size_t count) {
+        uint64_t offset = Align(m_data.size());
+        m_data.resize(offset + count * sizeof(T));
+        if (count) {
+            std::memcpy(&m_data[offset], data, count * sizeof(T));
+        }
+        return offset;
+    }
+
+    uint64_t AppendString(std::string const& str) {
+        auto it = m_strings.find(str);
+        if (it != m_strings.end()) {
+            return it->second;
+        }
+
+        uint64_t offset = m_data.size();
+        m_data.insert(m_data.end(), str.c_str(), str.c_str() + str.size() + 1);
+        m_strings.emplace(str, offset);
+        return offset;
+    }
+
+    std::vector<char> const& GetData() const { return m_data; }
+
+private:
+    std::vector<char> m_data;
+    std::map<std::string, uint64_t> m_strings;
+};
+
+struct BakedPrimvar {
+    FilePrimvar header = {};
+    TfToken name;
+    TfToken role;
+    std::vector<char> data;
+};
+
+struct BakedMesh {
+    UsdGeomMesh mesh;
+    FileMesh header = {};
+    VtIntArray faceVertexCounts;
+    VtIntArray faceVertexIndices;
+    std::vector<VtVec3fArray> points;
+    std::vector<BakedPrimvar> primvars;
+    SdfPath materialPath;
+    TfToken subdivisionScheme;
+};
+
+template <typename T>
+bool GetPrimvarData(VtValue const& value, ValueType valueType, BakedPrimvar* baked) {
+    char const* bytes;
+    size_t count;
+    if (value.IsHolding<VtArray<T>>()) {
+        VtArray<T> const& array = value.UncheckedGet<VtArray<T>>();
+        bytes = reinterpret_cast<char const*>(array.cdata());
+        count = array.size();
+        baked->header.isArray = 1;
+    } else if (value.IsHolding<T>()) {
+        bytes = reinterpret_cast<char const*>(&value.UncheckedGet<T>());
+        count = 1;
+        baked->header.isArray = 0;
+    } else {
+        return false;
+    }
+
+    baked->data.assign(bytes, bytes + count * sizeof(T));
+    baked->header.elementCount = count;
+    baked->header.valueType = valueType;
+    return true;
+}
+
+bool GetPrimvarData(VtValue const& value, BakedPrimvar* baked) {
+    return GetPrimvarData<int>(value, ValueTypeInt, baked) ||
+        GetPrimvarData<GfVec2i>(value, ValueTypeVec2i, baked) ||
+        GetPrimvarData<GfVec3i>(value, ValueTypeVec3i, baked) ||
+        GetPrimvarData<GfVec4i>(value, ValueTypeVec4i, baked) ||
+        GetPrimvarData<float>(value, ValueTypeFloat, baked) ||
+        GetPrimvarData<GfVec2f>(value, ValueTypeVec2f, baked) ||
+        GetPrimvarData<GfVec3f>(value, ValueTypeVec3f, baked) ||
+        GetPrimvarData<GfVec4f>(value, ValueTypeVec4f, baked) ||
+        GetPrimvarData<double>(value, ValueTypeDouble, baked) ||
+        GetPrimvarData<GfVec2d>(value, ValueTypeVec2d, baked) ||
+        GetPrimvarData<GfVec3d>(value, ValueTypeVec3d, baked) ||
+        GetPrimvarData<GfVec4d>(value, ValueTypeVec4d, baked) ||
+        GetPrimvarData<GfMatrix4d>(value, ValueTypeMatrix4d, baked);
+}
+
+bool GetInterpolation(TfToken const& token, HdInterpolation* interpolation) {
+    if (token == UsdGeomTokens->constant) {
+        *interpolation = HdInterpolationConstant;
+    } else if (token == UsdGeomTokens->uniform) {
+        *interpolation = HdInterpolationUniform;
+    } else if (token == UsdGeomTokens->varying) {
+        *interpolation = HdInterpolationVarying;
+    } else if (token == UsdGeomTokens->vertex) {
+        *interpolation = HdInterpolationVertex;
+    } else if (token == UsdGeomTokens->faceVarying) {
+        *interpolation = HdInterpolationFaceVarying;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+TfToken GetPrimvarRole(TfToken const& typeRole) {
+    if (typeRole == SdfValueRoleNames->Color) {
+        return HdPrimvarRoleTokens->color;
+    } else if (typeRole == SdfValueRoleNames->Point) {
+        return HdPrimvarRoleTokens->point;
+    } else if (typeRole == SdfValueRoleNames->Normal) {
+        return HdPrimvarRoleTokens->normal;
+    } else if (typeRole == SdfValueRoleNames->Vector) {
+        return HdPrimvarRoleTokens->vector;
+    } else if (typeRole == SdfValueRoleNames->TextureCoordinate) {
+        return HdPrimvarRoleTokens->textureCoordinate;
+    }
+    return HdPrimvarRoleTokens->none;
+}
+
+void ReadPrimvars(BakedMesh* baked, UsdTimeCode startFrame) {
+    UsdGeomMesh const& mesh = baked->mesh;
+
+    bool hasNormals = false;
+    for (UsdGeomPrimvar const& primvar : UsdGeomPrimvarsAPI(mesh.GetPrim()).FindPrimvarsWithInheritance()) {
+        BakedPrimvar bakedPrimvar;
+        HdInterpolation interpolation;
+        VtValue value;
+        if (!GetInterpolation(primvar.GetInterpolation(), &interpolation) ||
+            !primvar.ComputeFlattened(&value, startFrame) ||
+            !GetPrimvarData(value, &bakedPrimvar)) {
+            continue;
+        }
+
+        bakedPrimvar.name = primvar.GetPrimvarName();
+        bakedPrimvar.role = GetPrimvarRole(primvar.GetTypeName().GetRole());
+        bakedPrimvar.header.interpolation = interpolation;
+        hasNormals = hasNormals || bakedPrimvar.name == HdTokens->normals;
+        baked->primvars.push_back(std::move(bakedPrimvar));
+    }
+
+    // Like UsdImaging, serve the normals attribute as the normals primvar
+    // unless there is a primvar of that name
+    if (!hasNormals) {
+        BakedPrimvar bakedPrimvar;
+        HdInterpolation interpolation;
+        VtValue value;
+        if (GetInterpolation(mesh.GetNormalsInterpolation(), &interpolation) &&
+            mesh.GetNormalsAttr().Get(&value, startFrame) &&
+            GetPrimvarData(value, &bakedPrimvar)) {
+            bakedPrimvar.name = HdTokens->normals;
+            bakedPrimvar.role = HdPrimvarRoleTokens->normal;
+            bakedPrimvar.header.interpolation = interpolation;
+            baked->primvars.push_back(std::move(bakedPrimvar));
+        }
+    }
+}
+
+void ReadMesh(BakedMesh* baked, std::vector<UsdTimeCode> const& frames) {
+    UsdGeomMesh const& mesh = baked->mesh;
+    UsdTimeCode startFrame = frames.front();
+    FileMesh& header = baked->header;
+
+    mesh.GetFaceVertexCountsAttr().Get(&baked->faceVertexCounts, startFrame);
+    mesh.GetFaceVertexIndicesAttr().Get(&baked->faceVertexIndices, startFrame);
+    mesh.GetSubdivisionSchemeAttr().Get(&baked->subdivisionScheme, startFrame);
+
+    TfToken orientation;
+    mesh.GetOrientationAttr().Get(&orientation, startFrame);
+    bool doubleSided = false;
+    mesh.GetDoubleSidedAttr().Get(&doubleSided, startFrame);
+
+    header.flags = 0;
+    if (doubleSided) {
+        header.flags |= MeshFlagDoubleSided;
+    }
+    if (orientation == UsdGeomTokens->leftHanded) {
+        header.flags |= MeshFlagLeftHanded;
+    }
+
+    ReadPrimvars(baked, startFrame);
+
+    baked->materialPath = UsdShadeMaterialBindingAPI(mesh.GetPrim()).ComputeBoundMaterial().GetPath();
+
+    // Points are baked for every frame only if they are animated and keep
+    // their count
+    UsdAttribute pointsAttr = mesh.GetPointsAttr();
+    baked->points.emplace_back();
+    pointsAttr.Get(&baked->points.back(), startFrame);
+    if (pointsAttr.ValueMightBeTimeVarying() && frames.size() > 1) {
+        for (size_t i = 1; i < frames.size(); ++i) {
+            baked->points.emplace_back();
+            pointsAttr.Get(&baked->points.back(), frames[i]);
+            if (baked->points.back().size() != baked->points.front().size()) {
+                baked->points.resize(1);
+                break;
+            }
+        }
+    }
+
+    GfRange3f extent;
+    for (auto const& points : baked->points) {
+        for (auto const& point : points) {
+            extent.UnionWith(point);
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        header.extentMin[i] = extent.GetMin()[i];
+        header.extentMax[i] = extent.GetMax()[i];
+    }
+}
+
+// Byte stream of the materials section. Material networks are small and
+// irregular, so they are serialized rather than laid out for mapping.
+class StreamWriter {
+public:
+    template <typename T>
+    void Write(T const& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values are written as bytes");
+        char const* bytes = reinterpret_cast<char const*>(&value);
+        m_data.insert(m_data.end(), bytes, bytes + sizeof(T));
+    }
+
+    void Write(std::string const& str) {
+        Write(uint64_t(str.size()));
+        m_data.insert(m_data.end(), str.begin(), str.end());
+    }
+
+    void Write(TfToken const& token) { Write(token.GetString()); }
+    void Write(SdfPath const& path) { Write(path.GetString()); }
+
+    void Write(StreamWriter const& other) {
+        m_data.insert(m_data.end(), other.m_data.begin(), other.m_data.end());
+    }
+
+    std::vector<char> const& GetData() const { return m_data; }
+
+private:
+    std::vector<char> m_data;
+};
+
+class StreamReader {
+public:
+    StreamReader(char const* data, uint64_t size)
+        : m_data(data), m_size(size), m_position(0) {}
+
+    template <typename T>
+    bool Read(T* value) {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values are read as bytes");
+        if (sizeof(T) > m_size - m_position) {
+            return false;
+        }
+        std::memcpy(value, m_data + m_position, sizeof(T));
+        m_position += sizeof(T);
+        return true;
+    }
+
+    bool Read(std::string* str) {
+        uint64_t size;
+        if (!Read(&size) || size > m_size - m_position) {
+            return false;
+        }
+        str->assign(m_data + m_position, size);
+        m_position += size;
+        return true;
+    }
+
+    bool Read(TfToken* token) {
+        std::string str;
+        if (!Read(&str)) {
+            return false;
+        }
+        *token = TfToken(str);
+        return true;
+    }
+
+    bool Read(SdfPath* path) {
+        std::string str;
+        if (!Read(&str)) {
+            return false;
+        }
+        *path = SdfPath(str);
+        return path->IsAbsolutePath();
+    }
+
+    // Reads the count of a list whose elements take at least \p minSize
+    // bytes each, rejecting counts the rest of the stream can't hold
+    bool ReadCount(uint64_t* count, uint64_t minSize) {
+        return Read(count) && *count <= (m_size - m_position) / minSize;
+    }
+
+    bool IsAtEnd() const { return m_position == m_size; }
+
+private:
+    char const* m_data;
+    uint64_t m_size;
+    uint64_t m_position;
+};
+
+template <typename T>
+bool WriteValue(VtValue const& value, uint32_t type, StreamWriter* stream) {
+    if (!value.IsHolding<T>()) {
+        return false;
+    }
+    stream->Write(type);
+    stream->Write(value.UncheckedGet<T>());
+    return true;
+}
+
+bool WriteParameter(VtValue const& value, StreamWriter* stream) {
+    if (value.IsHolding<bool>()) {
+        stream->Write(uint32_t(ParameterTypeBool));
+        stream->Write(uint8_t(value.UncheckedGet<bool>()));
+        return true;
+    } else if (value.IsHolding<SdfAssetPath>()) {
+        SdfAssetPath const& assetPath = value.UncheckedGet<SdfAssetPath>();
+        stream->Write(uint32_t(ParameterTypeAssetPath));
+        stream->Write(assetPath.GetAssetPath());
+        stream->Write(assetPath.GetResolvedPath());
+        return true;
+    }
+
+    return WriteValue<int>(value, ValueTypeInt, stream) ||
+        WriteValue<GfVec2i>(value, ValueTypeVec2i, stream) ||
+        WriteValue<GfVec3i>(value, ValueTypeVec3i, stream) ||
+        WriteValue<GfVec4i>(value, ValueTypeVec4i, stream) ||
+        WriteValue<float>(value, ValueTypeFloat, stream) ||
+        WriteValue<GfVec2f>(value, ValueTypeVec2f, stream) ||
+        WriteValue<GfVec3f>(value, ValueTypeVec3f, stream) ||
+        WriteValue<GfVec4f>(value, ValueTypeVec4f, stream) ||
+        WriteValue<double>(value, ValueTypeDouble, stream) ||
+        WriteValue<GfVec2d>(value, ValueTypeVec2d, stream) ||
+        WriteValue<GfVec3d>(value, ValueTypeVec3d, stream) ||
+        WriteValue<GfVec4d>(value, ValueTypeVec4d, stream) ||
+        WriteValue<GfMatrix4d>(value, ValueTypeMatrix4d, stream) ||
+        WriteValue<TfToken>(value, ParameterTypeToken, stream) ||
+        WriteValue<std::string>(value, ParameterTypeString, stream);
+}
+
+template <typename T>
+bool ReadValue(StreamReader* stream, VtValue* value) {
+    T typedValue;
+    if (!stream->Read(&typedValue)) {
+        return false;
+    }
+    *value = VtValue(std::move(typedValue));
+    return true;
+}
+
+bool ReadParameter(StreamReader* stream, VtValue* value) {
+    uint32_t type;
+    if (!stream->Read(&type)) {
+        return false;
+    }
+
+    switch (type) {
+        case ValueTypeInt: return ReadValue<int>(stream, value);
+        case ValueTypeVec2i: return ReadValue<GfVec2i>(stream, value);
+        case ValueTypeVec3i: return ReadValue<GfVec3i>(stream, value);
+        case ValueTypeVec4i: return ReadValue<GfVec4i>(stream, value);
+        case ValueTypeFloat: return ReadValue<float>(stream, value);
+        case ValueTypeVec2f: return ReadValue<GfVec2f>(stream, value);
+        case ValueTypeVec3f: return ReadValue<GfVec3f>(stream, value);
+        case ValueTypeVec4f: return ReadValue<GfVec4f>(stream, value);
+        case ValueTypeDouble: return ReadValue<double>(stream, value);
+        case ValueTypeVec2d: return ReadValue<GfVec2d>(stream, value);
+        case ValueTypeVec3d: return ReadValue<GfVec3d>(stream, value);
+        case ValueTypeVec4d: return ReadValue<GfVec4d>(stream, value);
+        case ValueTypeMatrix4d: return ReadValue<GfMatrix4d>(stream, value);
+        case ParameterTypeToken: return ReadValue<TfToken>(stream, value);
+        case ParameterTypeString: return ReadValue<std::string>(stream, value);
+        case ParameterTypeBool: {
+            uint8_t boolValue;
+            if (!stream->Read(&boolValue)) {
+                return false;
+            }
+            *value = VtValue(boolValue != 0);
+            return true;
+        }
+        case ParameterTypeAssetPath: {
+            std::string assetPath;
+            std::string resolvedPath;
+            if (!stream->Read(&assetPath) || !stream->Read(&resolvedPath)) {
+                return false;
+            }
+            *value = VtValue(SdfAssetPath(assetPath, resolvedPath));
+            return true;
+        }
+        default: return false;
+    }
+}
+
+// Follows the connections of \p attribute through node graph outputs and
+// interface inputs. Returns the shader output they end in in \p shader and
+// \p outputName, or else the attribute holding the value.
+UsdAttribute ResolveInput(UsdAttribute attribute, UsdShadeShader* shader, TfToken* outputName) {
+    for (int depth = 0; depth < kMaxConnectionDepth; ++depth) {
+        UsdShadeConnectableAPI source;
+        TfToken sourceName;
+        UsdShadeAttributeType sourceType;
+        if (!UsdShadeConnectableAPI::GetConnectedSource(attribute, &source, &sourceName, &sourceType)) {
+            return attribute;
+        }
+
+        if (sourceType == UsdShadeAttributeType::Output) {
+            if (source.GetPrim().IsA<UsdShadeShader>()) {
+                *shader = UsdShadeShader(source.GetPrim());
+                *outputName = sourceName;
+                return UsdAttribute();
+            }
+            attribute = source.GetOutput(sourceName).GetAttr();
+        } else {
+            attribute = source.GetInput(sourceName).GetAttr();
+        }
+    }
+    return UsdAttribute();
+}
+
+// Adds \p shader and the shaders upstream of it to \p network, upstream
+// first, the way UsdImaging orders network nodes
+void AddShaderNodes(
+    UsdShadeShader const& shader,
+    UsdTimeCode time,
+    HdMaterialNetwork* network,
+    std::unordered_set<SdfPath, SdfPath::Hash>* visited) {
+    if (!visited->insert(shader.GetPath()).second) {
+        return;
+    }
+
+    HdMaterialNode node;
+    node.path = shader.GetPath();
+    shader.GetShaderId(&node.identifier);
+
+    for (UsdShadeInput const& input : shader.GetInputs()) {
+        UsdShadeShader sourceShader;
+        TfToken sourceOutputName;
+        UsdAttribute valueAttribute = ResolveInput(input.GetAttr(), &sourceShader, &sourceOutputName);
+        if (sourceShader) {
+            AddShaderNodes(sourceShader, time, network, visited);
+
+            HdMaterialRelationship relationship;
+            relationship.inputId = sourceShader.GetPath();
+            relationship.inputName = sourceOutputName;
+            relationship.outputId = node.path;
+            relationship.outputName = input.GetBaseName();
+            network->relationships.push_back(std::move(relationship));
+        } else if (valueAttribute) {
+            VtValue value;
+            if (valueAttribute.Get(&value, time)) {
+                node.parameters[input.GetBaseName()] = value;
+            }
+        }
+    }
+
+    // Primvars read by the network, so render delegates can request them
+    if (TfStringStartsWith(node.identifier.GetString(), "UsdPrimvarReader")) {
+        static const TfToken kVarname("varname");
+        auto it = node.parameters.find(kVarname);
+        if (it != node.parameters.end()) {
+            if (it->second.IsHolding<TfToken>()) {
+                network->primvars.push_back(it->second.UncheckedGet<TfToken>());
+            } else if (it->second.IsHolding<std::string>()) {
+                network->primvars.push_back(TfToken(it->second.UncheckedGet<std::string>()));
+            }
+        }
+    }
+
+    network->nodes.push_back(std::move(node));
+}
+
+void BakeMaterialNetwork(UsdShadeMaterial const& material, UsdTimeCode time, HdMaterialNetworkMap* networkMap) {
+    TfToken const& renderContext = UsdShadeTokens->universalRenderContext;
+    std::pair<TfToken, UsdShadeShader> const terminals[] = {
+        {HdMaterialTerminalTokens->surface, material.ComputeSurfaceSource(renderContext)},
+        {HdMaterialTerminalTokens->displacement, material.ComputeDisplacementSource(renderContext)},
+        {HdMaterialTerminalTokens->volume, material.ComputeVolumeSource(renderContext)},
+    };
+
+    for (auto const& terminal : terminals) {
+        if (!terminal.second) {
+            continue;
+        }
+
+        std::unordered_set<SdfPath, SdfPath::Hash> visited;
+        AddShaderNodes(terminal.second, time, &networkMap->map[terminal.first], &visited);
+        networkMap->terminals.push_back(terminal.second.GetPath());
+    }
+}
+
+// Materials are written as:
+//   uint64 materialCount
+//   per material: path, uint64 networkCount
+//   per network: terminal name, terminal path, uint64 nodeCount
+//   per node: path, identifier, uint64 parameterCount, (name, type, value) per parameter
+//   per network: uint64 relationshipCount, (inputId, inputName, outputId, outputName) per relationship
+//   per network: uint64 primvarCount, names
+void WriteMaterial(SdfPath const& path, HdMaterialNetworkMap const& networkMap, StreamWriter* stream) {
+    stream->Write(path);
+    stream->Write(uint64_t(networkMap.map.size()));
+    for (auto const& entry : networkMap.map) {
+        HdMaterialNetwork const& network = entry.second;
+        stream->Write(entry.first);
+        stream->Write(network.nodes.empty() ? SdfPath() : network.nodes.back().path);
+
+        stream->Write(uint64_t(network.nodes.size()));
+        for (HdMaterialNode const& node : network.nodes) {
+            stream->Write(node.path);
+            stream->Write(node.identifier);
+
+            StreamWriter parameters;
+            uint64_t parameterCount = 0;
+            for (auto const& parameter : node.parameters) {
+                StreamWriter value;
+                if (WriteParameter(parameter.second, &value)) {
+                    parameters.Write(parameter.first);
+                    parameters.Write(value);
+                    ++parameterCount;
+                }
+            }
+            stream->Write(parameterCount);
+            stream->Write(parameters);
+        }
+
+        stream->Write(uint64_t(network.relationships.size()));
+        for (HdMaterialRelationship const& relationship : network.relationships) {
+            stream->Write(relationship.inputId);
+            stream->Write(relationship.inputName);
+            stream->Write(relationship.outputId);
+            stream->Write(relationship.outputName);
+        }
+
+        stream->Write(uint64_t(network.primvars.size()));
+        for (TfToken const& primvar : network.primvars) {
+            stream->Write(primvar);
+        }
+    }
+}
+
+bool ReadMaterial(StreamReader* stream, HdRprImagingCache::Material* material) {
+    // Smallest encodings of the list elements: strings are at least their
+    // size, parameters also have a type
+    const uint64_t kStringSize = sizeof(uint64_t);
+
+    uint64_t networkCount;
+    if (!stream->Read(&material->path) || !stream->ReadCount(&networkCount, 3 * kStringSize)) {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < networkCount; ++i) {
+        TfToken terminalName;
+        SdfPath terminalPath;
+        uint64_t nodeCount;
+        if (!stream->Read(&terminalName) || !stream->Read(&terminalPath) ||
+            !stream->ReadCount(&nodeCount, 3 * kStringSize)) {
+            return false;
+        }
+
+        HdMaterialNetwork& network = material->network.map[terminalName];
+        network.nodes.resize(nodeCount);
+        for (HdMaterialNode& node : network.nodes) {
+            uint64_t parameterCount;
+            if (!stream->Read(&node.path) || !stream->Read(&node.identifier) ||
+                !stream->ReadCount(&parameterCount, kStringSize + sizeof(uint32_t))) {
+                return false;
+            }
+            for (uint64_t j = 0; j < parameterCount; ++j) {
+                TfToken name;
+                VtValue value;
+                if (!stream->Read(&name) || !ReadParameter(stream, &value)) {
+                    return false;
+                }
+                node.parameters[name] = std::move(value);
+            }
+        }
+
+        uint64_t relationshipCount;
+        if (!stream->ReadCount(&relationshipCount, 4 * kStringSize)) {
+            return false;
+        }
+        network.relationships.resize(relationshipCount);
+        for (HdMaterialRelationship& relationship : network.relationships) {
+            if (!stream->Read(&relationship.inputId) || !stream->Read(&relationship.inputName) ||
+                !stream->Read(&relationship.outputId) || !stream->Read(&relationship.outputName)) {
+                return false;
+            }
+        }
+
+        uint64_t primvarCount;
+        if (!stream->ReadCount(&primvarCount, kStringSize)) {
+            return false;
+        }
+        network.primvars.resize(primvarCount);
+        for (TfToken& primvar : network.primvars) {
+            if (!stream->Read(&primvar)) {
+                return false;
+            }
+        }
+
+        material->network.terminals.push_back(terminalPath);
+    }
+    return true;
+}
+
+bool IsInRange(uint64_t offset, uint64_t size, uint64_t length) {
+    return offset <= length && size <= length - offset;
+}
+
+// Checks that \p count elements of \p elementSize bytes starting at \p offset
+// lie within \p length bytes, without overflowing on the way. Arrays are
+// also required to be aligned, as they are read in place.
+bool IsArrayInRange(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t length) {
+    return offset % kAlignment == 0 &&
+        count <= length / elementSize &&
+        IsInRange(offset, count * elementSize, length);
+}
+
+bool MultiplyCounts(uint64_t a, uint64_t b, uint64_t* product) {
+    if (a != 0 && b > std::numeric_limits<uint64_t>::max() / a) {
+        return false;
+    }
+    *product = a * b;
+    return true;
+}
+
+} // namespace anonymous
+
+bool HdRprImagingCache::Bake(
+    UsdStageRefPtr const& stage,
+    SdfPath const& rootPath,
+    double startFrame,
+    double endFrame,
+    double frameStep,
+    std::string const& filePath) {
+    UsdPrim root = stage ? stage->GetPrimAtPath(rootPath) : UsdPrim();
+    if (!root) {
+        TF_RUNTIME_ERROR("Can't bake imaging cache: invalid root <%s>", rootPath.GetText());
+        return false;
+    }
+
+    std::vector<UsdTimeCode> frames;
+    if (frameStep > 0.0 && endFrame > startFrame) {
+        size_t frameCount = size_t(std::floor((endFrame - startFrame) / frameStep + 1e-6)) + 1;
+        for (size_t i = 0; i < frameCount; ++i) {
+            frames.emplace_back(startFrame + i * frameStep);
+        }
+    } else {
+        frames.emplace_back(startFrame);
+        frameStep = 1.0;
+    }
+
+    std::vector<BakedMesh> meshes;
+    UsdPrimRange range(root, UsdTraverseInstanceProxies(UsdPrimDefaultPredicate));
+    for (auto it = range.begin(); it != range.end(); ++it) {
+        UsdGeomImageable imageable(*it);
+        TfToken purpose = imageable ? imageable.ComputePurpose() : UsdGeomTokens->default_;
+        if (it->IsA<UsdGeomPointInstancer>() ||
+            purpose == UsdGeomTokens->guide ||
+            purpose == UsdGeomTokens->proxy) {
+            it.PruneChildren();
+            continue;
+        }
+
+        if (it->IsA<UsdGeomMesh>() && imageable.ComputeVisibility(frames.front()) != UsdGeomTokens->invisible) {
+            meshes.emplace_back();
+            meshes.back().mesh = UsdGeomMesh(*it);
+        }
+    }
+
+    WorkParallelForN(meshes.size(), [&meshes, &frames](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            ReadMesh(&meshes[i], frames);
+        }
+    });
+
+    std::set<SdfPath> materialPaths;
+    for (auto const& baked : meshes) {
+        if (!baked.materialPath.IsEmpty()) {
+            materialPaths.insert(baked.materialPath);
+        }
+    }
+
+    StreamWriter materials;
+    materials.Write(uint64_t(materialPaths.size()));
+    for (SdfPath const& materialPath : materialPaths) {
+        HdMaterialNetworkMap networkMap;
+        BakeMaterialNetwork(UsdShadeMaterial(stage->GetPrimAtPath(materialPath)), frames.front(), &networkMap);
+        WriteMaterial(materialPath, networkMap, &materials);
+    }
+
+    std::vector<GfMatrix4d> transforms;
+    transforms.reserve(frames.size() * meshes.size());
+    for (UsdTimeCode frame : frames) {
+        UsdGeomXformCache xformCache(frame);
+        for (auto const& baked : meshes) {
+            transforms.push_back(xformCache.GetLocalToWorldTransform(baked.mesh.GetPrim()));
+        }
+    }
+
+    Blob strings;
+    Blob data;
+    std::vector<FilePrimvar> primvars;
+    for (auto& baked : meshes) {
+        FileMesh& header = baked.header;
+        header.pathOffset = strings.AppendString(baked.mesh.GetPath().GetString());
+        header.materialPathOffset = baked.materialPath.IsEmpty() ? kNoString : strings.AppendString(baked.materialPath.GetString());
+        header.subdivisionSchemeOffset = strings.AppendString(baked.subdivisionScheme.GetString());
+
+        header.pointCount = baked.points.front().size();
+        header.pointFrameCount = baked.points.size();
+        header.pointsOffset = data.Append(baked.points.front().cdata(), baked.points.front().size());
+        for (size_t i = 1; i < baked.points.size(); ++i) {
+            data.Append(baked.points[i].cdata(), baked.points[i].size());
+        }
+
+        header.faceCount = baked.faceVertexCounts.size();
+        header.faceVertexCountsOffset = data.Append(baked.faceVertexCounts.cdata(), baked.faceVertexCounts.size());
+        header.indexCount = baked.faceVertexIndices.size();
+        header.faceVertexIndicesOffset = data.Append(baked.faceVertexIndices.cdata(), baked.faceVertexIndices.size());
+
+        header.firstPrimvar = primvars.size();
+        header.primvarCount = baked.primvars.size();
+        for (auto const& bakedPrimvar : baked.primvars) {
+            FilePrimvar primvar = bakedPrimvar.header;
+            primvar.nameOffset = strings.AppendString(bakedPrimvar.name.GetString());
+            primvar.roleOffset = strings.AppendString(bakedPrimvar.role.GetString());
+            primvar.dataOffset = data.Append(bakedPrimvar.data.data(), bakedPrimvar.data.size());
+            primvars.push_back(primvar);
+        }
+    }
+
+    FileHeader header = {};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = Version;
+    header.byteOrderMark = kByteOrderMark;
+    header.meshCount = meshes.size();
+    header.frameCount = frames.size();
+    header.startFrame = frames.front().GetValue();
+    header.frameStep = frameStep;
+    header.meshesOffset = Align(sizeof(FileHeader));
+    header.primvarCount = primvars.size();
+    header.primvarsOffset = Align(header.meshesOffset + meshes.size() * sizeof(FileMesh));
+    header.transformsOffset = Align(header.primvarsOffset + primvars.size() * sizeof(FilePrimvar));
+    header.stringsOffset = Align(header.transformsOffset + transforms.size() * sizeof(GfMatrix4d));
+    header.stringsSize = strings.GetData().size();
+    header.materialsOffset = Align(header.stringsOffset + header.stringsSize);
+    header.materialsSize = materials.GetData().size();
+    uint64_t dataOffset = Align(header.materialsOffset + header.materialsSize);
+
+    std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        TF_RUNTIME_ERROR("Can't bake imaging cache: failed to open %s for writing", filePath.c_str());
+        return false;
+    }
+
+    auto writeAt = [&file](uint64_t offset, void const* data, size_t size) {
+        static const char kPadding[kAlignment] = {};
+        uint64_t position = uint64_t(file.tellp());
+        file.write(kPadding, std::streamsize(offset - position));
+        file.write(static_cast<char const*>(data), std::streamsize(size));
+    };
+
+    writeAt(0, &header, sizeof(header));
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        FileMesh fileMesh = meshes[i].header;
+        fileMesh.pointsOffset += dataOffset;
+        fileMesh.faceVertexCountsOffset += dataOffset;
+        fileMesh.faceVertexIndicesOffset += dataOffset;
+        writeAt(header.meshesOffset + i * sizeof(FileMesh), &fileMesh, sizeof(fileMesh));
+    }
+    for (size_t i = 0; i < primvars.size(); ++i) {
+        FilePrimvar filePrimvar = primvars[i];
+        filePrimvar.dataOffset += dataOffset;
+        writeAt(header.primvarsOffset + i * sizeof(FilePrimvar), &filePrimvar, sizeof(filePrimvar));
+    }
+    writeAt(header.transformsOffset, transforms.data(), transforms.size() * sizeof(GfMatrix4d));
+    writeAt(header.stringsOffset, strings.GetData().data(), strings.GetData().size());
+    writeAt(header.materialsOffset, materials.GetData().data(), materials.GetData().size());
+    writeAt(dataOffset, data.GetData().data(), data.GetData().size());
+
+    if (!file) {
+        TF_RUNTIME_ERROR("Can't bake imaging cache: failed to write %s", filePath.c_str());
+        return false;
+    }
+    return true;
+}
+
+HdRprImagingCache::HdRprImagingCache()
+    : m_transforms(nullptr)
+    , m_startFrame(0.0)
+    , m_frameStep(1.0)
+    , m_frameCount(0) {
+
+}
+
+HdRprImagingCache::~HdRprImagingCache() = default;
+
+std::unique_ptr<HdRprImagingCache> HdRprImagingCache::Open(std::string const& filePath) {
+    std::string error;
+    ArchConstFileMapping mapping = ArchMapFileReadOnly(filePath, &error);
+    if (!mapping) {
+        TF_RUNTIME_ERROR("Failed to map imaging cache %s: %s", filePath.c_str(), error.c_str());
+        return nullptr;
+    }
+
+    char const* base = mapping.get();
+    uint64_t length = ArchGetFileMappingLength(mapping);
+
+    FileHeader header;
+    if (length < sizeof(header)) {
+        TF_RUNTIME_ERROR("%s is not an imaging cache", filePath.c_str());
+        return nullptr;
+    }
+    std::memcpy(&header, base, sizeof(header));
+
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.byteOrderMark != kByteOrderMark) {
+        TF_RUNTIME_ERROR("%s is not an imaging cache of this platform", filePath.c_str());
+        return nullptr;
+    }
+    if (header.version != Version) {
+        TF_RUNTIME_ERROR("%s has imaging cache version %u, expected %u", filePath.c_str(), header.version, Version);
+        return nullptr;
+    }
+
+    uint64_t transformCount = 0;
+    bool isValid = header.frameCount > 0 &&
+        IsArrayInRange(header.meshesOffset, header.meshCount, sizeof(FileMesh), length) &&
+        IsArrayInRange(header.primvarsOffset, header.primvarCount, sizeof(FilePrimvar), length) &&
+        MultiplyCounts(header.frameCount, header.meshCount, &transformCount) &&
+        IsArrayInRange(header.transformsOffset, transformCount, sizeof(GfMatrix4d), length) &&
+        IsInRange(header.stringsOffset, header.stringsSize, length) &&
+        (header.stringsSize == 0 || base[header.stringsOffset + header.stringsSize - 1] == '\0') &&
+        IsInRange(header.materialsOffset, header.materialsSize, length);
+
+    std::unique_ptr<HdRprImagingCache> cache(new HdRprImagingCache);
+    cache->m_startFrame = header.startFrame;
+    cache->m_frameStep = header.frameStep;
+    cache->m_frameCount = header.frameCount;
+    cache->m_transforms = reinterpret_cast<GfMatrix4d const*>(base + header.transformsOffset);
+
+    auto getString = [&](uint64_t offset) {
+        return offset < header.stringsSize ? std::string(base + header.stringsOffset + offset) : std::string();
+    };
+
+    FileMesh const* fileMeshes = reinterpret_cast<FileMesh const*>(base + header.meshesOffset);
+    FilePrimvar const* filePrimvars = reinterpret_cast<FilePrimvar const*>(base + header.primvarsOffset);
+    for (uint64_t i = 0; isValid && i < header.meshCount; ++i) {
+        FileMesh const& fileMesh = fileMeshes[i];
+        uint64_t pointValueCount = 0;
+        isValid = (fileMesh.pointFrameCount == 1 || fileMesh.pointFrameCount == header.frameCount) &&
+            MultiplyCounts(fileMesh.pointCount, fileMesh.pointFrameCount, &pointValueCount) &&
+            IsArrayInRange(fileMesh.pointsOffset, pointValueCount, sizeof(GfVec3f), length) &&
+            IsArrayInRange(fileMesh.faceVertexCountsOffset, fileMesh.faceCount, sizeof(int), length) &&
+            IsArrayInRange(fileMesh.faceVertexIndicesOffset, fileMesh.indexCount, sizeof(int), length) &&
+            fileMesh.primvarCount <= header.primvarCount &&
+            fileMesh.firstPrimvar <= header.primvarCount - fileMesh.primvarCount;
+
+        Mesh mesh;
+        mesh.path = SdfPath(getString(fileMesh.pathOffset));
+        isValid = isValid && mesh.path.IsAbsolutePath() && mesh.path.IsPrimPath();
+        if (fileMesh.materialPathOffset != kNoString) {
+            mesh.materialPath = SdfPath(getString(fileMesh.materialPathOffset));
+        }
+        mesh.subdivisionScheme = TfToken(getString(fileMesh.subdivisionSchemeOffset));
+        mesh.orientation = (fileMesh.flags & MeshFlagLeftHanded) ? UsdGeomTokens->leftHanded : UsdGeomTokens->rightHanded;
+        mesh.doubleSided = fileMesh.flags & MeshFlagDoubleSided;
+        mesh.extent = GfRange3d(GfVec3d(GfVec3f(fileMesh.extentMin)), GfVec3d(GfVec3f(fileMesh.extentMax)));
+        mesh.hasVaryingPoints = fileMesh.pointFrameCount > 1;
+
+        size_t firstPrimvar = cache->m_primvarData.size();
+        for (uint64_t j = 0; isValid && j < fileMesh.primvarCount; ++j) {
+            FilePrimvar const& filePrimvar = filePrimvars[fileMesh.firstPrimvar + j];
+            isValid = filePrimvar.interpolation < HdInterpolationCount &&
+                filePrimvar.valueType < ValueTypeCount &&
+                (filePrimvar.isArray || filePrimvar.elementCount == 1) &&
+                IsArrayInRange(filePrimvar.dataOffset, filePrimvar.elementCount, kValueSizes[filePrimvar.valueType], length);
+
+            Primvar primvar;
+            primvar.name = TfToken(getString(filePrimvar.nameOffset));
+            primvar.interpolation = HdInterpolation(filePrimvar.interpolation);
+            primvar.role = TfToken(getString(filePrimvar.roleOffset));
+            isValid = isValid && !primvar.name.IsEmpty();
+            mesh.primvars.push_back(std::move(primvar));
+
+            _PrimvarData data;
+            data.offset = filePrimvar.dataOffset;
+            data.elementCount = filePrimvar.elementCount;
+            data.valueType = filePrimvar.valueType;
+            data.isArray = filePrimvar.isArray;
+            cache->m_primvarData.push_back(data);
+        }
+        cache->m_meshes.push_back(std::move(mesh));
+
+        _MeshData data;
+        data.pointsOffset = fileMesh.pointsOffset;
+        data.pointCount = fileMesh.pointCount;
+        data.faceVertexCountsOffset = fileMesh.faceVertexCountsOffset;
+        data.faceCount = fileMesh.faceCount;
+        data.faceVertexIndicesOffset = fileMesh.faceVertexIndicesOffset;
+        data.indexCount = fileMesh.indexCount;
+        data.firstPrimvar = firstPrimvar;
+        cache->m_meshData.push_back(data);
+    }
+
+    if (isValid) {
+        StreamReader materials(base + header.materialsOffset, header.materialsSize);
+        uint64_t materialCount;
+        isValid = materials.ReadCount(&materialCount, 2 * sizeof(uint64_t));
+        for (uint64_t i = 0; isValid && i < materialCount; ++i) {
+            cache->m_materials.emplace_back();
+            isValid = ReadMaterial(&materials, &cache->m_materials.back());
+        }
+        isValid = isValid && materials.IsAtEnd();
+    }
+
+    if (!isValid) {
+        TF_RUNTIME_ERROR("Imaging cache %s is corrupted", filePath.c_str());
+        return nullptr;
+    }
+
+    cache->m_mapping = std::move(mapping);
+    return cache;
+}
+
+size_t HdRprImagingCache::GetFrameIndex(double frame) const {
+    double index = std::round((frame - m_startFrame) / m_frameStep);
+    return index <= 0.0 ? 0 : std::min(size_t(index), m_frameCount - 1);
+}
+
+GfMatrix4d const& HdRprImagingCache::GetTransform(size_t meshIndex, size_t frameIndex) const {
+    return m_transforms[frameIndex * m_meshes.size() + meshIndex];
+}
+
+template <typename T>
+VtArray<T> HdRprImagingCache::_GetArray(uint64_t offset, uint64_t size) const {
+    // The mapping is read-only, VtArray copies the data before any write
+    T* data = const_cast<T*>(reinterpret_cast<T const*>(m_mapping.get() + offset));
+    return VtArray<T>(&m_foreignDataSource, data, size);
+}
+
+VtVec3fArray HdRprImagingCache::GetPoints(size_t meshIndex, size_t frameIndex) const {
+    _MeshData const& data = m_meshData[meshIndex];
+    if (!m_meshes[meshIndex].hasVaryingPoints) {
+        frameIndex = 0;
+    }
+    return _GetArray<GfVec3f>(data.pointsOffset + frameIndex * data.pointCount * sizeof(GfVec3f), data.pointCount);
+}
+
+VtIntArray HdRprImagingCache::GetFaceVertexCounts(size_t meshIndex) const {
+    _MeshData const& data = m_meshData[meshIndex];
+    return _GetArray<int>(data.faceVertexCountsOffset, data.faceCount);
+}
+
+VtIntArray HdRprImagingCache::GetFaceVertexIndices(size_t meshIndex) const {
+    _MeshData const& data = m_meshData[meshIndex];
+    return _GetArray<int>(data.faceVertexIndicesOffset, data.indexCount);
+}
+
+template <typename T>
+VtValue HdRprImagingCache::_GetValue(_PrimvarData const& data) const {
+    if (data.isArray) {
+        return VtValue(_GetArray<T>(data.offset, data.elementCount));
+    }
+
+    T value;
+    std::memcpy(&value, m_mapping.get() + data.offset, sizeof(T));
+    return VtValue(value);
+}
+
+VtValue HdRprImagingCache::GetPrimvar(size_t meshIndex, size_t primvarIndex) const {
+    _PrimvarData const& data = m_primvarData[m_meshData[meshIndex].firstPrimvar + primvarIndex];
+    switch (data.valueType) {
+        case ValueTypeInt: return _GetValue<int>(data);
+        case ValueTypeVec2i: return _GetValue<GfVec2i>(data);
+        case ValueTypeVec3i: return _GetValue<GfVec3i>(data);
+        case ValueTypeVec4i: return _GetValue<GfVec4i>(data);
+        case ValueTypeFloat: return _GetValue<float>(data);
+        case ValueTypeVec2f: return _GetValue<GfVec2f>(data);
+        case ValueTypeVec3f: return _GetValue<GfVec3f>(data);
+        case ValueTypeVec4f: return _GetValue<GfVec4f>(data);
+        case ValueTypeDouble: return _GetValue<double>(data);
+        case ValueTypeVec2d: return _GetValue<GfVec2d>(data);
+        case ValueTypeVec3d: return _GetValue<GfVec3d>(data);
+        case ValueTypeVec4d: return _GetValue<GfVec4d>(data);
+        case ValueTypeMatrix4d: return _GetValue<GfMatrix4d>(data);
+        default: return VtValue();
+    }
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
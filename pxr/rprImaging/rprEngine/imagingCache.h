@@ -0,0 +1,168 @@
+#ifndef HDRPR_IMAGING_CACHE_H
+#define HDRPR_IMAGING_CACHE_H
+
+#include "api.h"
+
+#include "pxr/imaging/hd/enums.h"
+#include "pxr/imaging/hd/material.h"
+#include "pxr/usd/usd/common.h"
+#include "pxr/usd/sdf/path.h"
+#include "pxr/base/arch/fileSystem.h"
+#include "pxr/base/gf/matrix4d.h"
+#include "pxr/base/gf/range3d.h"
+#include "pxr/base/gf/vec3f.h"
+#include "pxr/base/tf/token.h"
+#include "pxr/base/vt/array.h"
+#include "pxr/base/vt/types.h"
+#include "pxr/base/vt/value.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class HdRprImagingCache
+///
+/// Imaging data of a stage baked into a single file: flattened meshes with
+/// their topology, points, primvars and material binding, the networks of
+/// the bound materials, and the transforms of all meshes for every frame of
+/// a frame range. The file is memory mapped on open and arrays are handed
+/// out as VtArrays pointing into the mapping, so loading doesn't compose,
+/// parse or copy any of the bulk data. Material networks are small and read
+/// into memory on open.
+///
+/// Arrays returned by the cache reference its mapping; the cache has to
+/// outlive every render index they were given to.
+///
+class HdRprImagingCache {
+public:
+    /// Version of the file layout, files of other versions are rejected.
+    static const uint32_t Version = 3;
+
+    struct Primvar {
+        TfToken name;
+        HdInterpolation interpolation;
+        TfToken role;
+    };
+
+    struct Mesh {
+        SdfPath path;
+        SdfPath materialPath;
+        TfToken subdivisionScheme;
+        TfToken orientation;
+        bool doubleSided = false;
+        GfRange3d extent;
+        bool hasVaryingPoints = false;
+        std::vector<Primvar> primvars;
+    };
+
+    struct Material {
+        SdfPath path;
+        HdMaterialNetworkMap network;
+    };
+
+    /// Bake the meshes under \p rootPath for frames \p startFrame to
+    /// \p endFrame in steps of \p frameStep. Instances are flattened; point
+    /// instancers, guides, proxies and meshes invisible at the start frame
+    /// are skipped. Topology and primvars are taken from the start frame,
+    /// primvars flattened and with inherited constant primvars included.
+    /// Primvars of types other than scalars, vectors and matrices of ints,
+    /// floats and doubles are skipped. The surface, displacement and volume
+    /// networks of the bound materials are baked from their universal render
+    /// context outputs at the start frame; parameters of types other than
+    /// bools, strings, tokens, asset paths and the primvar types are skipped.
+    HDRPR_API
+    static bool Bake(UsdStageRefPtr const& stage,
+                     SdfPath const& rootPath,
+                     double startFrame,
+                     double endFrame,
+                     double frameStep,
+                     std::string const& filePath);
+
+    /// Map \p filePath. Returns null if the file can't be mapped or is not a
+    /// valid cache of the current version.
+    HDRPR_API
+    static std::unique_ptr<HdRprImagingCache> Open(std::string const& filePath);
+
+    HDRPR_API
+    ~HdRprImagingCache();
+
+    size_t GetMeshCount() const { return m_meshes.size(); }
+    Mesh const& GetMesh(size_t meshIndex) const { return m_meshes[meshIndex]; }
+
+    size_t GetMaterialCount() const { return m_materials.size(); }
+    Material const& GetMaterial(size_t materialIndex) const { return m_materials[materialIndex]; }
+
+    double GetStartFrame() const { return m_startFrame; }
+    double GetFrameStep() const { return m_frameStep; }
+    size_t GetFrameCount() const { return m_frameCount; }
+
+    /// Returns the baked frame closest to \p frame.
+    HDRPR_API
+    size_t GetFrameIndex(double frame) const;
+
+    HDRPR_API
+    GfMatrix4d const& GetTransform(size_t meshIndex, size_t frameIndex) const;
+
+    HDRPR_API
+    VtVec3fArray GetPoints(size_t meshIndex, size_t frameIndex) const;
+
+    HDRPR_API
+    VtIntArray GetFaceVertexCounts(size_t meshIndex) const;
+
+    HDRPR_API
+    VtIntArray GetFaceVertexIndices(size_t meshIndex) const;
+
+    /// Returns the value of primvar \p primvarIndex of the mesh, an array
+    /// pointing into the mapping or, for primvars baked from a scalar, a
+    /// single value.
+    HDRPR_API
+    VtValue GetPrimvar(size_t meshIndex, size_t primvarIndex) const;
+
+private:
+    HdRprImagingCache();
+
+    struct _PrimvarData {
+        uint64_t offset;
+        uint64_t elementCount;
+        uint32_t valueType;
+        bool isArray;
+    };
+
+    template <typename T>
+    VtArray<T> _GetArray(uint64_t offset, uint64_t size) const;
+
+    template <typename T>
+    VtValue _GetValue(_PrimvarData const& data) const;
+
+private:
+    ArchConstFileMapping m_mapping;
+
+    // Lets VtArrays reference the mapping without copying
+    mutable Vt_ArrayForeignDataSource m_foreignDataSource;
+
+    struct _MeshData {
+        uint64_t pointsOffset;
+        uint64_t pointCount;
+        uint64_t faceVertexCountsOffset;
+        uint64_t faceCount;
+        uint64_t faceVertexIndicesOffset;
+        uint64_t indexCount;
+        uint64_t firstPrimvar;
+    };
+    std::vector<Mesh> m_meshes;
+    std::vector<_MeshData> m_meshData;
+    std::vector<_PrimvarData> m_primvarData;
+    std::vector<Material> m_materials;
+    GfMatrix4d const* m_transforms;
+
+    double m_startFrame;
+    double m_frameStep;
+    size_t m_frameCount;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_IMAGING_CACHE_H
@@ -0,0 +1,168 @@
+#include "pxr/rprImaging/rprEngine/imagingCacheDelegate.h"
+#include "pxr/rprImaging/rprEngine/imagingCache.h"
+
+#include "pxr/imaging/hd/meshTopology.h"
+#include "pxr/imaging/hd/renderIndex.h"
+#include "pxr/imaging/hd/tokens.h"
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+HdRprImagingCacheDelegate::HdRprImagingCacheDelegate(
+    HdRenderIndex* renderIndex,
+    SdfPath const& delegateID,
+    HdRprImagingCache const* cache)
+    : HdSceneDelegate(renderIndex, delegateID)
+    , m_cache(cache)
+    , m_frameIndex(0) {
+
+}
+
+HdRprImagingCacheDelegate::~HdRprImagingCacheDelegate() {
+    GetRenderIndex().RemoveSubtree(GetDelegateID(), this);
+}
+
+void HdRprImagingCacheDelegate::Populate() {
+    HdRenderIndex& renderIndex = GetRenderIndex();
+    SdfPath const& delegateID = GetDelegateID();
+
+    for (size_t i = 0; i < m_cache->GetMeshCount(); ++i) {
+        SdfPath id = m_cache->GetMesh(i).path.ReplacePrefix(SdfPath::AbsoluteRootPath(), delegateID);
+        if (m_meshIndices.emplace(id, int(i)).second) {
+            renderIndex.InsertRprim(HdPrimTypeTokens->mesh, this, id);
+        }
+    }
+
+    if (renderIndex.IsSprimTypeSupported(HdPrimTypeTokens->material)) {
+        for (size_t i = 0; i < m_cache->GetMaterialCount(); ++i) {
+            SdfPath id = m_cache->GetMaterial(i).path.ReplacePrefix(SdfPath::AbsoluteRootPath(), delegateID);
+            if (m_materialIndices.emplace(id, int(i)).second) {
+                renderIndex.InsertSprim(HdPrimTypeTokens->material, this, id);
+            }
+        }
+    }
+}
+
+bool HdRprImagingCacheDelegate::SetTime(double frame) {
+    size_t frameIndex = m_cache->GetFrameIndex(frame);
+    if (frameIndex == m_frameIndex) {
+        return false;
+    }
+
+    HdChangeTracker& changeTracker = GetRenderIndex().GetChangeTracker();
+    for (auto const& entry : m_meshIndices) {
+        HdDirtyBits dirtyBits = HdChangeTracker::Clean;
+        if (m_cache->GetTransform(entry.second, frameIndex) != m_cache->GetTransform(entry.second, m_frameIndex)) {
+            dirtyBits |= HdChangeTracker::DirtyTransform;
+        }
+        if (m_cache->GetMesh(entry.second).hasVaryingPoints) {
+            dirtyBits |= HdChangeTracker::DirtyPoints;
+        }
+        if (dirtyBits != HdChangeTracker::Clean) {
+            changeTracker.MarkRprimDirty(entry.first, dirtyBits);
+        }
+    }
+
+    m_frameIndex = frameIndex;
+    return true;
+}
+
+int HdRprImagingCacheDelegate::_GetMeshIndex(SdfPath const& id) const {
+    auto it = m_meshIndices.find(id);
+    return it != m_meshIndices.end() ? it->second : -1;
+}
+
+HdMeshTopology HdRprImagingCacheDelegate::GetMeshTopology(SdfPath const& id) {
+    int meshIndex = _GetMeshIndex(id);
+    if (meshIndex < 0) {
+        return HdMeshTopology();
+    }
+
+    auto const& mesh = m_cache->GetMesh(meshIndex);
+    return HdMeshTopology(mesh.subdivisionScheme, mesh.orientation,
+                          m_cache->GetFaceVertexCounts(meshIndex),
+                          m_cache->GetFaceVertexIndices(meshIndex));
+}
+
+GfRange3d HdRprImagingCacheDelegate::GetExtent(SdfPath const& id) {
+    int meshIndex = _GetMeshIndex(id);
+    return meshIndex < 0 ? GfRange3d() : m_cache->GetMesh(meshIndex).extent;
+}
+
+GfMatrix4d HdRprImagingCacheDelegate::GetTransform(SdfPath const& id) {
+    int meshIndex = _GetMeshIndex(id);
+    return meshIndex < 0 ? GfMatrix4d(1.0) : m_cache->GetTransform(meshIndex, m_frameIndex);
+}
+
+bool HdRprImagingCacheDelegate::GetVisible(SdfPath const& id) {
+    return true;
+}
+
+bool HdRprImagingCacheDelegate::GetDoubleSided(SdfPath const& id) {
+    int meshIndex = _GetMeshIndex(id);
+    return meshIndex >= 0 && m_cache->GetMesh(meshIndex).doubleSided;
+}
+
+VtValue HdRprImagingCacheDelegate::Get(SdfPath const& id, TfToken const& key) {
+    int meshIndex = _GetMeshIndex(id);
+    if (meshIndex < 0) {
+        return VtValue();
+    }
+
+    if (key == HdTokens->points) {
+        return VtValue(m_cache->GetPoints(meshIndex, m_frameIndex));
+    }
+
+    auto const& primvars = m_cache->GetMesh(meshIndex).primvars;
+    for (size_t i = 0; i < primvars.size(); ++i) {
+        if (primvars[i].name == key) {
+            return m_cache->GetPrimvar(meshIndex, i);
+        }
+    }
+    return VtValue();
+}
+
+SdfPath HdRprImagingCacheDelegate::GetMaterialId(SdfPath const& rprimId) {
+    int meshIndex = _GetMeshIndex(rprimId);
+    if (meshIndex < 0) {
+        return SdfPath();
+    }
+
+    SdfPath const& materialPath = m_cache->GetMesh(meshIndex).materialPath;
+    if (materialPath.IsEmpty()) {
+        return SdfPath();
+    }
+
+    SdfPath materialId = materialPath.ReplacePrefix(SdfPath::AbsoluteRootPath(), GetDelegateID());
+    return m_materialIndices.count(materialId) ? materialId : SdfPath();
+}
+
+VtValue HdRprImagingCacheDelegate::GetMaterialResource(SdfPath const& materialId) {
+    auto it = m_materialIndices.find(materialId);
+    if (it == m_materialIndices.end()) {
+        return VtValue();
+    }
+    return VtValue(m_cache->GetMaterial(it->second).network);
+}
+
+HdPrimvarDescriptorVector HdRprImagingCacheDelegate::GetPrimvarDescriptors(
+    SdfPath const& id,
+    HdInterpolation interpolation) {
+    HdPrimvarDescriptorVector primvars;
+
+    int meshIndex = _GetMeshIndex(id);
+    if (meshIndex < 0) {
+        return primvars;
+    }
+
+    if (interpolation == HdInterpolationVertex) {
+        primvars.emplace_back(HdTokens->points, interpolation, HdPrimvarRoleTokens->point);
+    }
+    for (auto const& primvar : m_cache->GetMesh(meshIndex).primvars) {
+        if (primvar.interpolation == interpolation) {
+            primvars.emplace_back(primvar.name, interpolation, primvar.role);
+        }
+    }
+    return primvars;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
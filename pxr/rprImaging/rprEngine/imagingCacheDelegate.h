@@ -0,0 +1,83 @@
+#ifndef HDRPR_IMAGING_CACHE_DELEGATE_H
+#define HDRPR_IMAGING_CACHE_DELEGATE_H
+
+#include "api.h"
+
+#include "pxr/imaging/hd/sceneDelegate.h"
+#include "pxr/base/tf/hashmap.h"
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+class HdRprImagingCache;
+
+/// \class HdRprImagingCacheDelegate
+///
+/// Scene delegate serving the meshes and materials of an HdRprImagingCache.
+/// Prims are inserted under the delegate ID at their baked stage paths. Data
+/// is returned straight from the cache; the only per-frame work is dirtying
+/// the prims whose transform or points differ between frames.
+///
+/// Materials are inserted as material sprims if the render delegate supports
+/// them. Meshes are bound to them only then, and otherwise get the render
+/// delegate's fallback material.
+///
+class HdRprImagingCacheDelegate : public HdSceneDelegate {
+public:
+    HDRPR_API
+    HdRprImagingCacheDelegate(HdRenderIndex* renderIndex,
+                              SdfPath const& delegateID,
+                              HdRprImagingCache const* cache);
+
+    HDRPR_API
+    ~HdRprImagingCacheDelegate() override;
+
+    HDRPR_API
+    void Populate();
+
+    /// Switch to the baked frame closest to \p frame. Returns true if that
+    /// is a different frame than before.
+    HDRPR_API
+    bool SetTime(double frame);
+
+    HDRPR_API
+    HdMeshTopology GetMeshTopology(SdfPath const& id) override;
+
+    HDRPR_API
+    GfRange3d GetExtent(SdfPath const& id) override;
+
+    HDRPR_API
+    GfMatrix4d GetTransform(SdfPath const& id) override;
+
+    HDRPR_API
+    bool GetVisible(SdfPath const& id) override;
+
+    HDRPR_API
+    bool GetDoubleSided(SdfPath const& id) override;
+
+    HDRPR_API
+    VtValue Get(SdfPath const& id, TfToken const& key) override;
+
+    HDRPR_API
+    SdfPath GetMaterialId(SdfPath const& rprimId) override;
+
+    HDRPR_API
+    VtValue GetMaterialResource(SdfPath const& materialId) override;
+
+    HDRPR_API
+    HdPrimvarDescriptorVector GetPrimvarDescriptors(SdfPath const& id,
+                                                    HdInterpolation interpolation) override;
+
+private:
+    // Returns the index of the cache mesh of \p id, or -1
+    int _GetMeshIndex(SdfPath const& id) const;
+
+private:
+    HdRprImagingCache const* m_cache;
+    TfHashMap<SdfPath, int, SdfPath::Hash> m_meshIndices;
+    TfHashMap<SdfPath, int, SdfPath::Hash> m_materialIndices;
+    size_t m_frameIndex;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_IMAGING_CACHE_DELEGATE_H
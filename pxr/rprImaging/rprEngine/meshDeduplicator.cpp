@@ -0,0 +1,410 @@
+#include "pxr/rprImaging/rprEngine/meshDeduplicator.h"
+
+#include "pxr/usd/usd/primRange.h"
+#include "pxr/usd/usd/stage.h"
+#include "pxr/usd/usdGeom/imageable.h"
+#include "pxr/usd/usdGeom/mesh.h"
+#include "pxr/usd/usdGeom/pointInstancer.h"
+#include "pxr/usd/usdGeom/primvarsAPI.h"
+#include "pxr/usd/usdGeom/subset.h"
+#include "pxr/usd/usdGeom/tokens.h"
+#include "pxr/usd/usdGeom/xformCache.h"
+#include "pxr/usd/usdGeom/xformOp.h"
+#include "pxr/usd/usdShade/materialBindingAPI.h"
+#include "pxr/usd/usdShade/tokens.h"
+#include "pxr/usd/sdf/attributeSpec.h"
+#include "pxr/usd/sdf/changeBlock.h"
+#include "pxr/usd/sdf/layer.h"
+#include "pxr/usd/sdf/primSpec.h"
+#include "pxr/usd/sdf/relationshipSpec.h"
+#include "pxr/usd/sdf/types.h"
+#include "pxr/base/gf/vec2f.h"
+#include "pxr/base/gf/vec3d.h"
+#include "pxr/base/gf/vec3f.h"
+#include "pxr/base/gf/vec3h.h"
+#include "pxr/base/gf/vec4f.h"
+#include "pxr/base/tf/hashmap.h"
+#include "pxr/base/tf/stringUtils.h"
+#include "pxr/base/work/loops.h"
+
+#include <boost/functional/hash.hpp>
+
+#include <algorithm>
+#include <functional>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+
+struct MeshData {
+    UsdPrim prim;
+    bool isCandidate = false;
+    size_t hash = 0;
+    size_t byteSize = 0;
+    SdfPath material;
+
+    // Authored attribute values except the transform, sorted by name
+    std::vector<std::pair<TfToken, VtValue>> values;
+};
+
+template <typename T>
+bool AddArraySize(VtValue const& value, size_t* size) {
+    if (!value.IsHolding<VtArray<T>>()) {
+        return false;
+    }
+    *size += value.UncheckedGet<VtArray<T>>().size() * sizeof(T);
+    return true;
+}
+
+size_t GetValueSize(VtValue const& value) {
+    size_t size = 0;
+    AddArraySize<GfVec3f>(value, &size) ||
+    AddArraySize<int>(value, &size) ||
+    AddArraySize<GfVec2f>(value, &size) ||
+    AddArraySize<float>(value, &size) ||
+    AddArraySize<GfVec4f>(value, &size) ||
+    AddArraySize<GfVec3h>(value, &size) ||
+    AddArraySize<GfVec3d>(value, &size) ||
+    AddArraySize<double>(value, &size);
+    return size;
+}
+
+void ReadMesh(MeshData* mesh) {
+    UsdPrim const& prim = mesh->prim;
+
+    for (UsdPrim const& child : prim.GetAllChildren()) {
+        if (!child.IsA<UsdGeomSubset>()) {
+            return;
+        }
+    }
+
+    UsdGeomImageable imageable(prim);
+    if (imageable.ComputePurpose() != UsdGeomTokens->default_ ||
+        imageable.ComputeVisibility() == UsdGeomTokens->invisible) {
+        return;
+    }
+
+    // Relationships other than material bindings, e.g. skinning, may tie
+    // the mesh to its place in the hierarchy
+    for (UsdRelationship const& rel : prim.GetAuthoredRelationships()) {
+        if (!TfStringStartsWith(rel.GetName().GetString(), "material:binding")) {
+            return;
+        }
+    }
+
+    for (UsdAttribute const& attr : prim.GetAuthoredAttributes()) {
+        TfToken const& name = attr.GetName();
+        if (name == UsdGeomTokens->xformOpOrder || UsdGeomXformOp::IsXformOp(name)) {
+            continue;
+        }
+        if (attr.ValueMightBeTimeVarying() ||
+            TfStringStartsWith(name.GetString(), "primvars:skel:")) {
+            return;
+        }
+
+        VtValue value;
+        attr.Get(&value, UsdTimeCode::EarliestTime());
+        mesh->byteSize += GetValueSize(value);
+        mesh->values.emplace_back(name, std::move(value));
+    }
+    std::sort(mesh->values.begin(), mesh->values.end(),
+        [](std::pair<TfToken, VtValue> const& a, std::pair<TfToken, VtValue> const& b) {
+            return a.first.GetString() < b.first.GetString();
+        });
+
+    mesh->material = UsdShadeMaterialBindingAPI(prim).ComputeBoundMaterial().GetPath();
+
+    boost::hash_combine(mesh->hash, mesh->material.GetHash());
+    for (auto const& entry : mesh->values) {
+        boost::hash_combine(mesh->hash, entry.first.Hash());
+        boost::hash_combine(mesh->hash, entry.second.GetHash());
+    }
+    mesh->isCandidate = true;
+}
+
+bool IsSameMesh(MeshData const& a, MeshData const& b) {
+    if (a.hash != b.hash ||
+        a.material != b.material ||
+        a.values.size() != b.values.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.values.size(); ++i) {
+        if (a.values[i].first != b.values[i].first ||
+            a.values[i].second != b.values[i].second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+SdfPrimSpecHandle CreatePrimSpec(
+    SdfLayerHandle const& layer,
+    SdfPath const& path,
+    SdfSpecifier specifier,
+    std::string const& typeName) {
+    SdfPrimSpecHandle spec = SdfCreatePrimInLayer(layer, path);
+    if (spec) {
+        spec->SetSpecifier(specifier);
+        spec->SetTypeName(typeName);
+    }
+    return spec;
+}
+
+void SetXformOpOrder(SdfPrimSpecHandle const& spec, VtTokenArray const& opOrder) {
+    SdfAttributeSpecHandle attr = SdfAttributeSpec::New(
+        spec, UsdGeomTokens->xformOpOrder.GetString(), SdfValueTypeNames->TokenArray, SdfVariabilityUniform);
+    if (attr) {
+        attr->SetDefaultValue(VtValue(opOrder));
+    }
+}
+
+} // namespace anonymous
+
+HdRprMeshDeduplicator::HdRprMeshDeduplicator()
+    : m_meshCount(0)
+    , m_prototypeCount(0)
+    , m_bytesSaved(0)
+    , m_bytesKept(0) {
+
+}
+
+HdRprMeshDeduplicator::~HdRprMeshDeduplicator() {
+    Restore();
+}
+
+void HdRprMeshDeduplicator::Apply(
+    UsdPrim const& root,
+    HdRprPathTrie const& excludedPaths,
+    HdRprPathTrie const& hiddenPaths,
+    SdfPath const& scopePath) {
+    Restore();
+
+    if (!root || !TF_VERIFY(scopePath.HasPrefix(root.GetPath()))) {
+        return;
+    }
+
+    UsdStageRefPtr stage = root.GetStage();
+    if (stage->GetPrimAtPath(scopePath)) {
+        TF_RUNTIME_ERROR("Can't deduplicate meshes: <%s> already exists", scopePath.GetText());
+        return;
+    }
+
+    // Gather static meshes that aren't part of an instancer
+    TfHashMap<SdfPath, bool, SdfPath::Hash> isStaticXform;
+    std::function<bool(UsdPrim const&)> isStatic = [&](UsdPrim const& prim) {
+        if (!prim || prim.IsPseudoRoot()) {
+            return true;
+        }
+
+        auto it = isStaticXform.find(prim.GetPath());
+        if (it != isStaticXform.end()) {
+            return it->second;
+        }
+
+        UsdGeomXformable xformable(prim);
+        bool result = !(xformable && xformable.TransformMightBeTimeVarying()) &&
+                      isStatic(prim.GetParent());
+        isStaticXform[prim.GetPath()] = result;
+        return result;
+    };
+
+    TfHashMap<SdfPath, bool, SdfPath::Hash> hasInheritedPrimvars;
+
+    std::vector<MeshData> meshes;
+    UsdPrimRange range(root);
+    for (auto it = range.begin(); it != range.end(); ++it) {
+        SdfPath const& path = it->GetPath();
+        if (excludedPaths.IsCovered(path) || hiddenPaths.IsCovered(path) ||
+            it->IsA<UsdGeomPointInstancer>()) {
+            it.PruneChildren();
+            continue;
+        }
+
+        if (!it->IsA<UsdGeomMesh>()) {
+            continue;
+        }
+        it.PruneChildren();
+
+        UsdPrim parent = it->GetParent();
+        auto inherited = hasInheritedPrimvars.find(parent.GetPath());
+        if (inherited == hasInheritedPrimvars.end()) {
+            bool result = !UsdGeomPrimvarsAPI(parent).FindPrimvarsWithInheritance().empty();
+            inherited = hasInheritedPrimvars.emplace(parent.GetPath(), result).first;
+        }
+
+        if (!inherited->second && isStatic(*it)) {
+            meshes.emplace_back();
+            meshes.back().prim = *it;
+        }
+    }
+
+    WorkParallelForN(meshes.size(), [&meshes](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            ReadMesh(&meshes[i]);
+        }
+    });
+
+    // Group identical meshes, the first one of every group is its representative
+    std::vector<std::vector<size_t>> groups;
+    TfHashMap<size_t, std::vector<size_t>> groupsByHash;
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        MeshData& mesh = meshes[i];
+        if (!mesh.isCandidate) {
+            continue;
+        }
+        m_bytesKept += mesh.byteSize;
+
+        std::vector<size_t>& hashGroups = groupsByHash[mesh.hash];
+        auto group = std::find_if(hashGroups.begin(), hashGroups.end(),
+            [&](size_t groupIndex) { return IsSameMesh(meshes[groups[groupIndex].front()], mesh); });
+        if (group != hashGroups.end()) {
+            groups[*group].push_back(i);
+
+            // Only the representative has to keep its values
+            mesh.values.clear();
+        } else {
+            hashGroups.push_back(groups.size());
+            groups.push_back({i});
+        }
+    }
+
+    groups.erase(std::remove_if(groups.begin(), groups.end(),
+        [](std::vector<size_t> const& group) { return group.size() < 2; }), groups.end());
+    if (groups.empty()) {
+        m_bytesKept = 0;
+        return;
+    }
+
+    // Instances are placed under the scope, relative to its parent
+    UsdGeomXformCache xformCache(UsdTimeCode::EarliestTime());
+    GfMatrix4d parentInverse = xformCache.GetLocalToWorldTransform(
+        stage->GetPrimAtPath(scopePath.GetParentPath())).GetInverse();
+
+    SdfLayerHandle sessionLayer = stage->GetSessionLayer();
+    SdfPath prototypesPath = scopePath.AppendChild(TfToken("Prototypes"));
+    SdfPath instancesPath = scopePath.AppendChild(TfToken("Instances"));
+    TfToken meshName("Mesh");
+    VtTokenArray instanceOpOrder(1, UsdGeomXformOp::GetOpName(UsdGeomXformOp::TypeTransform));
+
+    SdfChangeBlock changeBlock;
+
+    CreatePrimSpec(sessionLayer, scopePath, SdfSpecifierDef, "Scope");
+    CreatePrimSpec(sessionLayer, instancesPath, SdfSpecifierDef, "Scope");
+
+    // Prototypes are overs so that only their instances are drawn
+    CreatePrimSpec(sessionLayer, prototypesPath, SdfSpecifierOver, "Scope");
+
+    size_t instanceCount = 0;
+    for (size_t groupIndex = 0; groupIndex < groups.size(); ++groupIndex) {
+        std::vector<size_t> const& group = groups[groupIndex];
+        MeshData const& representative = meshes[group.front()];
+
+        SdfPath prototypePath = prototypesPath.AppendChild(TfToken(TfStringPrintf("Prototype_%zu", groupIndex)));
+        CreatePrimSpec(sessionLayer, prototypePath, SdfSpecifierOver, "Xform");
+
+        // The prototype mesh takes everything but the transform from the
+        // representative, which itself gets deactivated below
+        SdfPrimSpecHandle meshSpec = CreatePrimSpec(sessionLayer, prototypePath.AppendChild(meshName), SdfSpecifierDef, "Mesh");
+        meshSpec->GetReferenceList().Prepend(SdfReference(std::string(), representative.prim.GetPath()));
+        meshSpec->SetActive(true);
+        SetXformOpOrder(meshSpec, VtTokenArray());
+        if (!representative.material.IsEmpty()) {
+            SdfRelationshipSpecHandle binding = SdfRelationshipSpec::New(
+                meshSpec, UsdShadeTokens->materialBinding.GetString(), /* custom = */ false, SdfVariabilityUniform);
+            if (binding) {
+                binding->GetTargetPathList().Prepend(representative.material);
+            }
+        }
+
+        for (size_t meshIndex : group) {
+            MeshData const& mesh = meshes[meshIndex];
+
+            SdfPath instancePath = instancesPath.AppendChild(TfToken(TfStringPrintf("Instance_%zu", instanceCount++)));
+            SdfPrimSpecHandle instanceSpec = CreatePrimSpec(sessionLayer, instancePath, SdfSpecifierDef, "Xform");
+            instanceSpec->SetInstanceable(true);
+            instanceSpec->GetReferenceList().Prepend(SdfReference(std::string(), prototypePath));
+
+            SdfAttributeSpecHandle transform = SdfAttributeSpec::New(
+                instanceSpec, instanceOpOrder[0].GetString(), SdfValueTypeNames->Matrix4d);
+            if (transform) {
+                transform->SetDefaultValue(VtValue(xformCache.GetLocalToWorldTransform(mesh.prim) * parentInverse));
+            }
+            SetXformOpOrder(instanceSpec, instanceOpOrder);
+
+            _Deactivated deactivated;
+            deactivated.path = mesh.prim.GetPath();
+            SdfPrimSpecHandle spec = sessionLayer->GetPrimAtPath(deactivated.path);
+            if (spec && spec->HasActive()) {
+                deactivated.sessionActive = VtValue(spec->GetActive());
+            } else if (!spec) {
+                spec = SdfCreatePrimInLayer(sessionLayer, deactivated.path);
+            }
+            spec->SetActive(false);
+            m_meshPaths.Insert(deactivated.path);
+            m_deactivated.push_back(std::move(deactivated));
+        }
+
+        m_meshCount += group.size();
+        m_bytesSaved += (group.size() - 1) * representative.byteSize;
+    }
+
+    m_prototypeCount = groups.size();
+    m_bytesKept -= m_bytesSaved;
+    m_stage = stage;
+    m_scopePath = scopePath;
+}
+
+bool HdRprMeshDeduplicator::IsAffectedBy(SdfPath const& path) const {
+    if (!IsApplied()) {
+        return false;
+    }
+
+    SdfPath primPath = path.GetPrimPath();
+    if (m_meshPaths.IsCovered(primPath)) {
+        return true;
+    }
+
+    // Draw modes authored on ancestor models don't reach the instances
+    if (path.IsPropertyPath() && TfStringStartsWith(path.GetName(), "model:")) {
+        return false;
+    }
+    return m_meshPaths.Intersects(primPath);
+}
+
+void HdRprMeshDeduplicator::Restore() {
+    UsdStageRefPtr stage = m_stage;
+    if (stage && IsApplied()) {
+        SdfLayerHandle sessionLayer = stage->GetSessionLayer();
+
+        SdfChangeBlock changeBlock;
+        for (auto const& deactivated : m_deactivated) {
+            SdfPrimSpecHandle spec = sessionLayer->GetPrimAtPath(deactivated.path);
+            if (!spec) {
+                continue;
+            }
+
+            if (deactivated.sessionActive.IsEmpty()) {
+                spec->ClearActive();
+                sessionLayer->RemovePrimIfInert(spec);
+            } else {
+                spec->SetActive(deactivated.sessionActive.Get<bool>());
+            }
+        }
+
+        if (SdfPrimSpecHandle scope = sessionLayer->GetPrimAtPath(m_scopePath)) {
+            scope->GetRealNameParent()->RemoveNameChild(scope);
+        }
+    }
+
+    m_deactivated.clear();
+    m_meshPaths.Clear();
+    m_stage = nullptr;
+    m_scopePath = SdfPath();
+    m_meshCount = 0;
+    m_prototypeCount = 0;
+    m_bytesSaved = 0;
+    m_bytesKept = 0;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,95 @@
+#ifndef HDRPR_MESH_DEDUPLICATOR_H
+#define HDRPR_MESH_DEDUPLICATOR_H
+
+#include "api.h"
+
+#include "pxr/rprImaging/rprEngine/pathTrie.h"
+
+#include "pxr/usd/usd/common.h"
+#include "pxr/usd/usd/prim.h"
+#include "pxr/usd/sdf/path.h"
+#include "pxr/base/vt/value.h"
+
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class HdRprMeshDeduplicator
+///
+/// Finds meshes that are authored as separate prims but are identical apart
+/// from their transform, and turns every group of them into native USD
+/// instances of a single prototype. The instances are authored into the
+/// stage session layer under a scope below the engine root and the original
+/// meshes are deactivated there, so UsdImaging hands the render delegate one
+/// mesh per group plus an instancer.
+///
+/// Only static meshes qualify: any time-varying attribute or transform, an
+/// inherited primvar, a non-default purpose or children other than geometry
+/// subsets keep a mesh as it is.
+///
+class HdRprMeshDeduplicator {
+public:
+    HDRPR_API
+    HdRprMeshDeduplicator();
+
+    HDRPR_API
+    ~HdRprMeshDeduplicator();
+
+    /// Deduplicate the meshes under \p root that neither \p excludedPaths
+    /// nor \p hiddenPaths cover. Instances are authored under \p scopePath,
+    /// which must be a descendant of \p root.
+    HDRPR_API
+    void Apply(UsdPrim const& root,
+               HdRprPathTrie const& excludedPaths,
+               HdRprPathTrie const& hiddenPaths,
+               SdfPath const& scopePath);
+
+    /// Remove everything Apply() authored.
+    HDRPR_API
+    void Restore();
+
+    bool IsApplied() const { return !m_scopePath.IsEmpty(); }
+
+    /// Returns true if a change to \p path, a prim or property path, may
+    /// leave the applied deduplication stale. Prototypes reference their
+    /// representative, the other meshes are deactivated and the transforms
+    /// of all of them are baked into the instances, so this is the case for
+    /// changes on or below a deduplicated mesh and on its ancestors.
+    HDRPR_API
+    bool IsAffectedBy(SdfPath const& path) const;
+
+    /// Number of meshes replaced by instances.
+    size_t GetMeshCount() const { return m_meshCount; }
+
+    /// Number of prototypes the replaced meshes share.
+    size_t GetPrototypeCount() const { return m_prototypeCount; }
+
+    /// Size of the mesh data that is no longer duplicated.
+    size_t GetBytesSaved() const { return m_bytesSaved; }
+
+    /// Size of the mesh data of all meshes the deduplicator looked at, after
+    /// deduplication.
+    size_t GetBytesKept() const { return m_bytesKept; }
+
+private:
+    struct _Deactivated {
+        SdfPath path;
+
+        // Session layer opinion before the deduplicator overrode it
+        VtValue sessionActive;
+    };
+    std::vector<_Deactivated> m_deactivated;
+    // Paths of all deduplicated meshes, representatives included
+    HdRprPathTrie m_meshPaths;
+    UsdStageWeakPtr m_stage;
+    SdfPath m_scopePath;
+
+    size_t m_meshCount;
+    size_t m_prototypeCount;
+    size_t m_bytesSaved;
+    size_t m_bytesKept;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_MESH_DEDUPLICATOR_H
@@ -0,0 +1,190 @@
+#include "pxr/rprImaging/rprEngine/pathTrie.h"
+
+#include "pxr/base/tf/diagnostic.h"
+
+#include <algorithm>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+
+bool IsValidPath(SdfPath const& path) {
+    if (!path.IsAbsolutePath() || !path.IsAbsoluteRootOrPrimPath()) {
+        TF_CODING_ERROR("<%s> is not an absolute prim path", path.GetText());
+        return false;
+    }
+    return true;
+}
+
+} // namespace anonymous
+
+HdRprPathTrie::HdRprPathTrie()
+    : m_size(0) {
+
+}
+
+HdRprPathTrie::~HdRprPathTrie() = default;
+
+bool HdRprPathTrie::Insert(SdfPath const& path) {
+    if (!IsValidPath(path)) {
+        return false;
+    }
+
+    bool isCovered = m_root.isMember;
+    _Node* node = &m_root;
+    for (SdfPath const& prefix : path.GetPrefixes()) {
+        auto& child = node->children[prefix.GetNameToken()];
+        if (!child) {
+            child.reset(new _Node);
+        }
+        node = child.get();
+        isCovered = isCovered || (node->isMember && prefix != path);
+    }
+
+    if (node->isMember) {
+        return false;
+    }
+
+    node->isMember = true;
+    ++m_size;
+    return !isCovered;
+}
+
+bool HdRprPathTrie::Erase(SdfPath const& path) {
+    if (!IsValidPath(path)) {
+        return false;
+    }
+
+    if (path.IsAbsoluteRootPath()) {
+        if (!m_root.isMember) {
+            return false;
+        }
+        m_root.isMember = false;
+        --m_size;
+        return true;
+    }
+
+    size_t oldSize = m_size;
+    bool isCovered = m_root.isMember;
+    _Erase(&m_root, path.GetPrefixes(), 0, &isCovered);
+    return m_size != oldSize && !isCovered;
+}
+
+void HdRprPathTrie::_Erase(
+    _Node* node,
+    SdfPathVector const& prefixes,
+    size_t depth,
+    bool* isCovered) {
+    auto it = node->children.find(prefixes[depth].GetNameToken());
+    if (it == node->children.end()) {
+        return;
+    }
+
+    _Node* child = it->second.get();
+    if (depth + 1 == prefixes.size()) {
+        if (child->isMember) {
+            child->isMember = false;
+            --m_size;
+        }
+    } else {
+        *isCovered = *isCovered || child->isMember;
+        _Erase(child, prefixes, depth + 1, isCovered);
+    }
+
+    // Prune branches that lead to no member
+    if (!child->isMember && child->children.empty()) {
+        node->children.erase(it);
+    }
+}
+
+void HdRprPathTrie::Clear() {
+    m_root.children.clear();
+    m_root.isMember = false;
+    m_size = 0;
+}
+
+bool HdRprPathTrie::Contains(SdfPath const& path) const {
+    if (path.IsAbsoluteRootPath()) {
+        return m_root.isMember;
+    }
+
+    _Node const* node = &m_root;
+    for (SdfPath const& prefix : path.GetPrefixes()) {
+        auto it = node->children.find(prefix.GetNameToken());
+        if (it == node->children.end()) {
+            return false;
+        }
+        node = it->second.get();
+    }
+    return node->isMember;
+}
+
+bool HdRprPathTrie::IsCovered(SdfPath const& path) const {
+    _Node const* node = &m_root;
+    if (node->isMember) {
+        return true;
+    }
+
+    for (SdfPath const& prefix : path.GetPrefixes()) {
+        auto it = node->children.find(prefix.GetNameToken());
+        if (it == node->children.end()) {
+            return false;
+        }
+        node = it->second.get();
+        if (node->isMember) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HdRprPathTrie::Intersects(SdfPath const& path) const {
+    if (path.IsAbsoluteRootPath()) {
+        return m_size > 0;
+    }
+
+    _Node const* node = &m_root;
+    for (SdfPath const& prefix : path.GetPrefixes()) {
+        if (node->isMember) {
+            return true;
+        }
+        auto it = node->children.find(prefix.GetNameToken());
+        if (it == node->children.end()) {
+            return false;
+        }
+        node = it->second.get();
+    }
+
+    // Branches that lead to no member are pruned, so the node of the path
+    // is either a member or has one below it
+    return true;
+}
+
+SdfPathVector HdRprPathTrie::GetCover() const {
+    SdfPathVector cover;
+    if (m_root.isMember) {
+        cover.push_back(SdfPath::AbsoluteRootPath());
+        return cover;
+    }
+
+    std::vector<std::pair<_Node const*, SdfPath>> stack{{&m_root, SdfPath::AbsoluteRootPath()}};
+    while (!stack.empty()) {
+        _Node const* node = stack.back().first;
+        SdfPath path = std::move(stack.back().second);
+        stack.pop_back();
+
+        for (auto const& entry : node->children) {
+            SdfPath childPath = path.AppendChild(entry.first);
+            if (entry.second->isMember) {
+                cover.push_back(std::move(childPath));
+            } else {
+                stack.emplace_back(entry.second.get(), std::move(childPath));
+            }
+        }
+    }
+
+    std::sort(cover.begin(), cover.end());
+    return cover;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
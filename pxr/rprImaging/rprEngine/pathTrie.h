@@ -0,0 +1,78 @@
+#ifndef HDRPR_PATH_TRIE_H
+#define HDRPR_PATH_TRIE_H
+
+#include "api.h"
+
+#include "pxr/usd/sdf/path.h"
+#include "pxr/base/tf/hashmap.h"
+#include "pxr/base/tf/token.h"
+
+#include <memory>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class HdRprPathTrie
+///
+/// A set of absolute prim paths stored as a prefix tree of path elements.
+/// Insertion, removal and the test whether a path or any of its ancestors
+/// is in the set take time proportional to the depth of the path rather
+/// than the size of the set.
+///
+class HdRprPathTrie {
+public:
+    HDRPR_API
+    HdRprPathTrie();
+
+    HDRPR_API
+    ~HdRprPathTrie();
+
+    /// Add \p path to the set. Returns true if the minimal cover of the set,
+    /// see GetCover(), changed.
+    HDRPR_API
+    bool Insert(SdfPath const& path);
+
+    /// Remove \p path from the set. Returns true if the minimal cover of the
+    /// set changed.
+    HDRPR_API
+    bool Erase(SdfPath const& path);
+
+    HDRPR_API
+    void Clear();
+
+    /// Returns true if \p path itself is in the set.
+    HDRPR_API
+    bool Contains(SdfPath const& path) const;
+
+    /// Returns true if \p path or any of its ancestors is in the set.
+    HDRPR_API
+    bool IsCovered(SdfPath const& path) const;
+
+    /// Returns true if \p path, any of its ancestors or any of its
+    /// descendants is in the set.
+    HDRPR_API
+    bool Intersects(SdfPath const& path) const;
+
+    /// Returns the sorted paths of the set that don't have an ancestor in
+    /// the set. These cover the same prims as the whole set.
+    HDRPR_API
+    SdfPathVector GetCover() const;
+
+    bool IsEmpty() const { return m_size == 0; }
+    size_t GetSize() const { return m_size; }
+
+private:
+    struct _Node {
+        TfHashMap<TfToken, std::unique_ptr<_Node>, TfToken::HashFunctor> children;
+        bool isMember = false;
+    };
+
+    void _Erase(_Node* node, SdfPathVector const& prefixes, size_t depth, bool* isCovered);
+
+private:
+    _Node m_root;
+    size_t m_size;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_PATH_TRIE_H
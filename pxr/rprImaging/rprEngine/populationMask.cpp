@@ -0,0 +1,193 @@
+#include "pxr/rprImaging/rprEngine/populationMask.h"
+
+#include "pxr/usd/usd/prim.h"
+#include "pxr/usd/usd/relationship.h"
+#include "pxr/usd/pcp/primIndex.h"
+#include "pxr/base/tf/stringUtils.h"
+
+#include <algorithm>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+
+// Child of the last prim on the way to an exclusion that doesn't exist, so
+// that the prims on the way are composed without any of their children
+TfToken const& GetProbeName() {
+    static TfToken name("__HdRprPopulationMaskProbe");
+    return name;
+}
+
+struct MaskRoot {
+    SdfPath path;
+    // Excluded paths strictly under path
+    SdfPathVector exclusions;
+};
+
+// Roots from \p includedPaths that \p mask doesn't already include
+std::vector<MaskRoot> GetMaskRoots(
+    UsdStagePopulationMask const& mask,
+    SdfPathVector const& includedPaths,
+    SdfPathVector const& excludedPaths) {
+    SdfPathVector paths = includedPaths;
+    if (paths.empty()) {
+        paths.push_back(SdfPath::AbsoluteRootPath());
+    }
+    std::sort(paths.begin(), paths.end());
+
+    std::vector<MaskRoot> roots;
+    for (SdfPath const& path : paths) {
+        // Sorted, any root under the previous one directly follows it
+        if (!roots.empty() && path.HasPrefix(roots.back().path)) {
+            continue;
+        }
+        if (mask.IncludesSubtree(path)) {
+            continue;
+        }
+
+        MaskRoot root;
+        root.path = path;
+        bool isExcluded = false;
+        for (SdfPath const& excludedPath : excludedPaths) {
+            if (path.HasPrefix(excludedPath)) {
+                isExcluded = true;
+                break;
+            }
+            if (excludedPath.HasPrefix(path)) {
+                root.exclusions.push_back(excludedPath);
+            }
+        }
+        if (!isExcluded) {
+            roots.push_back(std::move(root));
+        }
+    }
+    return roots;
+}
+
+// Adds probes for the prims on the way to exclusions that \p stage didn't
+// compose yet
+void AddProbes(UsdStageRefPtr const& stage, std::vector<MaskRoot> const& roots, UsdStagePopulationMask* mask) {
+    for (MaskRoot const& root : roots) {
+        for (SdfPath const& excludedPath : root.exclusions) {
+            SdfPath parentPath = excludedPath.GetParentPath();
+            if (!stage || !stage->GetPrimAtPath(parentPath)) {
+                mask->Add(parentPath.AppendChild(GetProbeName()));
+            }
+        }
+    }
+}
+
+// Adds \p path to \p mask without the \p exclusions under it. The prims on
+// the way to the exclusions must be composed.
+void AddSubtree(
+    UsdStageRefPtr const& stage,
+    SdfPath const& path,
+    SdfPathVector const& exclusions,
+    UsdStagePopulationMask* mask) {
+    if (exclusions.empty()) {
+        mask->Add(path);
+        return;
+    }
+
+    UsdPrim prim = stage->GetPrimAtPath(path);
+    if (!prim) {
+        return;
+    }
+    // Instance proxies can't be masked separately
+    if (prim.IsInstance()) {
+        mask->Add(path);
+        return;
+    }
+
+    TfTokenVector childNames;
+    PcpTokenSet prohibitedNames;
+    prim.GetPrimIndex().ComputePrimChildNames(&childNames, &prohibitedNames);
+
+    for (TfToken const& childName : childNames) {
+        SdfPath childPath = path.AppendChild(childName);
+
+        bool isExcluded = false;
+        SdfPathVector childExclusions;
+        for (SdfPath const& excludedPath : exclusions) {
+            if (childPath.HasPrefix(excludedPath)) {
+                isExcluded = true;
+                break;
+            }
+            if (excludedPath.HasPrefix(childPath)) {
+                childExclusions.push_back(excludedPath);
+            }
+        }
+        if (!isExcluded) {
+            AddSubtree(stage, childPath, childExclusions, mask);
+        }
+    }
+}
+
+bool IsExpandedRelationship(UsdRelationship const& relationship) {
+    return !TfStringStartsWith(relationship.GetName().GetString(), "collection:");
+}
+
+} // namespace anonymous
+
+UsdStageRefPtr HdRprOpenMaskedStage(
+    std::string const& filePath,
+    SdfPathVector const& includedPaths,
+    SdfPathVector const& excludedPaths,
+    UsdStage::InitialLoadSet load) {
+    // Opened with the roots without exclusions and the prims on the way to
+    // exclusions, the rest is added by widening
+    UsdStagePopulationMask mask;
+    std::vector<MaskRoot> roots = GetMaskRoots(mask, includedPaths, excludedPaths);
+    for (MaskRoot const& root : roots) {
+        if (root.exclusions.empty()) {
+            mask.Add(root.path);
+        }
+    }
+    AddProbes(nullptr, roots, &mask);
+
+    UsdStageRefPtr stage = UsdStage::OpenMasked(filePath, mask, load);
+    if (stage) {
+        HdRprWidenPopulationMask(stage, includedPaths, excludedPaths);
+    }
+    return stage;
+}
+
+bool HdRprWidenPopulationMask(
+    UsdStageRefPtr const& stage,
+    SdfPathVector const& includedPaths,
+    SdfPathVector const& excludedPaths) {
+    if (!stage) {
+        return false;
+    }
+
+    UsdStagePopulationMask mask = stage->GetPopulationMask();
+    std::vector<MaskRoot> roots = GetMaskRoots(mask, includedPaths, excludedPaths);
+    if (roots.empty()) {
+        return false;
+    }
+
+    UsdStagePopulationMask probeMask = mask;
+    AddProbes(stage, roots, &probeMask);
+    bool isProbing = probeMask != mask;
+    if (isProbing) {
+        stage->SetPopulationMask(probeMask);
+    }
+
+    UsdStagePopulationMask widenedMask = mask;
+    for (MaskRoot const& root : roots) {
+        AddSubtree(stage, root.path, root.exclusions, &widenedMask);
+    }
+
+    if (mask.Includes(widenedMask)) {
+        if (isProbing) {
+            stage->SetPopulationMask(mask);
+        }
+        return false;
+    }
+
+    stage->SetPopulationMask(widenedMask);
+    stage->ExpandPopulationMask(IsExpandedRelationship);
+    return true;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
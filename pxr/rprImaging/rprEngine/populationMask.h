@@ -0,0 +1,42 @@
+#ifndef HDRPR_POPULATION_MASK_H
+#define HDRPR_POPULATION_MASK_H
+
+#include "api.h"
+
+#include "pxr/usd/usd/stage.h"
+#include "pxr/usd/usd/stagePopulationMask.h"
+#include "pxr/usd/sdf/path.h"
+
+#include <string>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+// Population masks can only include subtrees, so the prims on the way from
+// an included path to an excluded one are included without children, and
+// their other children are included instead. Listing those children needs
+// the prims on the way composed, which the functions below do through an
+// intermediate mask that includes them alone.
+//
+// Relationship targets and attribute connections of the included prims,
+// such as bound materials, are added to the mask as well, apart from the
+// targets of collections, which usually point at whole scenes.
+
+/// Opens the stage of \p filePath with only the prims under
+/// \p includedPaths that are not under \p excludedPaths.
+HDRPR_API
+UsdStageRefPtr HdRprOpenMaskedStage(std::string const& filePath,
+                                    SdfPathVector const& includedPaths,
+                                    SdfPathVector const& excludedPaths,
+                                    UsdStage::InitialLoadSet load = UsdStage::LoadAll);
+
+/// Adds the prims under \p includedPaths that are not under
+/// \p excludedPaths to the population of \p stage. Returns false if the
+/// population already contained them.
+HDRPR_API
+bool HdRprWidenPopulationMask(UsdStageRefPtr const& stage,
+                              SdfPathVector const& includedPaths,
+                              SdfPathVector const& excludedPaths);
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_POPULATION_MASK_H
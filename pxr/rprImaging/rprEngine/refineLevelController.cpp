@@ -0,0 +1,202 @@
+#include "pxr/rprImaging/rprEngine/refineLevelController.h"
+#include "pxr/rprImaging/rprEngine/screenSpace.h"
+
+#include "pxr/usd/usd/primRange.h"
+#include "pxr/usd/usd/stage.h"
+#include "pxr/usd/usdGeom/bboxCache.h"
+#include "pxr/usd/usdGeom/mesh.h"
+#include "pxr/usd/usdGeom/tokens.h"
+#include "pxr/base/tf/hashmap.h"
+
+#include <algorithm>
+#include <cmath>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+
+// Projected size in pixels at which a mesh gets the maximum refine level
+const double kFullDetailSize = 512.0;
+
+// Fraction of a level the projected size has to go past a level boundary
+// before the level changes
+const double kHysteresis = 0.25;
+
+size_t GetTriangleCount(size_t baseTriangleCount, size_t faceVertexCount, int level) {
+    if (level <= 0) {
+        return baseTriangleCount;
+    }
+
+    // The first Catmull-Clark subdivision splits every n-gon into n quads,
+    // each following one splits every quad into four
+    return 2 * faceVertexCount * (size_t(1) << (2 * (level - 1)));
+}
+
+} // namespace anonymous
+
+HdRprRefineLevelController::HdRprRefineLevelController()
+    : m_meshesValid(false)
+    , m_boundsValid(false)
+    , m_viewProjection(1.0)
+    , m_viewportSize(0)
+    , m_maxRefineLevel(-1)
+    , m_trianglesSaved(0) {
+
+}
+
+void HdRprRefineLevelController::Invalidate() {
+    m_meshesValid = false;
+    m_boundsValid = false;
+}
+
+void HdRprRefineLevelController::Update(
+    DelegateForPath const& delegateForPath,
+    UsdPrim const& root,
+    HdRprPathTrie const& excludedPaths,
+    UsdTimeCode frame,
+    GfMatrix4d const& viewProjection,
+    GfVec2i const& viewportSize,
+    int maxRefineLevel) {
+    if (!delegateForPath || !root) {
+        return;
+    }
+
+    if (!m_meshesValid) {
+        TfHashMap<SdfPath, int, SdfPath::Hash> oldLevels;
+        for (auto const& mesh : m_meshes) {
+            if (mesh.level >= 0) {
+                oldLevels[mesh.path] = mesh.level;
+            }
+        }
+
+        _GatherMeshes(root, excludedPaths);
+
+        // Keep levels of meshes that are still there, drop the others
+        for (auto& mesh : m_meshes) {
+            auto it = oldLevels.find(mesh.path);
+            if (it != oldLevels.end()) {
+                mesh.level = it->second;
+                oldLevels.erase(it);
+            }
+        }
+        for (auto const& entry : oldLevels) {
+            if (UsdImagingDelegate* delegate = delegateForPath(entry.first)) {
+                delegate->ClearRefineLevel(entry.first);
+            }
+        }
+        m_boundsValid = false;
+    }
+
+    if (!m_boundsValid || frame != m_boundsFrame) {
+        _ComputeBounds(frame);
+        m_boundsFrame = frame;
+        m_boundsValid = true;
+    } else if (viewProjection == m_viewProjection &&
+               viewportSize == m_viewportSize &&
+               maxRefineLevel == m_maxRefineLevel) {
+        return;
+    }
+
+    m_viewProjection = viewProjection;
+    m_viewportSize = viewportSize;
+    m_maxRefineLevel = maxRefineLevel;
+
+    size_t fullTriangleCount = 0;
+    size_t triangleCount = 0;
+    for (auto& mesh : m_meshes) {
+        double size = HdRprComputeProjectedSize(mesh.bound, viewProjection, viewportSize);
+        double targetLevel = maxRefineLevel - std::log2(kFullDetailSize / std::max(size, 1e-3));
+
+        int level = mesh.level;
+        if (level < 0 || level > maxRefineLevel ||
+            targetLevel < level - kHysteresis ||
+            targetLevel >= level + 1 + kHysteresis) {
+            level = int(std::min(std::max(std::floor(targetLevel), 0.0), double(maxRefineLevel)));
+        }
+
+        if (level != mesh.level) {
+            if (UsdImagingDelegate* delegate = delegateForPath(mesh.path)) {
+                delegate->SetRefineLevel(mesh.path, level);
+            }
+            mesh.level = level;
+        }
+
+        fullTriangleCount += GetTriangleCount(mesh.triangleCount, mesh.faceVertexCount, maxRefineLevel);
+        triangleCount += GetTriangleCount(mesh.triangleCount, mesh.faceVertexCount, level);
+    }
+    m_trianglesSaved = fullTriangleCount > triangleCount ? fullTriangleCount - triangleCount : 0;
+}
+
+void HdRprRefineLevelController::Clear(DelegateForPath const& delegateForPath) {
+    for (auto& mesh : m_meshes) {
+        if (mesh.level >= 0) {
+            if (UsdImagingDelegate* delegate = delegateForPath ? delegateForPath(mesh.path) : nullptr) {
+                delegate->ClearRefineLevel(mesh.path);
+            }
+            mesh.level = -1;
+        }
+    }
+
+    // Force the next update to assign levels again
+    m_maxRefineLevel = -1;
+    m_trianglesSaved = 0;
+}
+
+void HdRprRefineLevelController::_GatherMeshes(
+    UsdPrim const& root,
+    HdRprPathTrie const& excludedPaths) {
+    m_meshes.clear();
+
+    UsdPrimRange range(root);
+    for (auto it = range.begin(); it != range.end(); ++it) {
+        SdfPath const& path = it->GetPath();
+        if (excludedPaths.IsCovered(path)) {
+            it.PruneChildren();
+            continue;
+        }
+
+        UsdGeomMesh mesh(*it);
+        if (!mesh) {
+            continue;
+        }
+
+        TfToken scheme;
+        mesh.GetSubdivisionSchemeAttr().Get(&scheme);
+        if (scheme == UsdGeomTokens->none) {
+            continue;
+        }
+
+        VtIntArray faceVertexCounts;
+        mesh.GetFaceVertexCountsAttr().Get(&faceVertexCounts, UsdTimeCode::EarliestTime());
+
+        _Mesh entry;
+        entry.path = path;
+        for (int count : faceVertexCounts) {
+            entry.faceVertexCount += count;
+            entry.triangleCount += std::max(count - 2, 0);
+        }
+        m_meshes.push_back(std::move(entry));
+    }
+
+    m_meshesValid = true;
+    m_stage = root.GetStage();
+}
+
+void HdRprRefineLevelController::_ComputeBounds(UsdTimeCode frame) {
+    UsdStageRefPtr stage = m_stage;
+    if (!stage) {
+        return;
+    }
+
+    UsdGeomBBoxCache bboxCache(frame, {UsdGeomTokens->default_, UsdGeomTokens->render},
+                               /* useExtentsHint = */ true);
+    for (auto& mesh : m_meshes) {
+        if (UsdPrim prim = stage->GetPrimAtPath(mesh.path)) {
+            mesh.bound = bboxCache.ComputeWorldBound(prim);
+        } else {
+            mesh.bound = GfBBox3d();
+        }
+    }
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
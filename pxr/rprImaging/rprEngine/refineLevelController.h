@@ -0,0 +1,93 @@
+#ifndef HDRPR_REFINE_LEVEL_CONTROLLER_H
+#define HDRPR_REFINE_LEVEL_CONTROLLER_H
+
+#include "api.h"
+
+#include "pxr/rprImaging/rprEngine/pathTrie.h"
+
+#include "pxr/usdImaging/usdImaging/delegate.h"
+#include "pxr/usd/usd/common.h"
+#include "pxr/usd/usd/prim.h"
+#include "pxr/usd/usd/timeCode.h"
+#include "pxr/usd/sdf/path.h"
+#include "pxr/base/gf/bbox3d.h"
+#include "pxr/base/gf/matrix4d.h"
+#include "pxr/base/gf/vec2i.h"
+
+#include <functional>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class HdRprRefineLevelController
+///
+/// Assigns refine levels to subdivision meshes from their projected size on
+/// screen. Meshes covering the full-detail size get the maximum level, each
+/// halving of the screen size drops one level. A mesh keeps its level until
+/// its size leaves the level's range by a hysteresis margin, so meshes near a
+/// boundary don't get re-refined every frame.
+///
+class HdRprRefineLevelController {
+public:
+    /// Returns the scene delegate that populated the mesh at a stage path.
+    using DelegateForPath = std::function<UsdImagingDelegate*(SdfPath const&)>;
+
+    HDRPR_API
+    HdRprRefineLevelController();
+
+    /// Forget the gathered meshes, e.g. after the stage was resynced.
+    HDRPR_API
+    void Invalidate();
+
+    /// Assign refine levels to the subdivision meshes under \p root. Levels
+    /// are pushed to the delegate of each mesh only when they change.
+    HDRPR_API
+    void Update(DelegateForPath const& delegateForPath,
+                UsdPrim const& root,
+                HdRprPathTrie const& excludedPaths,
+                UsdTimeCode frame,
+                GfMatrix4d const& viewProjection,
+                GfVec2i const& viewportSize,
+                int maxRefineLevel);
+
+    /// Remove all assigned levels from the delegates so the fallback level
+    /// applies again. Without \p delegateForPath the levels are only
+    /// forgotten, e.g. when the delegates were destroyed.
+    HDRPR_API
+    void Clear(DelegateForPath const& delegateForPath);
+
+    size_t GetMeshCount() const { return m_meshes.size(); }
+
+    /// Estimated number of triangles not generated compared to refining all
+    /// meshes to the maximum level.
+    size_t GetTrianglesSaved() const { return m_trianglesSaved; }
+
+private:
+    void _GatherMeshes(UsdPrim const& root, HdRprPathTrie const& excludedPaths);
+    void _ComputeBounds(UsdTimeCode frame);
+
+private:
+    struct _Mesh {
+        SdfPath path;
+        GfBBox3d bound;
+        size_t faceVertexCount = 0;
+        size_t triangleCount = 0;
+        int level = -1;
+    };
+    std::vector<_Mesh> m_meshes;
+    bool m_meshesValid;
+    UsdStageWeakPtr m_stage;
+
+    UsdTimeCode m_boundsFrame;
+    bool m_boundsValid;
+
+    GfMatrix4d m_viewProjection;
+    GfVec2i m_viewportSize;
+    int m_maxRefineLevel;
+
+    size_t m_trianglesSaved;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_REFINE_LEVEL_CONTROLLER_H
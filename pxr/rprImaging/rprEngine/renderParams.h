@@ -2,6 +2,7 @@
 #define HDRPR_ENGINE_RENDER_PARAMS_H
 
 #include "pxr/usd/usd/timeCode.h"
+#include "pxr/usd/usdGeom/tokens.h"
 #include "pxr/base/gf/vec4d.h"
 #include "pxr/base/gf/vec4f.h"
 #include "pxr/base/tf/token.h"
@@ -24,13 +25,31 @@ struct HdRprEngineRenderParams {
     bool enableUsdDrawModes = true;
     GfVec4f clearColor = GfVec4f(0, 0, 0, 1);
 
+    // Relative luminance error below which the color AOV is considered
+    // converged. Zero disables the engine-side estimation.
+    float convergenceThreshold = 0.0f;
+
+    // Derive per-prim refine levels of subdivision meshes from their size
+    // on screen, with refineLevel being the maximum.
+    bool adaptiveRefineLevel = false;
+
+    // Projected size in pixels below which models are drawn with
+    // drawModeLodMode instead of their geometry. Zero disables it, as does
+    // disabling enableUsdDrawModes.
+    float drawModeLodThreshold = 0.0f;
+    TfToken drawModeLodMode = UsdGeomTokens->bounds;
+
     bool operator==(const HdRprEngineRenderParams &other) const {
         return frame                == other.frame &&
                refineLevel          == other.refineLevel &&
                clipPlanes           == other.clipPlanes &&
                enableSceneMaterials == other.enableSceneMaterials &&
                enableUsdDrawModes   == other.enableUsdDrawModes &&
-               clearColor           == other.clearColor;
+               clearColor           == other.clearColor &&
+               convergenceThreshold == other.convergenceThreshold &&
+               adaptiveRefineLevel  == other.adaptiveRefineLevel &&
+               drawModeLodThreshold == other.drawModeLodThreshold &&
+               drawModeLodMode      == other.drawModeLodMode;
     }
 
     bool operator!=(const HdRprEngineRenderParams &other) const { return !(*this == other); }
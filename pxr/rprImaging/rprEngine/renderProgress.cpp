@@ -0,0 +1,81 @@
+#include "pxr/rprImaging/rprEngine/renderProgress.h"
+
+#include "pxr/base/arch/defines.h"
+
+#include <algorithm>
+
+#if defined(ARCH_OS_WINDOWS)
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+
+// Renderers don't agree on the names, the first key present is used
+const char* const kSampleKeys[] = {"numCompletedSamples", "numSamples", "samples"};
+const char* const kPercentDoneKeys[] = {"percentDone"};
+const char* const kPeakMemoryKeys[] = {"peakMemory", "memoryUsed"};
+
+template <size_t N>
+bool GetNumber(VtDictionary const& dictionary, const char* const (&keys)[N], double* number) {
+    for (const char* key : keys) {
+        auto it = dictionary.find(key);
+        if (it == dictionary.end()) {
+            continue;
+        }
+
+        VtValue value = it->second;
+        if (value.CanCast<double>()) {
+            *number = value.Cast<double>().UncheckedGet<double>();
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace anonymous
+
+int HdRprReadRenderStats(VtDictionary const& renderStats, HdRprRenderProgress* progress) {
+    int found = 0;
+    double number;
+    if (GetNumber(renderStats, kSampleKeys, &number) && number >= 0.0) {
+        progress->samplesCompleted = size_t(number);
+        found |= HdRprRenderStatsSamples;
+    }
+    if (GetNumber(renderStats, kPercentDoneKeys, &number)) {
+        progress->percentDone = std::min(std::max(float(number), 0.0f), 100.0f);
+        found |= HdRprRenderStatsPercentDone;
+    }
+    if (GetNumber(renderStats, kPeakMemoryKeys, &number) && number >= 0.0) {
+        progress->peakMemory = size_t(number);
+        found |= HdRprRenderStatsPeakMemory;
+    }
+    return found;
+}
+
+size_t HdRprGetPeakResidentMemory() {
+#if defined(ARCH_OS_WINDOWS)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return size_t(counters.PeakWorkingSetSize);
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(ARCH_OS_DARWIN)
+    return size_t(usage.ru_maxrss);
+#else
+    // Linux reports kilobytes
+    return size_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,59 @@
+#ifndef HDRPR_RENDER_PROGRESS_H
+#define HDRPR_RENDER_PROGRESS_H
+
+#include "api.h"
+
+#include "pxr/base/vt/dictionary.h"
+
+#include <cstddef>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class HdRprRenderProgress
+///
+/// Progress of the accumulation of the current view, as of the end of the
+/// last RenderBatch() call. Restarts whenever accumulation does.
+///
+struct HdRprRenderProgress {
+    // Samples per pixel accumulated so far. Counts frames when the renderer
+    // doesn't report samples.
+    size_t samplesCompleted = 0;
+    double samplesPerSecond = 0.0;
+
+    // Estimated completion from 0 to 100, from the renderer if it reports
+    // it, otherwise from the convergence error or the maxSamples setting
+    float percentDone = 0.0f;
+
+    // Seconds since accumulation started, and the estimated seconds until
+    // it completes, negative while unknown
+    double elapsedTime = 0.0;
+    double estimatedTimeRemaining = -1.0;
+
+    // Peak memory in bytes, as reported by the renderer or else the peak
+    // resident memory of the process
+    size_t peakMemory = 0;
+
+    bool converged = false;
+};
+
+/// Fields of HdRprRenderProgress a renderer may report.
+enum HdRprRenderStatsFields {
+    HdRprRenderStatsSamples = 1 << 0,
+    HdRprRenderStatsPercentDone = 1 << 1,
+    HdRprRenderStatsPeakMemory = 1 << 2
+};
+
+/// Fills the fields of \p progress that \p renderStats, the dictionary of
+/// HdRenderDelegate::GetRenderStats(), has values for. Returns the mask of
+/// HdRprRenderStatsFields that were found.
+HDRPR_API
+int HdRprReadRenderStats(VtDictionary const& renderStats, HdRprRenderProgress* progress);
+
+/// Returns the peak resident memory of the process in bytes, or 0 if the
+/// platform doesn't tell.
+HDRPR_API
+size_t HdRprGetPeakResidentMemory();
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_RENDER_PROGRESS_H
@@ -0,0 +1,225 @@
+#include "pxr/rprImaging/rprEngine/reprojector.h"
+#include "pxr/rprImaging/rprEngine/aovImage.h"
+
+#include "pxr/base/gf/vec3d.h"
+#include "pxr/base/gf/vec4d.h"
+#include "pxr/base/work/loops.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+
+const uint64_t kNoSample = std::numeric_limits<uint64_t>::max();
+
+bool IsBackground(float depth) {
+    return !(depth < 1.0f);
+}
+
+GfVec4d PixelToNdc(int x, int y, float depth, int width, int height) {
+    return GfVec4d((x + 0.5) * 2.0 / width - 1.0,
+                   (y + 0.5) * 2.0 / height - 1.0,
+                   double(std::min(depth, 1.0f)) * 2.0 - 1.0,
+                   1.0);
+}
+
+// Keeps the smaller of the stored and the new value
+void AtomicMin(std::atomic<uint64_t>* target, uint64_t value) {
+    uint64_t current = target->load(std::memory_order_relaxed);
+    while (value < current &&
+           !target->compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace anonymous
+
+HdRprReprojector::HdRprReprojector()
+    : m_width(0)
+    , m_height(0)
+    , m_depthTolerance(0.02f)
+    , m_historyViewProjection(1.0) {
+
+}
+
+void HdRprReprojector::StoreHistory(
+    HdRprAovImage const& color,
+    HdRprAovImage const& depth,
+    GfMatrix4d const& viewProjection) {
+    if (color.IsEmpty() || depth.GetWidth() != color.GetWidth() || depth.GetHeight() != color.GetHeight()) {
+        Invalidate();
+        return;
+    }
+
+    m_width = color.GetWidth();
+    m_height = color.GetHeight();
+    m_historyViewProjection = viewProjection;
+
+    size_t pixelCount = size_t(m_width) * m_height;
+    m_historyColor.resize(pixelCount);
+    m_historyDepth.resize(pixelCount);
+    WorkParallelForN(size_t(m_height), [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; ++y) {
+            for (int x = 0; x < m_width; ++x) {
+                size_t i = y * m_width + x;
+                m_historyColor[i] = color.GetPixel(x, int(y));
+                m_historyDepth[i] = depth.GetPixel(x, int(y))[0];
+            }
+        }
+    });
+}
+
+void HdRprReprojector::Invalidate() {
+    m_historyColor.clear();
+    m_historyDepth.clear();
+    m_warpedColor.clear();
+    m_warpedValid.clear();
+}
+
+float HdRprReprojector::Warp(GfMatrix4d const& viewProjection, HdRprAovImage const& depth) {
+    m_warpedValid.clear();
+    if (!HasHistory() || depth.GetWidth() != m_width || depth.GetHeight() != m_height) {
+        return 0.0f;
+    }
+
+    size_t pixelCount = size_t(m_width) * m_height;
+    GfMatrix4d historyInverse = m_historyViewProjection.GetInverse();
+    GfMatrix4d inverse = viewProjection.GetInverse();
+
+    // Orthographic projections have the same clip w everywhere, depth is
+    // compared in window depth then
+    bool isPerspective = viewProjection[0][3] != 0.0 || viewProjection[1][3] != 0.0 ||
+                         viewProjection[2][3] != 0.0;
+
+    // Forward splat with a z-buffer. Keys hold the window depth in the high
+    // half, which orders as an integer for positive floats, so the nearest
+    // sample wins an atomic min. The low half is the source pixel.
+    std::unique_ptr<std::atomic<uint64_t>[]> zBuffer(new std::atomic<uint64_t>[pixelCount]);
+    std::vector<float> sampleViewDepth(pixelCount);
+    std::vector<float> sampleWindowDepth(pixelCount);
+    WorkParallelForN(pixelCount, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            zBuffer[i].store(kNoSample, std::memory_order_relaxed);
+        }
+    });
+
+    WorkParallelForN(pixelCount, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            int x = int(i % m_width);
+            int y = int(i / m_width);
+
+            GfVec4d world = PixelToNdc(x, y, m_historyDepth[i], m_width, m_height) * historyInverse;
+            if (world[3] == 0.0) {
+                continue;
+            }
+            GfVec4d clip = (world / world[3]) * viewProjection;
+            if (clip[3] <= 0.0) {
+                // Behind the new camera
+                continue;
+            }
+
+            GfVec3d ndc(clip[0] / clip[3], clip[1] / clip[3], clip[2] / clip[3]);
+            int px = int(std::floor((ndc[0] + 1.0) * 0.5 * m_width));
+            int py = int(std::floor((ndc[1] + 1.0) * 0.5 * m_height));
+            if (px < 0 || px >= m_width || py < 0 || py >= m_height || ndc[2] < -1.0 || ndc[2] > 1.0) {
+                continue;
+            }
+
+            float windowDepth = float((ndc[2] + 1.0) * 0.5);
+            sampleViewDepth[i] = float(clip[3]);
+            sampleWindowDepth[i] = windowDepth;
+
+            uint32_t depthBits;
+            std::memcpy(&depthBits, &windowDepth, sizeof(depthBits));
+            AtomicMin(&zBuffer[size_t(py) * m_width + px], (uint64_t(depthBits) << 32) | uint32_t(i));
+        }
+    });
+
+    // Resolve each pixel of the new view from its own sample, or from the
+    // nearest neighboring one to close the cracks of the forward splat, as
+    // long as the new depth confirms the sample is visible
+    m_warpedColor.resize(pixelCount);
+    m_warpedValid.assign(pixelCount, 0);
+    std::atomic<size_t> validCount(0);
+    WorkParallelForN(size_t(m_height), [&](size_t begin, size_t end) {
+        size_t localCount = 0;
+        for (size_t y = begin; y < end; ++y) {
+            for (int x = 0; x < m_width; ++x) {
+                float freshDepth = depth.GetPixel(x, int(y))[0];
+                bool freshBackground = IsBackground(freshDepth);
+
+                float freshViewDepth = 1.0f;
+                if (isPerspective && !freshBackground) {
+                    GfVec4d world = PixelToNdc(x, int(y), freshDepth, m_width, m_height) * inverse;
+                    freshViewDepth = world[3] != 0.0 ? float(1.0 / world[3]) : 0.0f;
+                }
+
+                auto accepts = [&](size_t source) {
+                    bool sampleBackground = IsBackground(m_historyDepth[source]);
+                    if (freshBackground || sampleBackground) {
+                        return freshBackground == sampleBackground;
+                    }
+                    if (isPerspective) {
+                        return std::abs(sampleViewDepth[source] - freshViewDepth) <= m_depthTolerance * freshViewDepth;
+                    }
+                    return std::abs(sampleWindowDepth[source] - freshDepth) <= m_depthTolerance;
+                };
+
+                size_t pixel = y * m_width + x;
+                uint64_t key = zBuffer[pixel].load(std::memory_order_relaxed);
+                if (key == kNoSample || !accepts(size_t(key & 0xffffffffu))) {
+                    key = kNoSample;
+                    for (int dy = -1; dy <= 1; ++dy) {
+                        for (int dx = -1; dx <= 1; ++dx) {
+                            int nx = x + dx;
+                            int ny = int(y) + dy;
+                            if ((dx == 0 && dy == 0) || nx < 0 || nx >= m_width || ny < 0 || ny >= m_height) {
+                                continue;
+                            }
+                            uint64_t neighborKey = zBuffer[size_t(ny) * m_width + nx].load(std::memory_order_relaxed);
+                            if (neighborKey < key && accepts(size_t(neighborKey & 0xffffffffu))) {
+                                key = neighborKey;
+                            }
+                        }
+                    }
+                }
+
+                if (key != kNoSample) {
+                    m_warpedColor[pixel] = m_historyColor[size_t(key & 0xffffffffu)];
+                    m_warpedValid[pixel] = 1;
+                    ++localCount;
+                }
+            }
+        }
+        validCount += localCount;
+    });
+
+    return float(validCount.load()) / float(pixelCount);
+}
+
+void HdRprReprojector::Blend(HdRprAovImage* color, float weight) const {
+    if (m_warpedValid.empty() || weight <= 0.0f ||
+        color->GetWidth() != m_width || color->GetHeight() != m_height) {
+        return;
+    }
+
+    WorkParallelForN(size_t(m_height), [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; ++y) {
+            for (int x = 0; x < m_width; ++x) {
+                size_t pixel = y * m_width + x;
+                if (!m_warpedValid[pixel]) {
+                    continue;
+                }
+                GfVec4f fresh = color->GetPixel(x, int(y));
+                color->SetPixel(x, int(y), fresh + (m_warpedColor[pixel] - fresh) * weight);
+            }
+        }
+    });
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,75 @@
+#ifndef HDRPR_REPROJECTOR_H
+#define HDRPR_REPROJECTOR_H
+
+#include "api.h"
+
+#include "pxr/base/gf/matrix4d.h"
+#include "pxr/base/gf/vec4f.h"
+
+#include <cstdint>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+class HdRprAovImage;
+
+/// \class HdRprReprojector
+///
+/// Reuses the last displayed frame after the camera changed. The color of
+/// the frame is forward-warped into the new view using its depth and both
+/// view-projection matrices, samples that the new depth shows to be
+/// disoccluded are rejected, and the rest is blended with the fresh samples
+/// with a weight that fades out while the new view accumulates.
+///
+/// Depth is expected as window depth in [0, 1], as Hydra depth AOVs are.
+///
+class HdRprReprojector {
+public:
+    HDRPR_API
+    HdRprReprojector();
+
+    /// Set the relative difference in view depth above which a warped
+    /// sample counts as disoccluded.
+    void SetDepthTolerance(float tolerance) { m_depthTolerance = tolerance; }
+
+    /// Keep \p color and \p depth, seen through \p viewProjection, as the
+    /// frame to warp on the next camera change.
+    HDRPR_API
+    void StoreHistory(HdRprAovImage const& color,
+                      HdRprAovImage const& depth,
+                      GfMatrix4d const& viewProjection);
+
+    /// Drop the history, e.g. after the scene changed.
+    HDRPR_API
+    void Invalidate();
+
+    bool HasHistory() const { return !m_historyColor.empty(); }
+
+    /// Warp the history into \p viewProjection. \p depth is the depth of
+    /// the new view, used to reject disocclusions. Returns the fraction of
+    /// pixels covered by the warped history.
+    HDRPR_API
+    float Warp(GfMatrix4d const& viewProjection, HdRprAovImage const& depth);
+
+    /// Blend the warped history into \p color with \p weight, 0 keeping
+    /// the fresh samples only.
+    HDRPR_API
+    void Blend(HdRprAovImage* color, float weight) const;
+
+private:
+    int m_width;
+    int m_height;
+    float m_depthTolerance;
+
+    std::vector<GfVec4f> m_historyColor;
+    std::vector<float> m_historyDepth;
+    GfMatrix4d m_historyViewProjection;
+
+    // Warped history color and whether it is valid, per pixel of the new view
+    std::vector<GfVec4f> m_warpedColor;
+    std::vector<uint8_t> m_warpedValid;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_REPROJECTOR_H
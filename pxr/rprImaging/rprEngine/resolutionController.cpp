@@ -0,0 +1,80 @@
+#include "pxr/rprImaging/rprEngine/resolutionController.h"
+
+#include <algorithm>
+#include <cmath>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+
+// Scales are multiples of this step
+const float kScaleStep = 1.0f / 16.0f;
+
+// Frame times within this fraction of the target don't change the scale
+const double kDeadband = 0.1;
+
+// Number of still frames after which the view is considered settled
+const int kSettleFrames = 2;
+
+// Pixel count growth per frame while refining a settled view
+const float kRefineAreaFactor = 1.5f;
+
+float Quantize(float scale) {
+    return std::max(std::round(scale / kScaleStep), 1.0f) * kScaleStep;
+}
+
+} // namespace anonymous
+
+HdRprResolutionController::HdRprResolutionController()
+    : m_targetFrameTime(0.0)
+    , m_minScale(0.25f)
+    , m_scale(1.0f)
+    , m_settledFrames(0) {
+
+}
+
+void HdRprResolutionController::SetTargetFrameTime(double seconds) {
+    m_targetFrameTime = std::max(seconds, 0.0);
+    if (!IsEnabled()) {
+        Reset();
+    }
+}
+
+void HdRprResolutionController::SetMinScale(float scale) {
+    m_minScale = std::min(std::max(Quantize(scale), kScaleStep), 1.0f);
+    m_scale = std::max(m_scale, m_minScale);
+}
+
+void HdRprResolutionController::Reset() {
+    m_scale = 1.0f;
+    m_settledFrames = 0;
+}
+
+float HdRprResolutionController::Update(double frameTime, bool isCameraMoving) {
+    if (!IsEnabled() || frameTime <= 0.0) {
+        return m_scale;
+    }
+
+    if (isCameraMoving) {
+        m_settledFrames = 0;
+
+        double ratio = m_targetFrameTime / frameTime;
+        if (std::abs(ratio - 1.0) > kDeadband) {
+            // Render time is roughly proportional to the pixel count
+            float scale = m_scale * float(std::sqrt(ratio));
+
+            // Drop fast to catch up with the motion, recover slowly
+            if (scale > m_scale) {
+                scale = m_scale + (scale - m_scale) * 0.5f;
+            }
+            m_scale = std::min(std::max(Quantize(scale), m_minScale), 1.0f);
+        }
+    } else if (++m_settledFrames >= kSettleFrames && m_scale < 1.0f) {
+        float scale = std::max(Quantize(m_scale * std::sqrt(kRefineAreaFactor)), m_scale + kScaleStep);
+        m_scale = std::min(scale, 1.0f);
+    }
+
+    return m_scale;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,52 @@
+#ifndef HDRPR_RESOLUTION_CONTROLLER_H
+#define HDRPR_RESOLUTION_CONTROLLER_H
+
+#include "api.h"
+
+#include "pxr/pxr.h"
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class HdRprResolutionController
+///
+/// Picks the render resolution scale that keeps the frame time close to a
+/// target latency. While the camera moves the scale follows the measured frame
+/// time; once the view settles the scale is raised back step by step to full
+/// resolution. Scales are quantized so that small frame time jitter does not
+/// reallocate render buffers every frame.
+///
+class HdRprResolutionController {
+public:
+    HDRPR_API
+    HdRprResolutionController();
+
+    /// Set target frame time in seconds. Zero disables the controller.
+    HDRPR_API
+    void SetTargetFrameTime(double seconds);
+    double GetTargetFrameTime() const { return m_targetFrameTime; }
+    bool IsEnabled() const { return m_targetFrameTime > 0.0; }
+
+    /// Set the lowest allowed resolution scale.
+    HDRPR_API
+    void SetMinScale(float scale);
+
+    /// Feed the measured duration of the last frame and whether the camera
+    /// moved since the frame before. Returns the scale for the next frame.
+    HDRPR_API
+    float Update(double frameTime, bool isCameraMoving);
+
+    float GetScale() const { return m_scale; }
+
+    HDRPR_API
+    void Reset();
+
+private:
+    double m_targetFrameTime;
+    float m_minScale;
+    float m_scale;
+    int m_settledFrames;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_RESOLUTION_CONTROLLER_H
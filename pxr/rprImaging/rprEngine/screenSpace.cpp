@@ -0,0 +1,126 @@
+#include "pxr/rprImaging/rprEngine/screenSpace.h"
+
+#include "pxr/base/gf/vec2d.h"
+#include "pxr/base/gf/vec4d.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+
+// Antialiasing filters and reconstruction touch neighbouring pixels
+const int kScreenRectMargin = 2;
+
+// Computes the NDC bounds of the projected box corners. Returns false if the
+// box crosses the camera plane.
+bool ProjectBBox(GfBBox3d const& bbox, GfMatrix4d const& viewProjection,
+                 GfVec2d* ndcMin, GfVec2d* ndcMax) {
+    GfRange3d const& range = bbox.GetRange();
+    GfMatrix4d worldToClip = bbox.GetMatrix() * viewProjection;
+
+    *ndcMin = GfVec2d(std::numeric_limits<double>::max());
+    *ndcMax = GfVec2d(std::numeric_limits<double>::lowest());
+    for (size_t i = 0; i < 8; ++i) {
+        GfVec3d corner = range.GetCorner(i);
+        GfVec4d clip = GfVec4d(corner[0], corner[1], corner[2], 1.0) * worldToClip;
+        if (clip[3] <= std::numeric_limits<double>::epsilon()) {
+            return false;
+        }
+        for (int axis = 0; axis < 2; ++axis) {
+            double ndc = clip[axis] / clip[3];
+            (*ndcMin)[axis] = std::min((*ndcMin)[axis], ndc);
+            (*ndcMax)[axis] = std::max((*ndcMax)[axis], ndc);
+        }
+    }
+    return true;
+}
+
+} // namespace anonymous
+
+GfVec4i HdRprUnionRect(GfVec4i const& a, GfVec4i const& b) {
+    if (HdRprIsRectEmpty(a)) return b;
+    if (HdRprIsRectEmpty(b)) return a;
+
+    int x0 = std::min(a[0], b[0]);
+    int y0 = std::min(a[1], b[1]);
+    int x1 = std::max(a[0] + a[2], b[0] + b[2]);
+    int y1 = std::max(a[1] + a[3], b[1] + b[3]);
+    return GfVec4i(x0, y0, x1 - x0, y1 - y0);
+}
+
+GfMatrix4d HdRprComputeRegionProjection(
+    GfMatrix4d const& projection,
+    GfVec2i const& viewportSize,
+    GfVec4i const& region) {
+    if (HdRprIsRectEmpty(region) || viewportSize[0] <= 0 || viewportSize[1] <= 0) {
+        return projection;
+    }
+
+    // NDC window of the region
+    double x0 = 2.0 * region[0] / viewportSize[0] - 1.0;
+    double x1 = 2.0 * (region[0] + region[2]) / viewportSize[0] - 1.0;
+    double y0 = 2.0 * region[1] / viewportSize[1] - 1.0;
+    double y1 = 2.0 * (region[1] + region[3]) / viewportSize[1] - 1.0;
+
+    // Scale and translate clip space so that the window maps onto [-1, 1].
+    // Gf matrices transform row vectors, so the translation is applied through
+    // the w component in the last row.
+    GfMatrix4d window(1.0);
+    window[0][0] = 2.0 / (x1 - x0);
+    window[1][1] = 2.0 / (y1 - y0);
+    window[3][0] = -(x1 + x0) / (x1 - x0);
+    window[3][1] = -(y1 + y0) / (y1 - y0);
+
+    return projection * window;
+}
+
+bool HdRprComputeScreenRect(
+    GfBBox3d const& bbox,
+    GfMatrix4d const& viewProjection,
+    GfVec2i const& viewportSize,
+    GfVec4i* rect) {
+    if (bbox.GetRange().IsEmpty()) {
+        *rect = GfVec4i(0);
+        return true;
+    }
+
+    GfVec2d ndcMin, ndcMax;
+    if (!ProjectBBox(bbox, viewProjection, &ndcMin, &ndcMax)) {
+        return false;
+    }
+
+    int x0 = int(std::floor((ndcMin[0] * 0.5 + 0.5) * viewportSize[0])) - kScreenRectMargin;
+    int y0 = int(std::floor((ndcMin[1] * 0.5 + 0.5) * viewportSize[1])) - kScreenRectMargin;
+    int x1 = int(std::ceil((ndcMax[0] * 0.5 + 0.5) * viewportSize[0])) + kScreenRectMargin;
+    int y1 = int(std::ceil((ndcMax[1] * 0.5 + 0.5) * viewportSize[1])) + kScreenRectMargin;
+
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, viewportSize[0]);
+    y1 = std::min(y1, viewportSize[1]);
+
+    *rect = GfVec4i(x0, y0, std::max(x1 - x0, 0), std::max(y1 - y0, 0));
+    return true;
+}
+
+double HdRprComputeProjectedSize(
+    GfBBox3d const& bbox,
+    GfMatrix4d const& viewProjection,
+    GfVec2i const& viewportSize) {
+    if (bbox.GetRange().IsEmpty()) {
+        return 0.0;
+    }
+
+    GfVec2d ndcMin, ndcMax;
+    if (!ProjectBBox(bbox, viewProjection, &ndcMin, &ndcMax)) {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    return std::max((ndcMax[0] - ndcMin[0]) * 0.5 * viewportSize[0],
+                    (ndcMax[1] - ndcMin[1]) * 0.5 * viewportSize[1]);
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,50 @@
+#ifndef HDRPR_SCREEN_SPACE_H
+#define HDRPR_SCREEN_SPACE_H
+
+#include "api.h"
+
+#include "pxr/base/gf/bbox3d.h"
+#include "pxr/base/gf/matrix4d.h"
+#include "pxr/base/gf/vec2i.h"
+#include "pxr/base/gf/vec4i.h"
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+// Pixel rectangles are stored as (x, y, w, h) where (x, y) is the lower left
+// corner, the same way viewports are.
+
+inline bool HdRprIsRectEmpty(GfVec4i const& rect) {
+    return rect[2] <= 0 || rect[3] <= 0;
+}
+
+/// Returns the smallest rectangle containing both \p a and \p b.
+HDRPR_API
+GfVec4i HdRprUnionRect(GfVec4i const& a, GfVec4i const& b);
+
+/// Returns \p projection adjusted so that the \p region of a viewport of
+/// \p viewportSize pixels fills the whole clip space.
+HDRPR_API
+GfMatrix4d HdRprComputeRegionProjection(GfMatrix4d const& projection,
+                                        GfVec2i const& viewportSize,
+                                        GfVec4i const& region);
+
+/// Computes the pixel rectangle covered by \p bbox, clamped to the viewport.
+/// Returns false if the box crosses the camera plane and so can't be bounded
+/// on screen.
+HDRPR_API
+bool HdRprComputeScreenRect(GfBBox3d const& bbox,
+                            GfMatrix4d const& viewProjection,
+                            GfVec2i const& viewportSize,
+                            GfVec4i* rect);
+
+/// Returns the larger side, in pixels, of the rectangle covered by \p bbox
+/// without clamping to the viewport. Boxes crossing the camera plane are
+/// infinitely large.
+HDRPR_API
+double HdRprComputeProjectedSize(GfBBox3d const& bbox,
+                                 GfMatrix4d const& viewProjection,
+                                 GfVec2i const& viewportSize);
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_SCREEN_SPACE_H
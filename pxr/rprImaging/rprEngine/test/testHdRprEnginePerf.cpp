@@ -0,0 +1,462 @@
+#include "pxr/rprImaging/rprEngine/engine.h"
+
+#include "pxr/imaging/hd/types.h"
+#include "pxr/usd/usd/stage.h"
+#include "pxr/usd/usdGeom/mesh.h"
+#include "pxr/usd/usdGeom/xform.h"
+#include "pxr/usd/usdGeom/xformCommonAPI.h"
+#include "pxr/usd/usdLux/distantLight.h"
+#include "pxr/base/gf/frustum.h"
+#include "pxr/base/js/json.h"
+#include "pxr/base/tf/stringUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+namespace {
+
+// CTest treats this exit code as a skipped test
+const int kSkipReturnCode = 77;
+
+const int kImageSize = 512;
+
+// Frames rendered after the first one, the steady-state time is their median
+const int kSteadyFrameCount = 16;
+
+using Clock = std::chrono::steady_clock;
+
+double SecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+double Median(std::vector<double> values) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+//----------------------------------------------------------------------------
+// Fixtures
+//----------------------------------------------------------------------------
+
+// Authors a grid mesh of \p resolution x \p resolution quads of size 1 in
+// the xz plane
+UsdGeomMesh DefineGridMesh(UsdStageRefPtr const& stage, SdfPath const& path, int resolution) {
+    VtVec3fArray points;
+    points.reserve((resolution + 1) * (resolution + 1));
+    for (int z = 0; z <= resolution; ++z) {
+        for (int x = 0; x <= resolution; ++x) {
+            points.push_back(GfVec3f(float(x) / resolution - 0.5f, 0.0f, float(z) / resolution - 0.5f));
+        }
+    }
+
+    VtIntArray faceVertexCounts(resolution * resolution, 4);
+    VtIntArray faceVertexIndices;
+    faceVertexIndices.reserve(resolution * resolution * 4);
+    for (int z = 0; z < resolution; ++z) {
+        for (int x = 0; x < resolution; ++x) {
+            int i = z * (resolution + 1) + x;
+            faceVertexIndices.push_back(i);
+            faceVertexIndices.push_back(i + resolution + 1);
+            faceVertexIndices.push_back(i + resolution + 2);
+            faceVertexIndices.push_back(i + 1);
+        }
+    }
+
+    UsdGeomMesh mesh = UsdGeomMesh::Define(stage, path);
+    mesh.CreatePointsAttr(VtValue(points));
+    mesh.CreateFaceVertexCountsAttr(VtValue(faceVertexCounts));
+    mesh.CreateFaceVertexIndicesAttr(VtValue(faceVertexIndices));
+    mesh.CreateSubdivisionSchemeAttr(VtValue(UsdGeomTokens->none));
+    mesh.CreateExtentAttr(VtValue(VtVec3fArray{GfVec3f(-0.5f, 0.0f, -0.5f), GfVec3f(0.5f, 0.0f, 0.5f)}));
+    return mesh;
+}
+
+void DefineLight(UsdStageRefPtr const& stage) {
+    UsdLuxDistantLight light = UsdLuxDistantLight::Define(stage, SdfPath("/Light"));
+    light.CreateIntensityAttr(VtValue(1.0f));
+    UsdGeomXformCommonAPI(light).SetRotate(GfVec3f(-45.0f, 30.0f, 0.0f));
+}
+
+// Many small separate meshes, stresses population and per-prim sync
+UsdStageRefPtr CreateMeshGridStage() {
+    UsdStageRefPtr stage = UsdStage::CreateInMemory();
+    DefineLight(stage);
+
+    const int kGridSize = 48;
+    for (int z = 0; z < kGridSize; ++z) {
+        for (int x = 0; x < kGridSize; ++x) {
+            SdfPath path(TfStringPrintf("/Grid/Row%d/Mesh%d", z, x));
+            UsdGeomMesh mesh = DefineGridMesh(stage, path, 4);
+            UsdGeomXformCommonAPI(mesh).SetTranslate(GfVec3d(x - kGridSize * 0.5, 0.0, z - kGridSize * 0.5));
+        }
+    }
+    return stage;
+}
+
+// A single mesh with a lot of faces, stresses mesh sync and BVH builds
+UsdStageRefPtr CreateDenseMeshStage() {
+    UsdStageRefPtr stage = UsdStage::CreateInMemory();
+    DefineLight(stage);
+
+    UsdGeomMesh mesh = DefineGridMesh(stage, SdfPath("/Dense"), 512);
+    UsdGeomXformCommonAPI(mesh).SetScale(GfVec3f(48.0f));
+    return stage;
+}
+
+// Instances of one prototype, stresses instancing
+UsdStageRefPtr CreateInstancedGridStage() {
+    UsdStageRefPtr stage = UsdStage::CreateInMemory();
+    DefineLight(stage);
+
+    UsdPrim prototype = stage->DefinePrim(SdfPath("/Prototype"));
+    prototype.SetSpecifier(SdfSpecifierClass);
+    DefineGridMesh(stage, SdfPath("/Prototype/Mesh"), 16);
+
+    const int kGridSize = 64;
+    for (int z = 0; z < kGridSize; ++z) {
+        for (int x = 0; x < kGridSize; ++x) {
+            UsdGeomXform instance = UsdGeomXform::Define(stage, SdfPath(TfStringPrintf("/Instances/Instance%d_%d", z, x)));
+            instance.GetPrim().GetInherits().AddInherit(prototype.GetPath());
+            instance.GetPrim().SetInstanceable(true);
+            UsdGeomXformCommonAPI(instance).SetTranslate(GfVec3d(x - kGridSize * 0.5, 0.0, z - kGridSize * 0.5));
+        }
+    }
+    return stage;
+}
+
+struct Fixture {
+    const char* name;
+    std::function<UsdStageRefPtr()> create;
+};
+
+std::vector<Fixture> const& GetFixtures() {
+    static std::vector<Fixture> fixtures = {
+        {"meshGrid", CreateMeshGridStage},
+        {"denseMesh", CreateDenseMeshStage},
+        {"instancedGrid", CreateInstancedGridStage},
+    };
+    return fixtures;
+}
+
+//----------------------------------------------------------------------------
+// Measurement
+//----------------------------------------------------------------------------
+
+const char* const kMetricNames[] = {"startup", "populate", "firstFrame", "steadyFrame", "readback"};
+const size_t kMetricCount = sizeof(kMetricNames) / sizeof(kMetricNames[0]);
+
+struct Metrics {
+    double values[kMetricCount] = {};
+};
+
+// Prefers RPR, falls back to a CPU renderer so the engine overhead is still
+// covered on machines without a supported GPU
+bool SelectRenderer(HdRprEngine* engine, TfToken* rendererId) {
+    static TfToken const kEmbreeId("HdEmbreeRendererPlugin", TfToken::Immortal);
+
+    TfTokenVector candidates;
+    TfTokenVector plugins = HdRprEngine::GetRendererPlugins();
+    for (TfToken const& id : plugins) {
+        if (std::strstr(HdRprEngine::GetRendererDisplayName(id).c_str(), "RPR")) {
+            candidates.push_back(id);
+        }
+    }
+    if (std::find(plugins.begin(), plugins.end(), kEmbreeId) != plugins.end()) {
+        candidates.push_back(kEmbreeId);
+    }
+
+    for (TfToken const& id : candidates) {
+        if (engine->SetRendererPlugin(id)) {
+            *rendererId = id;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SetCamera(HdRprEngine* engine) {
+    GfFrustum frustum;
+    frustum.SetPerspective(45.0, 1.0, 0.1, 1000.0);
+
+    GfMatrix4d viewMatrix;
+    viewMatrix.SetLookAt(GfVec3d(0.0, 40.0, 60.0), GfVec3d(0.0), GfVec3d(0.0, 1.0, 0.0));
+
+    engine->SetRenderViewport(GfVec4d(0.0, 0.0, kImageSize, kImageSize));
+    engine->SetCameraState(viewMatrix, frustum.ComputeProjectionMatrix());
+}
+
+double Readback(HdRprEngine* engine, std::vector<uint8_t>* pixels) {
+    HdRenderBuffer* buffer = engine->GetAovBuffer(HdAovTokens->color);
+    if (!buffer) {
+        return 0.0;
+    }
+
+    auto start = Clock::now();
+    buffer->Resolve();
+    size_t size = size_t(buffer->GetWidth()) * buffer->GetHeight() * HdDataSizeOfFormat(buffer->GetFormat());
+    pixels->resize(size);
+    if (void const* data = buffer->Map()) {
+        std::memcpy(pixels->data(), data, size);
+    }
+    buffer->Unmap();
+    return SecondsSince(start);
+}
+
+// Renders \p stage with a new engine, returns false if no renderer could be
+// selected
+bool Measure(UsdStageRefPtr const& stage, HdRprEngineOptions const& options, TfToken* rendererId, Metrics* metrics) {
+    HdRprEngine engine(SdfPath::AbsoluteRootPath(), {}, {}, SdfPath::AbsoluteRootPath(), options);
+    if (!SelectRenderer(&engine, rendererId)) {
+        return false;
+    }
+    metrics->values[0] = engine.GetStats().rendererStartupTime;
+    engine.SetRendererAovs({HdAovTokens->color});
+    SetCamera(&engine);
+
+    UsdPrim root = stage->GetPseudoRoot();
+    HdRprEngineRenderParams params;
+
+    auto start = Clock::now();
+    engine.PrepareBatch(root, params);
+    metrics->values[1] = SecondsSince(start);
+
+    start = Clock::now();
+    engine.RenderBatch({root.GetPath()}, params);
+    metrics->values[2] = SecondsSince(start);
+
+    std::vector<double> frameTimes;
+    std::vector<double> readbackTimes;
+    std::vector<uint8_t> pixels;
+    for (int i = 0; i < kSteadyFrameCount; ++i) {
+        start = Clock::now();
+        engine.Render(root, params);
+        frameTimes.push_back(SecondsSince(start));
+        readbackTimes.push_back(Readback(&engine, &pixels));
+    }
+    metrics->values[3] = Median(frameTimes);
+    metrics->values[4] = Median(readbackTimes);
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// Baselines
+//----------------------------------------------------------------------------
+
+double GetNumber(JsValue const& value, double fallback) {
+    if (value.IsReal()) {
+        return value.GetReal();
+    } else if (value.IsInt()) {
+        return double(value.GetInt());
+    }
+    return fallback;
+}
+
+JsValue GetMember(JsValue const& value, std::string const& key) {
+    if (value.IsObject()) {
+        JsObject const& object = value.GetJsObject();
+        auto it = object.find(key);
+        if (it != object.end()) {
+            return it->second;
+        }
+    }
+    return JsValue();
+}
+
+bool ReadBaselines(std::string const& filePath, JsValue* baselines) {
+    std::ifstream file(filePath);
+    if (!file) {
+        // A missing file is fine when recording baselines
+        *baselines = JsValue(JsObject());
+        return false;
+    }
+
+    JsParseError error;
+    *baselines = JsParseStream(file, &error);
+    if (!baselines->IsObject()) {
+        printf("Failed to parse %s:%u:%u: %s\n", filePath.c_str(), error.line, error.column, error.reason.c_str());
+        return false;
+    }
+    return true;
+}
+
+enum class Comparison {
+    Passed,
+    Regressed,
+    // Some metric has no baseline, nothing can be told about it
+    MissingBaseline
+};
+
+// Compares each metric against its baseline plus the tolerance.
+Comparison Compare(JsValue const& baselines, std::string const& rendererKey, std::string const& fixture, Metrics const& metrics) {
+    JsValue tolerance = GetMember(baselines, "tolerance");
+    double relativeTolerance = GetNumber(GetMember(tolerance, "relative"), 0.25);
+    double absoluteTolerance = GetNumber(GetMember(tolerance, "absolute"), 0.005);
+    JsValue fixtureBaselines = GetMember(GetMember(GetMember(baselines, "baselines"), rendererKey), fixture);
+
+    bool passed = true;
+    bool isMissingBaseline = false;
+    for (size_t i = 0; i < kMetricCount; ++i) {
+        double measured = metrics.values[i];
+        double baseline = GetNumber(GetMember(fixtureBaselines, kMetricNames[i]), -1.0);
+        if (baseline < 0.0) {
+            printf("  %-12s %10.4f s  (no baseline)\n", kMetricNames[i], measured);
+            isMissingBaseline = true;
+            continue;
+        }
+
+        double limit = baseline * (1.0 + relativeTolerance) + absoluteTolerance;
+        bool regressed = measured > limit;
+        printf("  %-12s %10.4f s  baseline %10.4f s  limit %10.4f s  %s\n",
+               kMetricNames[i], measured, baseline, limit, regressed ? "REGRESSED" : "ok");
+        passed = passed && !regressed;
+    }
+
+    if (!passed) {
+        return Comparison::Regressed;
+    }
+    return isMissingBaseline ? Comparison::MissingBaseline : Comparison::Passed;
+}
+
+void Record(JsValue* baselines, std::string const& rendererKey, std::string const& fixture, Metrics const& metrics) {
+    JsObject root = baselines->IsObject() ? baselines->GetJsObject() : JsObject();
+    if (!root.count("tolerance")) {
+        root["tolerance"] = JsValue(JsObject{{"relative", JsValue(0.25)}, {"absolute", JsValue(0.005)}});
+    }
+
+    JsValue renderersValue = GetMember(*baselines, "baselines");
+    JsValue fixturesValue = GetMember(renderersValue, rendererKey);
+    JsObject renderers = renderersValue.IsObject() ? renderersValue.GetJsObject() : JsObject();
+    JsObject fixtures = fixturesValue.IsObject() ? fixturesValue.GetJsObject() : JsObject();
+
+    JsObject values;
+    for (size_t i = 0; i < kMetricCount; ++i) {
+        values[kMetricNames[i]] = JsValue(metrics.values[i]);
+    }
+    fixtures[fixture] = JsValue(values);
+    renderers[rendererKey] = JsValue(fixtures);
+    root["baselines"] = JsValue(renderers);
+    *baselines = JsValue(root);
+}
+
+} // namespace anonymous
+
+int main(int ac, char** av) {
+    std::string fixtureName;
+    std::string baselinesPath;
+    bool updateBaselines = false;
+    int repeatCount = 3;
+    HdRprEngineOptions options;
+
+    for (int i = 1; i < ac; ++i) {
+        std::string arg = av[i];
+        if (arg == "--fixture" && i + 1 < ac) {
+            fixtureName = av[++i];
+        } else if (arg == "--baselines" && i + 1 < ac) {
+            baselinesPath = av[++i];
+        } else if (arg == "--update-baselines") {
+            updateBaselines = true;
+        } else if (arg == "--repeat" && i + 1 < ac) {
+            repeatCount = std::max(std::atoi(av[++i]), 1);
+        } else if (arg == "--headless") {
+            options.headless = true;
+        } else {
+            printf("Usage: %s --baselines file.json [--fixture name] [--repeat count] [--headless] [--update-baselines]\n", av[0]);
+            return 1;
+        }
+    }
+    if (baselinesPath.empty()) {
+        printf("No baselines file given\n");
+        return 1;
+    }
+
+    JsValue baselines;
+    if (!ReadBaselines(baselinesPath, &baselines) && !updateBaselines) {
+        printf("Failed to read baselines from %s\n", baselinesPath.c_str());
+        return 1;
+    }
+
+    bool passed = true;
+    bool isMissingBaseline = false;
+    bool found = false;
+    for (Fixture const& fixture : GetFixtures()) {
+        if (!fixtureName.empty() && fixtureName != fixture.name) {
+            continue;
+        }
+        found = true;
+
+        UsdStageRefPtr stage = fixture.create();
+
+        // Each repetition uses a new engine, the median of each metric is
+        // compared
+        TfToken rendererId;
+        std::vector<std::vector<double>> samples(kMetricCount);
+        for (int i = 0; i < repeatCount; ++i) {
+            Metrics metrics;
+            if (!Measure(stage, options, &rendererId, &metrics)) {
+                printf("Neither RPR nor a CPU renderer plugin is available, skipping\n");
+                return kSkipReturnCode;
+            }
+            for (size_t j = 0; j < kMetricCount; ++j) {
+                samples[j].push_back(metrics.values[j]);
+            }
+        }
+
+        Metrics metrics;
+        for (size_t j = 0; j < kMetricCount; ++j) {
+            metrics.values[j] = Median(samples[j]);
+        }
+
+        // Headless runs have their own baselines to compare startup against
+        std::string rendererKey = rendererId.GetString() + (options.headless ? " headless" : "");
+
+        printf("%s with %s:\n", fixture.name, rendererKey.c_str());
+        if (updateBaselines) {
+            Record(&baselines, rendererKey, fixture.name, metrics);
+            for (size_t j = 0; j < kMetricCount; ++j) {
+                printf("  %-12s %10.4f s  recorded\n", kMetricNames[j], metrics.values[j]);
+            }
+        } else {
+            Comparison comparison = Compare(baselines, rendererKey, fixture.name, metrics);
+            passed = passed && comparison != Comparison::Regressed;
+            isMissingBaseline = isMissingBaseline || comparison == Comparison::MissingBaseline;
+        }
+    }
+
+    if (!found) {
+        printf("Unknown fixture \"%s\"\n", fixtureName.c_str());
+        return 1;
+    }
+
+    if (updateBaselines) {
+        std::ofstream file(baselinesPath);
+        JsWriteToStream(baselines, file);
+        file << std::endl;
+        if (!file) {
+            printf("Failed to write baselines to %s\n", baselinesPath.c_str());
+            return 1;
+        }
+    }
+
+    if (!passed) {
+        return 1;
+    }
+    // Without baselines for this renderer and machine the test can't pass
+    if (isMissingBaseline) {
+        printf("Baselines are missing, record them with --update-baselines; skipping\n");
+        return kSkipReturnCode;
+    }
+    return 0;
+}
@@ -0,0 +1,248 @@
+// Observers local to an arena are a preview feature in older TBB versions
+#define TBB_PREVIEW_LOCAL_OBSERVER 1
+
+#include "pxr/rprImaging/rprEngine/threadArena.h"
+
+#include "pxr/base/arch/defines.h"
+#include "pxr/base/tf/diagnostic.h"
+#include "pxr/base/tf/stringUtils.h"
+#include "pxr/base/work/threadLimits.h"
+
+#include <tbb/task_arena.h>
+#include <tbb/task_scheduler_observer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <string>
+
+#if defined(ARCH_OS_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(ARCH_OS_WINDOWS)
+#include <Windows.h>
+#endif
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+
+#if defined(ARCH_OS_LINUX)
+
+using CpuMask = cpu_set_t;
+
+CpuMask MakeCpuMask(std::vector<int> const& cpus) {
+    CpuMask mask;
+    CPU_ZERO(&mask);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &mask);
+        }
+    }
+    return mask;
+}
+
+// Pins the calling thread to \p mask, \p previous receives the mask before
+bool SwapThreadAffinity(CpuMask const& mask, CpuMask* previous) {
+    pthread_t thread = pthread_self();
+    return pthread_getaffinity_np(thread, sizeof(CpuMask), previous) == 0 &&
+           pthread_setaffinity_np(thread, sizeof(CpuMask), &mask) == 0;
+}
+
+#elif defined(ARCH_OS_WINDOWS)
+
+using CpuMask = DWORD_PTR;
+
+CpuMask MakeCpuMask(std::vector<int> const& cpus) {
+    CpuMask mask = 0;
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < int(sizeof(CpuMask) * 8)) {
+            mask |= CpuMask(1) << cpu;
+        }
+    }
+    return mask;
+}
+
+bool SwapThreadAffinity(CpuMask const& mask, CpuMask* previous) {
+    *previous = SetThreadAffinityMask(GetCurrentThread(), mask);
+    return *previous != 0;
+}
+
+#else
+
+struct CpuMask {};
+
+CpuMask MakeCpuMask(std::vector<int> const& cpus) {
+    TF_WARN("Thread affinity is not supported on this platform");
+    return CpuMask();
+}
+
+bool SwapThreadAffinity(CpuMask const& mask, CpuMask* previous) {
+    return false;
+}
+
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+// State of a worker thread while it is in an arena. A thread is in at most
+// one arena at a time.
+struct WorkerState {
+    Clock::time_point entryTime;
+    CpuMask previousMask;
+    bool isPinned = false;
+};
+thread_local WorkerState g_workerState;
+
+// Pins workers joining the arena and measures how long they stay
+class ArenaObserver : public tbb::task_scheduler_observer {
+public:
+    ArenaObserver(tbb::task_arena& arena, std::vector<int> const& cpus)
+        : tbb::task_scheduler_observer(arena)
+        , hasAffinity(!cpus.empty())
+        , mask(MakeCpuMask(cpus))
+        , activeWorkers(0)
+        , peakWorkers(0)
+        , workerTime(0) {
+        observe(true);
+    }
+
+    ~ArenaObserver() override {
+        observe(false);
+    }
+
+    // The thread calling Execute() is accounted for there, observers are
+    // notified only for workers
+    void on_scheduler_entry(bool isWorker) override {
+        if (!isWorker) {
+            return;
+        }
+
+        g_workerState.entryTime = Clock::now();
+        g_workerState.isPinned = hasAffinity && SwapThreadAffinity(mask, &g_workerState.previousMask);
+
+        int workers = ++activeWorkers;
+        int peak = peakWorkers.load();
+        while (workers > peak && !peakWorkers.compare_exchange_weak(peak, workers)) {}
+    }
+
+    void on_scheduler_exit(bool isWorker) override {
+        if (!isWorker) {
+            return;
+        }
+
+        // Workers return to the shared pool, give them back their affinity
+        if (g_workerState.isPinned) {
+            CpuMask pinnedMask;
+            SwapThreadAffinity(g_workerState.previousMask, &pinnedMask);
+            g_workerState.isPinned = false;
+        }
+
+        --activeWorkers;
+        workerTime += (Clock::now() - g_workerState.entryTime).count();
+    }
+
+    bool const hasAffinity;
+    CpuMask const mask;
+
+    std::atomic<int> activeWorkers;
+    std::atomic<int> peakWorkers;
+    std::atomic<Clock::rep> workerTime;
+};
+
+} // namespace anonymous
+
+struct HdRprThreadArena::_Impl {
+    _Impl(int threadLimit, std::vector<int> const& cpus)
+        : arena(threadLimit)
+        , observer(arena, cpus) {
+
+    }
+
+    tbb::task_arena arena;
+    ArenaObserver observer;
+};
+
+HdRprThreadArena::HdRprThreadArena(int threadLimit, std::vector<int> const& cpus)
+    : m_depth(0)
+    , m_executeTime(Clock::duration::zero()) {
+    int workLimit = int(WorkGetConcurrencyLimit());
+    // More threads than pinned CPUs would oversubscribe them
+    if (!cpus.empty()) {
+        std::set<int> uniqueCpus(cpus.begin(), cpus.end());
+        workLimit = std::min(workLimit, int(uniqueCpus.size()));
+    }
+    threadLimit = threadLimit > 0 ? std::min(threadLimit, workLimit) : workLimit;
+    m_impl.reset(new _Impl(threadLimit, cpus));
+}
+
+HdRprThreadArena::~HdRprThreadArena() = default;
+
+void HdRprThreadArena::Execute(std::function<void()> const& fn) {
+    if (m_depth > 0) {
+        fn();
+        return;
+    }
+
+    ++m_depth;
+    CpuMask previousMask;
+    bool isPinned = m_impl->observer.hasAffinity && SwapThreadAffinity(m_impl->observer.mask, &previousMask);
+
+    auto start = Clock::now();
+    m_impl->arena.execute(fn);
+    m_executeTime += Clock::now() - start;
+
+    if (isPinned) {
+        CpuMask pinnedMask;
+        SwapThreadAffinity(previousMask, &pinnedMask);
+    }
+    --m_depth;
+}
+
+int HdRprThreadArena::GetThreadLimit() const {
+    return m_impl->arena.max_concurrency();
+}
+
+void HdRprThreadArena::TakeParallelism(size_t* peakThreadCount, double* averageParallelism) {
+    // The calling thread is busy during all of the execute time
+    int peakWorkers = m_impl->observer.peakWorkers.exchange(m_impl->observer.activeWorkers.load());
+    Clock::rep workerTime = m_impl->observer.workerTime.exchange(0);
+    Clock::rep executeTime = m_executeTime.count();
+    m_executeTime = Clock::duration::zero();
+
+    if (peakThreadCount) {
+        *peakThreadCount = executeTime > 0 ? size_t(peakWorkers) + 1 : 0;
+    }
+    if (averageParallelism) {
+        *averageParallelism = executeTime > 0 ? 1.0 + double(workerTime) / double(executeTime) : 0.0;
+    }
+}
+
+std::vector<int> HdRprThreadArena::GetNumaNodeCpus(int node) {
+    std::vector<int> cpus;
+#if defined(ARCH_OS_LINUX)
+    // The list has the form "0-7,16-23"
+    std::ifstream file(TfStringPrintf("/sys/devices/system/node/node%d/cpulist", node));
+    std::string cpuList;
+    if (!std::getline(file, cpuList)) {
+        return cpus;
+    }
+
+    for (std::string const& range : TfStringSplit(TfStringTrim(cpuList), ",")) {
+        std::vector<std::string> bounds = TfStringSplit(range, "-");
+        if (bounds.empty() || bounds.size() > 2) {
+            continue;
+        }
+        int first = std::atoi(bounds.front().c_str());
+        int last = std::atoi(bounds.back().c_str());
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+#endif
+    return cpus;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,67 @@
+#ifndef HDRPR_THREAD_ARENA_H
+#define HDRPR_THREAD_ARENA_H
+
+#include "api.h"
+
+#include "pxr/pxr.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class HdRprThreadArena
+///
+/// Runs work on at most a given number of threads of the Work pool, so that
+/// several engines in one process don't oversubscribe the CPUs, optionally
+/// pinning the threads to a set of CPUs while they run the work. Parallel
+/// Work and TBB algorithms started inside Execute() stay within the arena.
+///
+/// The arena also measures how many of its threads were busy on average.
+/// Like the engine, it is meant to be used from one thread at a time.
+///
+class HdRprThreadArena {
+public:
+    /// \p threadLimit of 0 uses the Work concurrency limit, or the number
+    /// of \p cpus if fewer. Empty \p cpus leaves the thread affinity alone.
+    HDRPR_API
+    HdRprThreadArena(int threadLimit, std::vector<int> const& cpus);
+
+    HDRPR_API
+    ~HdRprThreadArena();
+
+    HdRprThreadArena(const HdRprThreadArena&) = delete;
+    HdRprThreadArena& operator=(const HdRprThreadArena&) = delete;
+
+    /// Run \p fn in the arena. Calls nested in \p fn run directly.
+    HDRPR_API
+    void Execute(std::function<void()> const& fn);
+
+    HDRPR_API
+    int GetThreadLimit() const;
+
+    /// Returns the most threads that were in the arena at once and the
+    /// average number of busy threads over the time spent in Execute()
+    /// since the last call. Workers count as busy from joining the arena to
+    /// leaving it.
+    HDRPR_API
+    void TakeParallelism(size_t* peakThreadCount, double* averageParallelism);
+
+    /// Returns the CPUs of NUMA node \p node, empty if they can't be
+    /// determined on this platform.
+    HDRPR_API
+    static std::vector<int> GetNumaNodeCpus(int node);
+
+private:
+    struct _Impl;
+    std::unique_ptr<_Impl> m_impl;
+
+    int m_depth;
+    std::chrono::steady_clock::duration m_executeTime;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_THREAD_ARENA_H
@@ -0,0 +1,120 @@
+#include "pxr/rprImaging/rprEngine/thumbnailBatch.h"
+#include "pxr/rprImaging/rprEngine/engine.h"
+
+#include "pxr/usd/usd/stage.h"
+#include "pxr/usd/usdGeom/bboxCache.h"
+#include "pxr/usd/usdGeom/metrics.h"
+#include "pxr/base/gf/frustum.h"
+#include "pxr/base/gf/math.h"
+#include "pxr/base/tf/staticTokens.h"
+
+#include <algorithm>
+#include <cmath>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+TF_DEFINE_PRIVATE_TOKENS(_tokens,
+    (maxSamples)
+);
+
+namespace {
+
+// Vertical field of view of the thumbnail camera in degrees
+const double kFieldOfView = 30.0;
+
+} // namespace anonymous
+
+HdRprThumbnailBatch::HdRprThumbnailBatch(
+    HdRprEngine* engine,
+    HdRprThumbnailSettings const& settings)
+    : m_engine(engine)
+    , m_settings(settings) {
+
+}
+
+HdRprThumbnailBatch::~HdRprThumbnailBatch() {
+    m_dispatcher.Wait();
+}
+
+void HdRprThumbnailBatch::Run(
+    std::vector<std::string> const& stagePaths,
+    Callback const& callback) {
+    if (!m_engine || stagePaths.empty()) {
+        return;
+    }
+
+    m_engine->SetRendererAovs({HdAovTokens->color});
+    m_engine->SetRendererSetting(_tokens->maxSamples, VtValue(m_settings.maxSamples));
+    m_engine->SetRenderViewport(GfVec4d(0.0, 0.0, m_settings.resolution, m_settings.resolution));
+
+    UsdStageRefPtr nextStage;
+    auto openStage = [&nextStage](std::string const& path) {
+        nextStage = UsdStage::Open(path, UsdStage::LoadAll);
+    };
+    m_dispatcher.Run(openStage, stagePaths.front());
+
+    for (size_t i = 0; i < stagePaths.size(); ++i) {
+        m_dispatcher.Wait();
+        UsdStageRefPtr stage = std::move(nextStage);
+        nextStage = UsdStageRefPtr();
+
+        if (i + 1 < stagePaths.size()) {
+            m_dispatcher.Run(openStage, stagePaths[i + 1]);
+        }
+
+        bool rendered = stage && _Render(stage);
+        callback(stagePaths[i], rendered ? m_engine->GetAovBuffer(HdAovTokens->color) : nullptr);
+    }
+
+    // Don't keep the last stage alive through the engine
+    m_engine->ResetScene();
+}
+
+bool HdRprThumbnailBatch::_Render(UsdStageRefPtr const& stage) {
+    m_engine->SetStage(stage);
+    _FrameStage(stage);
+
+    HdRprEngineRenderParams params;
+    params.refineLevel = m_settings.refineLevel;
+    params.enableSceneMaterials = m_settings.enableSceneMaterials;
+
+    UsdPrim root = stage->GetPseudoRoot();
+    int iteration = 0;
+    do {
+        m_engine->Render(root, params);
+    } while (!m_engine->IsConverged() && ++iteration < m_settings.maxIterations);
+
+    return m_engine->GetAovBuffer(HdAovTokens->color) != nullptr;
+}
+
+void HdRprThumbnailBatch::_FrameStage(UsdStageRefPtr const& stage) {
+    UsdGeomBBoxCache bboxCache(UsdTimeCode::Default(), m_settings.purposes, /* useExtentsHint = */ true);
+    GfRange3d range = bboxCache.ComputeWorldBound(stage->GetPseudoRoot()).ComputeAlignedRange();
+    if (range.IsEmpty()) {
+        range = GfRange3d(GfVec3d(-1.0), GfVec3d(1.0));
+    }
+
+    // Three-quarter view from the front right, far enough for the bounding
+    // sphere to fit the field of view
+    GfVec3d center = range.GetMidpoint();
+    double radius = std::max(range.GetSize().GetLength() * 0.5, 1e-3);
+    double distance = radius / std::sin(GfDegreesToRadians(kFieldOfView * 0.5));
+
+    GfVec3d up(0.0, 1.0, 0.0);
+    GfVec3d direction(1.0, 0.75, 1.0);
+    if (UsdGeomGetStageUpAxis(stage) == UsdGeomTokens->z) {
+        up = GfVec3d(0.0, 0.0, 1.0);
+        direction = GfVec3d(1.0, -1.0, 0.75);
+    }
+
+    GfMatrix4d viewMatrix;
+    viewMatrix.SetLookAt(center + direction.GetNormalized() * distance, center, up);
+
+    GfFrustum frustum;
+    frustum.SetPerspective(kFieldOfView, 1.0, std::max(distance - radius, distance * 1e-3), distance + radius);
+
+    m_engine->SetCameraPath(SdfPath());
+    m_engine->SetCameraState(viewMatrix, frustum.ComputeProjectionMatrix());
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
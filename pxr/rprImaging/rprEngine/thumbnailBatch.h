@@ -0,0 +1,85 @@
+#ifndef HDRPR_THUMBNAIL_BATCH_H
+#define HDRPR_THUMBNAIL_BATCH_H
+
+#include "api.h"
+
+#include "pxr/imaging/hd/renderBuffer.h"
+#include "pxr/usd/usd/common.h"
+#include "pxr/usd/usdGeom/tokens.h"
+#include "pxr/base/tf/token.h"
+#include "pxr/base/work/dispatcher.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+class HdRprEngine;
+
+/// \class HdRprThumbnailSettings
+///
+/// Preset for quick, low resolution previews of whole stages.
+///
+struct HdRprThumbnailSettings {
+    // Width and height of the square thumbnails in pixels
+    int resolution = 256;
+
+    // Samples per pixel, forwarded as the maxSamples renderer setting
+    int maxSamples = 16;
+
+    // Render calls per thumbnail after which it is taken even if the
+    // renderer doesn't report convergence
+    int maxIterations = 256;
+
+    int refineLevel = 0;
+    bool enableSceneMaterials = true;
+
+    // Purposes the camera frames the stage bounds of
+    TfTokenVector purposes = {UsdGeomTokens->default_, UsdGeomTokens->render};
+};
+
+/// \class HdRprThumbnailBatch
+///
+/// Renders thumbnails of many stages with a single engine. Between stages
+/// only the scene is reset, the renderer and its buffers are reused. While
+/// one stage renders, the next one is opened on a worker thread.
+///
+class HdRprThumbnailBatch {
+public:
+    /// Receives the path of each stage and its color AOV, or null if the
+    /// stage could not be opened or rendered. The buffer is only valid
+    /// during the call.
+    using Callback = std::function<void(std::string const& stagePath, HdRenderBuffer* colorBuffer)>;
+
+    HDRPR_API
+    HdRprThumbnailBatch(HdRprEngine* engine,
+                        HdRprThumbnailSettings const& settings = HdRprThumbnailSettings());
+
+    HDRPR_API
+    ~HdRprThumbnailBatch();
+
+    HdRprThumbnailBatch(const HdRprThumbnailBatch&) = delete;
+    HdRprThumbnailBatch& operator=(const HdRprThumbnailBatch&) = delete;
+
+    /// Render a thumbnail of each of \p stagePaths in order.
+    HDRPR_API
+    void Run(std::vector<std::string> const& stagePaths, Callback const& callback);
+
+private:
+    // Renders the current stage, returns false if it yields no image
+    bool _Render(UsdStageRefPtr const& stage);
+
+    // Points the engine camera at the bounds of \p stage
+    void _FrameStage(UsdStageRefPtr const& stage);
+
+private:
+    HdRprEngine* m_engine;
+    HdRprThumbnailSettings m_settings;
+
+    WorkDispatcher m_dispatcher;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_THUMBNAIL_BATCH_H
@@ -5,6 +5,8 @@
 #include "pxr/imaging/hd/renderBuffer.h"
 #include "pxr/imaging/hd/renderDelegate.h"
 
+#include <algorithm>
+
 PXR_NAMESPACE_OPEN_SCOPE
 
 HdRprRenderTask::HdRprRenderTask(HdSceneDelegate* delegate, SdfPath const& id)
@@ -17,7 +19,12 @@ HdRprRenderTask::~HdRprRenderTask() {
 }
 
 bool HdRprRenderTask::IsConverged() const {
-    return m_pass ? m_pass->IsConverged() : true;
+    for (auto const& pass : m_passes) {
+        if (pass.pass && !pass.pass->IsConverged()) {
+            return false;
+        }
+    }
+    return true;
 }
 
 void HdRprRenderTask::Sync(HdSceneDelegate* delegate,
@@ -25,24 +32,16 @@ void HdRprRenderTask::Sync(HdSceneDelegate* delegate,
                            HdDirtyBits* dirtyBits) {
     auto renderIndex = &delegate->GetRenderIndex();
 
+    bool passesDirty = false;
+
     if ((*dirtyBits) & HdChangeTracker::DirtyCollection) {
         VtValue val = delegate->Get(GetId(), HdTokens->collection);
-        auto collection = val.Get<HdRprimCollection>();
-
-        // Check for cases where the collection is empty (i.e. default
-        // constructed).  To do this, the code looks at the root paths,
-        // if it is empty, the collection doesn't refer to any prims at
-        // all.
-        if (collection.GetName().IsEmpty()) {
-            m_pass.reset();
+        if (val.IsHolding<HdRprimCollection>()) {
+            m_collection = val.UncheckedGet<HdRprimCollection>();
         } else {
-            if (!m_pass) {
-                auto renderDelegate = renderIndex->GetRenderDelegate();
-                m_pass = renderDelegate->CreateRenderPass(renderIndex, collection);
-            } else {
-                m_pass->SetRprimCollection(collection);
-            }
+            m_collection = HdRprimCollection();
         }
+        passesDirty = true;
     }
 
     if ((*dirtyBits) & HdChangeTracker::DirtyParams) {
@@ -56,60 +55,106 @@ void HdRprRenderTask::Sync(HdSceneDelegate* delegate,
         m_aovBindings = params.aovBindings;
         m_viewport = params.viewport;
         m_cameraId = params.camera;
+        m_passParams = params.passes;
+        passesDirty = true;
     }
 
     if ((*dirtyBits) & HdChangeTracker::DirtyRenderTags) {
-        m_renderTags = _GetTaskRenderTags(delegate);
+        m_taskRenderTags = _GetTaskRenderTags(delegate);
+        passesDirty = true;
     }
 
-    if (m_pass) {
-        m_pass->Sync();
+    if (passesDirty) {
+        _UpdatePasses(renderIndex);
+    }
+
+    for (auto& pass : m_passes) {
+        pass.pass->Sync();
     }
 
     *dirtyBits = HdChangeTracker::Clean;
 }
 
-void HdRprRenderTask::Prepare(HdTaskContext* ctx,
-                              HdRenderIndex* renderIndex) {
-    if (!m_passState) {
-        m_passState = renderIndex->GetRenderDelegate()->CreateRenderPassState();
+void HdRprRenderTask::_UpdatePasses(HdRenderIndex* renderIndex) {
+    std::vector<HdRprRenderTaskPassParams> passParams = m_passParams;
+    if (passParams.empty()) {
+        // Check for cases where the collection is empty (i.e. default
+        // constructed).  To do this, the code looks at the root paths,
+        // if it is empty, the collection doesn't refer to any prims at
+        // all.
+        if (!m_collection.GetName().IsEmpty()) {
+            HdRprRenderTaskPassParams pass;
+            pass.collection = m_collection;
+            pass.aovBindings = m_aovBindings;
+            passParams.push_back(pass);
+        }
     }
 
-    // Prepare AOVS
-    {
-        // Walk the aov bindings, resolving the render index references as they're
-        // encountered.
-        for (size_t i = 0; i < m_aovBindings.size(); ++i) {
-            if (m_aovBindings[i].renderBuffer == nullptr) {
-                m_aovBindings[i].renderBuffer = static_cast<HdRenderBuffer*>(renderIndex->GetBprim(HdPrimTypeTokens->renderBuffer, m_aovBindings[i].renderBufferId));
-            }
+    // Render passes are kept by index, a pass whose collection changed
+    // only gets the new collection
+    m_passes.resize(passParams.size());
+    m_renderTags.clear();
+    for (size_t i = 0; i < passParams.size(); ++i) {
+        _Pass& pass = m_passes[i];
+        HdRprimCollection const& collection = passParams[i].collection;
+        if (!pass.pass) {
+            auto renderDelegate = renderIndex->GetRenderDelegate();
+            pass.pass = renderDelegate->CreateRenderPass(renderIndex, collection);
+        } else if (pass.pass->GetRprimCollection() != collection) {
+            pass.pass->SetRprimCollection(collection);
         }
-        m_passState->SetAovBindings(m_aovBindings);
 
-        // XXX Tasks that are not RenderTasks (OIT, ColorCorrection etc) also need
-        // access to AOVs, but cannot access SetupTask or RenderPassState.
-        //(*ctx)[HdxTokens->aovBindings] = VtValue(m_aovBindings);
-    }
+        pass.renderTags = passParams[i].renderTags.empty() ? m_taskRenderTags : passParams[i].renderTags;
+        pass.aovBindings = passParams[i].aovBindings;
 
-    // Prepare Camera
-    {
-        auto camera = static_cast<const HdCamera*>(renderIndex->GetSprim(HdPrimTypeTokens->camera, m_cameraId));
-        TF_VERIFY(camera);
-        m_passState->SetCameraAndViewport(camera, m_viewport);
+        for (TfToken const& renderTag : pass.renderTags) {
+            if (std::find(m_renderTags.begin(), m_renderTags.end(), renderTag) == m_renderTags.end()) {
+                m_renderTags.push_back(renderTag);
+            }
+        }
     }
+}
+
+void HdRprRenderTask::Prepare(HdTaskContext* ctx,
+                              HdRenderIndex* renderIndex) {
+    auto camera = static_cast<const HdCamera*>(renderIndex->GetSprim(HdPrimTypeTokens->camera, m_cameraId));
+    TF_VERIFY(camera);
+
+    for (auto& pass : m_passes) {
+        if (!pass.passState) {
+            pass.passState = renderIndex->GetRenderDelegate()->CreateRenderPassState();
+        }
+
+        // Prepare AOVS
+        {
+            // Walk the aov bindings, resolving the render index references as they're
+            // encountered.
+            for (size_t i = 0; i < pass.aovBindings.size(); ++i) {
+                if (pass.aovBindings[i].renderBuffer == nullptr) {
+                    pass.aovBindings[i].renderBuffer = static_cast<HdRenderBuffer*>(renderIndex->GetBprim(HdPrimTypeTokens->renderBuffer, pass.aovBindings[i].renderBufferId));
+                }
+            }
+            pass.passState->SetAovBindings(pass.aovBindings);
 
-    m_passState->Prepare(renderIndex->GetResourceRegistry());
-    if (m_pass) {
-        m_pass->Prepare(GetRenderTags());
+            // XXX Tasks that are not RenderTasks (OIT, ColorCorrection etc) also need
+            // access to AOVs, but cannot access SetupTask or RenderPassState.
+            //(*ctx)[HdxTokens->aovBindings] = VtValue(m_aovBindings);
+        }
+
+        // Prepare Camera
+        pass.passState->SetCameraAndViewport(camera, m_viewport);
+
+        pass.passState->Prepare(renderIndex->GetResourceRegistry());
+        pass.pass->Prepare(pass.renderTags);
     }
 }
 
 void HdRprRenderTask::Execute(HdTaskContext* ctx) {
     // Bind the render state and render geometry with the rendertags (if any)
-    if (m_pass) {
-        m_passState->Bind();
-        m_pass->Execute(m_passState, GetRenderTags());
-        m_passState->Unbind();
+    for (auto& pass : m_passes) {
+        pass.passState->Bind();
+        pass.pass->Execute(pass.passState, pass.renderTags);
+        pass.passState->Unbind();
     }
 }
 
@@ -130,13 +175,31 @@ std::ostream& operator<<(std::ostream& out, const HdRprRenderTaskParams& pv) {
         out << a << " ";
     }
     out << '\n';
+    for (size_t i = 0; i < pv.passes.size(); ++i) {
+        out << "pass " << i << ": " << pv.passes[i].collection.GetName() << " ";
+        for (auto const& a : pv.passes[i].aovBindings) {
+            out << a << " ";
+        }
+        out << '\n';
+    }
     return out;
 }
 
+bool operator==(const HdRprRenderTaskPassParams& lhs, const HdRprRenderTaskPassParams& rhs) {
+    return lhs.collection == rhs.collection &&
+           lhs.renderTags == rhs.renderTags &&
+           lhs.aovBindings == rhs.aovBindings;
+}
+
+bool operator!=(const HdRprRenderTaskPassParams& lhs, const HdRprRenderTaskPassParams& rhs) {
+    return !(lhs == rhs);
+}
+
 bool operator==(const HdRprRenderTaskParams& lhs, const HdRprRenderTaskParams& rhs) {
     return lhs.aovBindings == rhs.aovBindings &&
            lhs.camera == rhs.camera &&
-           lhs.viewport == rhs.viewport;
+           lhs.viewport == rhs.viewport &&
+           lhs.passes == rhs.passes;
 }
 
 bool operator!=(const HdRprRenderTaskParams& lhs, const HdRprRenderTaskParams& rhs) {
@@ -4,9 +4,41 @@
 #include "pxr/imaging/hd/task.h"
 #include "pxr/imaging/hd/renderPass.h"
 #include "pxr/imaging/hd/renderPassState.h"
+#include "pxr/imaging/hd/rprimCollection.h"
+
+#include <vector>
 
 PXR_NAMESPACE_OPEN_SCOPE
 
+struct HdRprRenderTaskPassParams {
+    HdRprimCollection collection;
+
+    // Empty uses the render tags of the task.
+    TfTokenVector renderTags;
+
+    // Should not be empty.
+    HdRenderPassAovBindingVector aovBindings;
+};
+
+struct HdRprRenderTaskParams {
+    // Should not be empty unless passes are given.
+    HdRenderPassAovBindingVector aovBindings;
+
+    SdfPath camera;
+    GfVec4d viewport = GfVec4d(0.0);
+
+    // Passes executed in order. When empty, the task renders a single pass
+    // of the task collection into aovBindings.
+    std::vector<HdRprRenderTaskPassParams> passes;
+};
+
+/// \class HdRprRenderTask
+///
+/// Renders one or more passes, each with its own collection, render tags
+/// and AOV bindings. All passes of the task execute within the same
+/// HdEngine::Execute, after a single sync of the union of their prims, so
+/// a stack of render layers costs one scene sync rather than one per layer.
+///
 class HdRprRenderTask : public HdTask {
 public:
     HdRprRenderTask(HdSceneDelegate* delegate, SdfPath const& id);
@@ -31,25 +63,30 @@ public:
     /// Execute render pass task
     void Execute(HdTaskContext* ctx) override;
 
-    /// Collect Render Tags used by the task.
+    /// Collect Render Tags used by the task, the union of the render tags
+    /// of all passes.
     TfTokenVector const& GetRenderTags() const override;
 
 private:
-    HdRenderPassSharedPtr m_pass;
-    HdRenderPassStateSharedPtr m_passState;
+    // Matches the render passes to the pass params, reusing existing passes
+    void _UpdatePasses(HdRenderIndex* renderIndex);
 
+private:
+    struct _Pass {
+        HdRenderPassSharedPtr pass;
+        HdRenderPassStateSharedPtr passState;
+        TfTokenVector renderTags;
+        HdRenderPassAovBindingVector aovBindings;
+    };
+    std::vector<_Pass> m_passes;
+
+    HdRprimCollection m_collection;
+    TfTokenVector m_taskRenderTags;
     TfTokenVector m_renderTags;
     GfVec4d m_viewport;
     SdfPath m_cameraId;
     HdRenderPassAovBindingVector m_aovBindings;
-};
-
-struct HdRprRenderTaskParams {
-    // Should not be empty.
-    HdRenderPassAovBindingVector aovBindings;
-
-    SdfPath camera;
-    GfVec4d viewport = GfVec4d(0.0);
+    std::vector<HdRprRenderTaskPassParams> m_passParams;
 };
 
 // VtValue requirements
@@ -57,6 +94,9 @@ std::ostream& operator<<(std::ostream& out, const HdRprRenderTaskParams& pv);
 bool operator==(const HdRprRenderTaskParams& lhs, const HdRprRenderTaskParams& rhs);
 bool operator!=(const HdRprRenderTaskParams& lhs, const HdRprRenderTaskParams& rhs);
 
+bool operator==(const HdRprRenderTaskPassParams& lhs, const HdRprRenderTaskPassParams& rhs);
+bool operator!=(const HdRprRenderTaskPassParams& lhs, const HdRprRenderTaskPassParams& rhs);
+
 PXR_NAMESPACE_CLOSE_SCOPE
 
 #endif // HDRPR_RENDER_TASK_H
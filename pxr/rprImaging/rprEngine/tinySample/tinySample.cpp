@@ -12,9 +12,7 @@
 #include "pxr/usd/usd/stage.h"
 #include "pxr/usd/usdGeom/metrics.h"
 
-#include "pxr/imaging/glf/image.h"
-
-#include "pxr/base/work/loops.h"
+#include "pxr/rprImaging/rprEngine/imageWriter.h"
 
 #include "pxr/base/gf/rotation.h"
 #include "pxr/base/gf/camera.h"
@@ -188,11 +186,6 @@ _ComputeCameraToFrameStage(const UsdStageRefPtr& stage, UsdTimeCode timeCode,
     return gfCamera;
 }
 
-// Prman linear to display
-static float DspyLinearTosRGB(float u) {
-    return u < 0.0031308f ? 12.92f * u : 1.055f * powf(u, 0.4167f) - 0.055f;
-}
-
 PXR_NAMESPACE_CLOSE_SCOPE
 
 int main(int ac, char** av) {
@@ -297,28 +290,7 @@ int main(int ac, char** av) {
 
     aovBindings[0].renderBuffer = static_cast<HdRenderBuffer*>(renderIndex->GetBprim(HdPrimTypeTokens->renderBuffer, aovBindings[0].renderBufferId));
     if (aovBindings[0].renderBuffer) {
-        GlfImage::StorageSpec storage;
-        storage.width = aovDimensions[0];
-        storage.height = aovDimensions[1];
-        storage.depth = aovDimensions[2];
-        storage.format = GL_RGBA;
-        storage.type = GL_FLOAT;
-        storage.flipped = true;
-        storage.data = aovBindings[0].renderBuffer->Map();
-
-        WorkParallelForN(size_t(storage.width) * storage.height, [&storage](size_t begin, size_t end) {
-            for (size_t i = begin; i < end; ++i) {
-                for (int j = 0; j < 3; ++j) {
-                    float* value = (float*)storage.data + 4 * i + j;
-                    *value = DspyLinearTosRGB(*value);
-                }
-            }
-        });
-
-        GlfImageSharedPtr image = GlfImage::OpenForWriting("color.png");
-        bool writeSuccess = image && image->Write(storage);
-
-        aovBindings[0].renderBuffer->Unmap();
+        HdRprWriteImage("color.png", aovBindings[0].renderBuffer);
     }
 
     delete taskDataDelegate;